@@ -0,0 +1,210 @@
+%{
+
+    Copyright 2015 Tom Mullins, Stefan Großhauser
+
+    This file is part of hdf5oct.
+
+    hdf5oct is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    hdf5oct is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with hdf5oct.  If not, see <http://www.gnu.org/licenses/>.
+
+
+%}
+
+%% Performance benchmarks of hdf5oct. All input files are generated
+%% here, so the results only depend on the machine and the build.
+%%
+%% The results are written to results.csv, one line per benchmark with
+%% its name, the data volume per repetition, the throughput in MB/s and
+%% the median latency of a repetition in milliseconds. If a file
+%% baseline.csv exists, the results are compared against it and
+%% benchmarks that got slower by more than the tolerance are reported.
+%%
+%% Environment variables:
+%%  H5BENCH_SIZE_MB    size of the large datasets (default 64)
+%%  H5BENCH_REPEAT     repetitions of each benchmark (default 5)
+%%  H5BENCH_TOLERANCE  accepted relative slowdown (default 0.15)
+
+pkg load hdf5oct
+
+function val = env_num(name, default)
+  val = str2double(getenv(name));
+  if (isnan(val))
+    val = default;
+  end
+end
+
+size_mb = env_num("H5BENCH_SIZE_MB", 64);
+nrepeat = env_num("H5BENCH_REPEAT", 5);
+tolerance = env_num("H5BENCH_TOLERANCE", 0.15);
+
+benchfile = "bench.h5";
+results = struct("name", {}, "mbytes", {}, "mbps", {}, "latency_ms", {});
+
+%% Run FCN NREPEAT times, each moving MBYTES megabytes, and record the
+%% median time of a repetition under NAME.
+function results = run_bench(results, name, mbytes, nrepeat, fcn)
+  fcn();  % warm up, e.g. the page cache
+  t = zeros(nrepeat, 1);
+  for k = 1:nrepeat
+    t0 = tic();
+    fcn();
+    t(k) = toc(t0);
+  end
+  tmed = median(t);
+  results(end+1) = struct("name", name, "mbytes", mbytes,
+                          "mbps", mbytes / tmed, "latency_ms", tmed*1e3);
+  printf("%-32s %10.1f MB/s %12.3f ms\n", name, mbytes / tmed, tmed*1e3);
+end
+
+%% the large test array, 2-d, of about size_mb megabytes
+ncols = 1024;
+nrows = round(size_mb * 2^20 / 8 / ncols);
+data = reshape(mod((1:nrows*ncols)*0.37, 1000), [nrows, ncols]);
+mbytes = numel(data) * 8 / 2^20;
+
+if (exist(benchfile, "file"))
+  delete(benchfile);
+end
+
+%% datasets of the same content in the layouts create_dset supports
+chunk = [min(nrows, 256), 64];
+h5create(benchfile, "/contiguous", size(data));
+h5write(benchfile, "/contiguous", data, [1 1], size(data));
+h5create(benchfile, "/chunked", size(data), "ChunkSize", chunk);
+h5write(benchfile, "/chunked", data, [1 1], size(data));
+layouts = {"contiguous", "chunked"};
+try
+  h5create(benchfile, "/compressed", size(data), "ChunkSize", chunk,
+           "Deflate", 4);
+  h5write(benchfile, "/compressed", data, [1 1], size(data));
+  layouts{end+1} = "compressed";
+catch
+  printf("compressed layout not supported by h5create, skipped\n");
+end
+
+disp("------------ read benchmarks: ----------------")
+for l = 1:numel(layouts)
+  dset = ["/", layouts{l}];
+  results = run_bench(results, ["read_full_", layouts{l}], mbytes, nrepeat,
+                      @() h5read(benchfile, dset));
+  % every 4th column
+  results = run_bench(results, ["read_strided_", layouts{l}], mbytes/4, nrepeat,
+                      @() h5read(benchfile, dset, [1 1], [nrows ncols/4],
+                                 [1 4]));
+  % blocks of 16 columns out of every 64
+  results = run_bench(results, ["read_blocked_", layouts{l}], mbytes/4, nrepeat,
+                      @() h5read(benchfile, dset, [1 1], [1 ncols/64],
+                                 [nrows 64], [nrows 16]));
+end
+
+%% many small reads of a few elements each
+nsmall = 1000;
+function small_reads(benchfile, dset, n, nrows)
+  for k = 1:n
+    h5read(benchfile, dset, [mod(k*7, nrows)+1, mod(k, 1024)+1], [1 8]);
+  end
+end
+for l = 1:numel(layouts)
+  dset = ["/", layouts{l}];
+  results = run_bench(results, ["read_small_", layouts{l}],
+                      nsmall*8*8/2^20, nrepeat,
+                      @() small_reads(benchfile, dset, nsmall, nrows));
+end
+
+disp("------------ write benchmarks: ----------------")
+function write_full(benchfile, data)
+  h5write(benchfile, "/written", data);
+end
+results = run_bench(results, "write_full", mbytes, nrepeat,
+                    @() write_full(benchfile, data));
+
+%% append row blocks to an extendible dataset
+nappend = 64;
+block = data(1:min(nrows, 1024), :)';
+function appends(benchfile, block, n, k)
+  dset = sprintf("/appended%d", k);
+  h5create(benchfile, dset, [size(block, 1) Inf], "ChunkSize", size(block));
+  for j = 1:n
+    h5write(benchfile, dset, block, [1, (j-1)*size(block, 2)+1], size(block));
+  end
+end
+function n = next_append()
+  persistent count = 0;
+  count++;
+  n = count;
+end
+results = run_bench(results, "append_blocks", nappend*numel(block)*8/2^20,
+                    nrepeat, @() appends(benchfile, block, nappend,
+                                         next_append()));
+
+disp("------------ attribute benchmarks: ----------------")
+natt = 500;
+h5write(benchfile, "/attributes", 0);
+function write_atts(benchfile, n)
+  for k = 1:n
+    h5writeatt(benchfile, "/attributes", sprintf("att%04d", k), k*[1 2 3 4]);
+  end
+end
+function read_atts(benchfile, n)
+  for k = 1:n
+    h5readatt(benchfile, "/attributes", sprintf("att%04d", k));
+  end
+end
+results = run_bench(results, "attributes_write", natt*4*8/2^20, nrepeat,
+                    @() write_atts(benchfile, natt));
+results = run_bench(results, "attributes_read", natt*4*8/2^20, nrepeat,
+                    @() read_atts(benchfile, natt));
+
+delete(benchfile);
+
+%% write the results and compare them against the baseline
+fid = fopen("results.csv", "w");
+fprintf(fid, "name,mbytes,mbps,latency_ms\n");
+for k = 1:numel(results)
+  fprintf(fid, "%s,%.6g,%.6g,%.6g\n", results(k).name, results(k).mbytes,
+          results(k).mbps, results(k).latency_ms);
+end
+fclose(fid);
+disp("results written to bench/results.csv")
+
+if (! exist("baseline.csv", "file"))
+  disp("no bench/baseline.csv, nothing to compare with (see make bench-baseline)")
+  return
+end
+
+fid = fopen("baseline.csv", "r");
+fgetl(fid);
+baseline = textscan(fid, "%s %f %f %f", "Delimiter", ",");
+fclose(fid);
+
+disp("------------ comparison with baseline: ----------------")
+nregressions = 0;
+for k = 1:numel(results)
+  idx = find(strcmp(baseline{1}, results(k).name));
+  if (isempty(idx))
+    printf("%-32s new\n", results(k).name);
+    continue
+  end
+  ratio = results(k).mbps / baseline{3}(idx(1));
+  if (ratio < 1 - tolerance)
+    status = "REGRESSION";
+    nregressions++;
+  else
+    status = "ok";
+  end
+  printf("%-32s %6.2fx %s\n", results(k).name, ratio, status);
+end
+if (nregressions > 0)
+  error("%d benchmarks regressed by more than %d%%", nregressions,
+        round(tolerance*100));
+end
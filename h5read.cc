@@ -27,17 +27,65 @@
 // integrated into the GNU Octave build
 #include "oct.h"
 #include "lo-ieee.h"
+#include "Cell.h"
+#include "oct-map.h"
+#include "ov-re-mat.h"
+#include "ov-flt-re-mat.h"
+#include "ov-bool-mat.h"
+#include "ov-int8.h"
+#include "ov-int16.h"
+#include "ov-int32.h"
+#include "ov-int64.h"
+#include "ov-uint8.h"
+#include "ov-uint16.h"
+#include "ov-uint32.h"
+#include "ov-uint64.h"
 #else
 // as a package
 #include <octave/oct.h>
 #include <octave/lo-ieee.h>
+#include <octave/Cell.h>
+#include <octave/oct-map.h>
+#include <octave/ov-re-mat.h>
+#include <octave/ov-flt-re-mat.h>
+#include <octave/ov-bool-mat.h>
+#include <octave/ov-int8.h>
+#include <octave/ov-int16.h>
+#include <octave/ov-int32.h>
+#include <octave/ov-int64.h>
+#include <octave/ov-uint8.h>
+#include <octave/ov-uint16.h>
+#include <octave/ov-uint32.h>
+#include <octave/ov-uint64.h>
 #endif
 
 #include <cstdlib>
+#include <cstdio>
 #include <cerrno>
 #include <iostream>
 #include <algorithm>
 #include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <thread>
+#include <limits>
+#include <functional>
+#include <cmath>
+#include <atomic>
+#include <iterator>
+#if defined (__unix__) || defined (__APPLE__)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+// h5readstack reads files in worker processes
+#define H5_STACK_WORKERS 1
+#endif
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#include <immintrin.h>
+// swap_bytes picks SSSE3 or AVX2 kernels by the CPU it runs on
+#define H5_SWAP_BYTES_SIMD 1
+#endif
 #include "gripes.h"
 #include "file-stat.h"
 
@@ -52,6 +100,9 @@ using namespace std;
 #if defined (HAVE_HDF5) && defined (HAVE_HDF5_18)
 #include <hdf5.h>
 #include "h5read.h"
+#ifdef H5_HAVE_FILTER_DEFLATE
+#include <zlib.h>
+#endif
 
 #include "ls-hdf5.h"
 
@@ -105,1364 +156,7445 @@ check_vec (const octave_value& val, Matrix& mat/*out*/,
   return 1;
 }
 
-#endif
+// Instrumentation, see h5stats. The statistics are kept per function
+// and object; h5stats_current points to the entry of the call in
+// progress, if any.
+static bool h5stats_enabled = false;
+static std::map<std::pair<string, string>, H5Stats> h5stats_table;
+static H5Stats *h5stats_current = NULL;
 
-DEFUN_DLD (h5read, args, nargout,
-           "-*- texinfo -*-\n\
-@deftypefn {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname})\n\
-@deftypefnx {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname}, @var{start}, @var{count})\n\
-@deftypefnx {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname}, @var{start}, @var{count}, @var{stride})\n\
-@deftypefnx {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname}, @var{start}, @var{count}, @var{stride}, @var{block})\n\
-Read a hyperslab of data from an HDF5 file specified by its @var{filename}. \n\
-The datatype will be coerced to double.\n\
-For example:\n\
-\n\
-@example\n\
-@group\n\
-data = h5read (\"mydata.h5\", \"/grid/time\");\n\
-@end group\n\
-@end example\n\
-\n\
-The variable @var{dsetname} is the name of the dataset in the HDF5\n\
-file to read. It has to be specified by its absolute path (or relative\n\
-to the root group / ).\n\
-\n\
-The other four arguments are 1xn or nx1 matrices, where n is the number of dimensions\n\
-in the dataset. If all are omitted, the entire dataset will be read.\n\
-\n\
-@var{start} is a 1-based starting offset\n\
-@var{count} is the number of blocks to read. If 0 or Inf\n\
-is specified in any dimension, as many blocks as possible \n\
-are read in that dimension (this is not valid for @code{h5write}).\n\
-@var{stride} is the offset between the start of each block. \n\
-Defaults to a vector of ones.\n\
-@var{block} is the size of each block to read. Defaults to a vector of ones.\n\
-\n\
-Datasets having a compound type consisting of two double values will\n\
-be interpreted as complex valued.\n\
-\n\
-Generally this function tries to use the Octave datatype of\n\
-the appropriate size for the given HDF5 type.\n\
-\n\
-@seealso{h5write}\n\
-@end deftypefn")
+H5StatsScope::H5StatsScope (const char *fcn, const string& name)
 {
-#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
-  gripe_disabled_feature ("h5read", "HDF5 IO");
-  return octave_value_list ();
-#else
-  int nargin = args.length ();
+  if (! h5stats_enabled)
+    return;
+  h5stats_current = &h5stats_table[std::make_pair (string (fcn), name)];
+  h5stats_current->calls++;
+  start = std::chrono::steady_clock::now ();
+}
 
-  if (nargin < 2 || nargin == 3 || nargin > 6 || nargout > 1)
-    {
-      print_usage ();
-      return octave_value_list ();
-    }
-  if (! (args(0).is_string () && args (1).is_string ()))
-    {
-      print_usage ();
-      return octave_value_list ();
-    }
+H5StatsScope::~H5StatsScope ()
+{
+  if (h5stats_current == NULL)
+    return;
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+  h5stats_current->time_total += elapsed.count ();
+  h5stats_current = NULL;
+}
 
-  string filename = args(0).string_value ();
-  string dsetname = args(1).string_value ();
-  if (error_state)
-    return octave_value_list ();
+H5PhaseTimer::H5PhaseTimer (H5Phase p)
+  : phase (p)
+{
+  if (h5stats_current != NULL)
+    start = std::chrono::steady_clock::now ();
+}
 
-  //open the hdf5 file
-  H5File file (filename.c_str (), false);
-  if (error_state)
-    return octave_value_list ();
+H5PhaseTimer::~H5PhaseTimer ()
+{
+  if (h5stats_current == NULL)
+    return;
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+  h5stats_current->time_phase[phase] += elapsed.count ();
+}
 
-  if (nargin < 4)
-    {
-      octave_value retval = file.read_dset_complete (dsetname.c_str ());
-      return retval;
-    }
+// Account the transfer of NPOINTS elements of type MEM_TYPE from or to
+// a dataset or attribute stored with type FILE_TYPE.
+void
+h5stats_transfer (hid_t mem_type, hid_t file_type, hssize_t npoints,
+                  bool is_write)
+{
+  if (h5stats_current == NULL)
+    return;
+  double bytes = (double)npoints * H5Tget_size (mem_type);
+  if (is_write)
+    h5stats_current->bytes_written += bytes;
   else
-    {
-      Matrix start, count, stride, block;
-      int err = 0;
-    
-      err = err || ! check_vec (args(2), start, "START", false);
-      start -= 1;
-
-      err = err || ! check_vec (args(3), count, "COUNT", true);
-
-      if (nargin < 5)
-        stride = Matrix ();
-      else
-        err = err || ! check_vec (args(4), stride, "STRIDE", false);
+    h5stats_current->bytes_read += bytes;
+  if (H5Tequal (mem_type, file_type) <= 0)
+    h5stats_current->conversions++;
+}
 
-      if (nargin < 6)
-        block = Matrix ();
+// Mergeable accumulator of the statistics computed by h5stat over
+// elements of type T. Blocks of elements are summarized with two
+// passes over the block (which are cheap while it is in the cache) and
+// merged with the pairwise update of Chan et al., single elements with
+// Welford's update; both are numerically stable.
+template <typename T>
+struct H5StatAccum
+{
+  double n = 0;
+  double nan = 0;
+  double mean = 0;
+  double m2 = 0;
+  T min = T ();
+  T max = T ();
+  // counts of the bins of the histogram, if any
+  std::vector<double> hist;
+
+  void
+  add (T x, const std::vector<double>& edges)
+  {
+    if (x != x)
+      {
+        nan++;
+        return;
+      }
+    if (n == 0 || x < min)
+      min = x;
+    if (n == 0 || x > max)
+      max = x;
+    n++;
+    double delta = x - mean;
+    mean += delta / n;
+    m2 += delta * (x - mean);
+    if (! edges.empty ())
+      add_to_hist (x, edges);
+  }
+
+  void
+  add_block (const T *p, hsize_t len, const std::vector<double>& edges)
+  {
+    H5StatAccum<T> b;
+    double sum = 0;
+    for (hsize_t j = 0; j < len; j++)
+      {
+        T x = p[j];
+        if (x != x)
+          {
+            b.nan++;
+            continue;
+          }
+        if (b.n == 0 || x < b.min)
+          b.min = x;
+        if (b.n == 0 || x > b.max)
+          b.max = x;
+        b.n++;
+        sum += x;
+      }
+    if (b.n > 0)
+      {
+        b.mean = sum / b.n;
+        for (hsize_t j = 0; j < len; j++)
+          {
+            double delta = p[j] - b.mean;
+            if (delta == delta)
+              b.m2 += delta * delta;
+          }
+        if (! edges.empty ())
+          for (hsize_t j = 0; j < len; j++)
+            if (p[j] == p[j])
+              add_to_hist (p[j], edges);
+      }
+    merge (b);
+  }
+
+  void
+  merge (const H5StatAccum<T>& b)
+  {
+    nan += b.nan;
+    if (hist.size () < b.hist.size ())
+      hist.resize (b.hist.size ());
+    for (size_t k = 0; k < b.hist.size (); k++)
+      hist[k] += b.hist[k];
+    if (b.n == 0)
+      return;
+    if (n == 0 || b.min < min)
+      min = b.min;
+    if (n == 0 || b.max > max)
+      max = b.max;
+    double total = n + b.n;
+    double delta = b.mean - mean;
+    mean += delta * b.n / total;
+    m2 += b.m2 + delta * delta * n * b.n / total;
+    n = total;
+  }
+
+  // count X in the bin [EDGES(k), EDGES(k+1)) like histc, with the last
+  // bin counting the values equal to the last edge
+  void
+  add_to_hist (double x, const std::vector<double>& edges)
+  {
+    hist.resize (edges.size ());
+    std::vector<double>::const_iterator it
+      = std::upper_bound (edges.begin (), edges.end (), x);
+    if (it == edges.begin ())
+      return;
+    size_t k = it - edges.begin () - 1;
+    if (k + 1 < edges.size () || x == edges.back ())
+      hist[k]++;
+  }
+};
+
+// Add the NROWS rows of NLAST elements starting at row FIRST of the row
+// major slab BUF to the accumulators ACC. The slab has the dimensions
+// DIMS (of which the first starts at index R0 in the dataset), and the
+// element with dataset indices I belongs to ACC[sum (I .* OSTRIDE)].
+template <typename T>
+void
+stat_rows (const T *buf, hsize_t first, hsize_t nrows, hsize_t nlast,
+           hsize_t r0, const std::vector<hsize_t>& dims,
+           const std::vector<hsize_t>& ostride,
+           const std::vector<double>& edges,
+           std::vector<H5StatAccum<T> > *acc)
+{
+  int rank = dims.size ();
+  int last = rank-1;
+  hsize_t first_last = (rank == 1 ? r0 : 0);
+  for (hsize_t row = first; row < first + nrows; row++)
+    {
+      hsize_t base = 0, rest = row;
+      for (int k = last-1; k >= 0; k--)
+        {
+          hsize_t idx = rest % dims[k] + (k == 0 ? r0 : 0);
+          rest /= dims[k];
+          base += idx * ostride[k];
+        }
+      const T *p = buf + row * nlast;
+      if (ostride[last] == 0)
+        (*acc)[base].add_block (p, nlast, edges);
       else
-        err = err || ! check_vec (args(5), block, "BLOCK", false);
-
-      if (err)
-        return octave_value_list ();
-
-      return file.read_dset_hyperslab (dsetname.c_str (),
-                                       start, count, stride, block, nargin-2);
+        for (hsize_t j = 0; j < nlast; j++)
+          (*acc)[base + (first_last + j) * ostride[last]].add (p[j], edges);
     }
-#endif
 }
 
-DEFUN_DLD (h5readatt, args, nargout,
-           "-*- texinfo -*-\n\
-@deftypefn {Loadable Function} {@var{data} =} h5readatt (@var{filename}, @var{objectname}, @var{attname})\n\
-\n\
-Reads one attribute of an object from an HDF5 file, specified by the\n\
-@var{filename} and the @var{objectname}.\n\
-The third argument @var{attname} is the name of the attribute which \n\
-is to read.\n\
-\n\
-@seealso{h5writeatt}\n\
-@end deftypefn")
+// Parse the value of an Order option, "F" (Octave's column major order,
+// the default) or "C" (the order of the dimensions in the file).
+int
+parse_order_option (const octave_value& val, bool& c_order/*out*/)
 {
-  octave_value retval;
-#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
-  gripe_disabled_feature ("h5readatt", "HDF5 IO");
-  return octave_value_list ();
-#else
-  int nargin = args.length ();
-  if (nargin != 3)
+  string order = val.string_value ();
+  if (error_state || (order != "C" && order != "F"))
     {
-      print_usage ();
-      return retval;
-    }
-  if (! (args(0).is_string () && args(1).is_string () && args(2).is_string ()))
-    {
-      print_usage ();
-      return retval;
+      error ("Order must be \"C\" or \"F\"");
+      return 0;
     }
+  c_order = (order == "C");
+  return 1;
+}
 
-  string filename = args(0).string_value ();
-  string objname = args(1).string_value ();
-  string attname = args(2).string_value ();
-  if (error_state)
-    return octave_value_list ();
-  
-  //open the hdf5 file
-  H5File file (filename.c_str (), false);
-  if (error_state)
-    return octave_value_list ();
-        
-  retval = file.read_att (objname.c_str (), attname.c_str ());
-  return retval;
+// Return the native HDF5 type of the Octave numeric class NAME, or a
+// negative value if there is none.
+hid_t
+native_type_by_name (const string& name)
+{
+  if (name == "double")
+    return H5T_NATIVE_DOUBLE;
+  else if (name == "single")
+    return H5T_NATIVE_FLOAT;
+  else if (name == "uint64")
+    return H5T_NATIVE_UINT64;
+  else if (name == "uint32")
+    return H5T_NATIVE_UINT32;
+  else if (name == "uint16")
+    return H5T_NATIVE_UINT16;
+  else if (name == "uint8")
+    return H5T_NATIVE_UINT8;
+  else if (name == "int64")
+    return H5T_NATIVE_INT64;
+  else if (name == "int32")
+    return H5T_NATIVE_INT32;
+  else if (name == "int16")
+    return H5T_NATIVE_INT16;
+  else if (name == "int8")
+    return H5T_NATIVE_INT8;
+  return -1;
+}
 
-#endif
+// Return the type in which logical arrays are stored, as h5py stores
+// booleans: an enum of FALSE = 0 and TRUE = 1 in eight bits. It is
+// also their type in memory, as Octave stores a bool in a byte.
+hid_t
+make_bool_type ()
+{
+  hid_t type = H5Tenum_create (H5T_NATIVE_INT8);
+  signed char val = 0;
+  H5Tenum_insert (type, "FALSE", &val);
+  val = 1;
+  H5Tenum_insert (type, "TRUE", &val);
+  return type;
 }
 
+// Return the identifier of the filter VAL, given as a number or as the
+// name of one of the compression filters which are usually loaded as
+// plugins, or a negative value if it is neither.
+H5Z_filter_t
+filter_by_name (const octave_value& val)
+{
+  if (! val.is_string ())
+    {
+      double id = val.double_value ();
+      if (error_state || id != std::floor (id) || id < 0
+          || id > H5Z_FILTER_MAX)
+        return -1;
+      return (H5Z_filter_t)id;
+    }
 
-DEFUN_DLD (h5write, args, nargout,
-           "-*- texinfo -*-\n\
-@deftypefn {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data})\n\
-@deftypefnx {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data}, @var{start}, @var{count})\n\
-@deftypefnx {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data}, @var{start}, @var{count}, @var{stride})\n\
-@deftypefnx {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data}, @var{start}, @var{count}, @var{stride}, @var{block})\n\
-\n\
-Write a matrix @var{data} to the specified location @var{dsetname} in \n\
-a HDF5 file specified by @var{filename}.\n\
-\n\
-In the  simplest form of this function, if the file @var{filename} does\n                                       \
-not exist, it will be created and if the dataset @var{dsetname} already\n\
-exists, it will be overwritten.\n\
-\n\
-If more than three arguments are specified, an error will be raised if\n\
-the file @var{filename} or the dataset @var{dsetname} do not exist\n\
-(use @code{h5create} in order to create an file or an empty dataset).\n \
-If the dataset exists, the data will be written into the specified \n\
-hyperslab. This way it is possible to append data to existing datasets,\n\
-provided their maximum size is sufficiently large.\n\
-\n\
-@var{start} is a 1-based starting offset\n\
-@var{count} is the number of blocks to read. In view of @code{h5read}, note that 0 or Inf\n\
-are not valid elements here.\n\
-@var{stride} is the offset between the start of each block. \n\
-Defaults to a vector of ones.\n\
-@var{block} is the size of each block to read. Defaults to a vector of ones.\n\
-\n\
-Complex valued data will lead to datasets having a compound type consisting\n\
-of two double values.\n\
-\n\
-Generally this function tries to use the HDF5 datatype of\n\
-the appropriate size for the given Octave type.\n\
-\n\
-@seealso{h5read}\n\
-@end deftypefn")
+  // as registered with The HDF Group
+  string name = val.string_value ();
+  if (name == "bzip2")
+    return 307;
+  else if (name == "blosc")
+    return 32001;
+  else if (name == "lz4")
+    return 32004;
+  else if (name == "zstd")
+    return 32015;
+  return -1;
+}
+
+// Add the directories in the environment variable HDF5_PLUGIN_PATH to
+// the paths in which the library searches filter plugins, in front of
+// the others. The library reads the variable only once, so that a path
+// set later from Octave with setenv takes effect as well.
+void
+update_plugin_path ()
 {
-#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
-  gripe_disabled_feature ("h5write", "HDF5 IO");
-  return octave_value_list ();
+#if H5_VERSION_GE (1, 10, 1)
+  const char *env = getenv ("HDF5_PLUGIN_PATH");
+  if (env == NULL)
+    return;
+#ifdef _WIN32
+  const char sep = ';';
 #else
-  int nargin = args.length ();
+  const char sep = ':';
+#endif
 
-  if (! (nargin == 3 || nargin == 5 || nargin  == 6 || nargin == 7) || nargout != 0)
-    {
-      print_usage ();
-      return octave_value_list ();
-    }
-  if (! (args(0).is_string () && args(1).is_string ()))
+  std::vector<string> known;
+  unsigned int n = 0;
+  H5PLsize (&n);
+  for (unsigned int i = 0; i < n; i++)
     {
-      print_usage ();
-      return octave_value_list ();
+      ssize_t len = H5PLget (i, NULL, 0);
+      if (len < 0)
+        continue;
+      std::vector<char> buf (len + 1, 0);
+      H5PLget (i, &buf[0], len + 1);
+      known.push_back (&buf[0]);
     }
-  string filename = args(0).string_value ();
-  string location = args(1).string_value ();
-  
-  if (error_state)
-    return octave_value_list ();
-    
 
-  if (nargin == 3)
+  std::vector<string> dirs;
+  string paths (env);
+  size_t pos = 0;
+  while (pos <= paths.length ())
     {
-      //open the hdf5 file, create it if it does not exist
-      H5File file (filename.c_str (), true);
-      if (error_state)
-        return octave_value_list ();
-      file.write_dset (location.c_str (),
-                       args(2));
+      size_t end = paths.find (sep, pos);
+      if (end == string::npos)
+        end = paths.length ();
+      if (end > pos)
+        dirs.push_back (paths.substr (pos, end - pos));
+      pos = end + 1;
     }
-  else  
-    {
-      //open the hdf5 file, complain if it does not exist
-      H5File file (filename.c_str (), false);
-      if (error_state)
-        return octave_value_list ();
 
-      Matrix start, count, stride, block;
-      int err = 0;
-      err = err || ! check_vec (args(3), start, "START", false);
-      start -= 1;
+  // prepended in reverse, so that they keep their order
+  for (size_t i = dirs.size (); i > 0; i--)
+    if (std::find (known.begin (), known.end (), dirs[i-1]) == known.end ())
+      H5PLprepend (dirs[i-1].c_str ());
+#endif
+}
 
-      // A count value 0 is not allowed when writing data.
-      err = err || ! check_vec (args(4), count, "COUNT", false);
+// Return true if TYPE is an enum of just the members FALSE and TRUE, as
+// written for logical arrays by make_bool_type or by h5py.
+bool
+is_bool_type (hid_t type)
+{
+  return (H5Tget_class (type) == H5T_ENUM && H5Tget_nmembers (type) == 2
+          && H5Tget_member_index (type, "FALSE") >= 0
+          && H5Tget_member_index (type, "TRUE") >= 0);
+}
 
-      if (nargin <= 5)
-        stride = Matrix ();
+// Arrays returned by h5read with the option ReuseBuffer, all of the same
+// class and dimensions. They are filled again by later calls once
+// nothing else refers to them. Two are enough for a loop which assigns
+// each result to the same variable: the previous result is still held
+// by the variable during the call.
+static std::vector<octave_value> h5read_pool;
+static const size_t H5READ_POOL_SIZE = 2;
+
+// Take an array of dimensions DIMS, whose class matches TYPE as for
+// alloc_numeric_array, from h5read_pool if there is one to which
+// nothing else refers, and return it like alloc_numeric_array does.
+// Returns an undefined value otherwise.
+octave_value
+reuse_numeric_array (hid_t type, const dim_vector& dims,
+                     void **data, hid_t *mem_type)
+{
+  octave_value retval;
+  for (size_t i = 0; i < h5read_pool.size (); i++)
+    {
+      octave_value& val = h5read_pool[i];
+      hid_t native = native_type_by_name (val.class_name ());
+      if (val.get_count () != 1 || val.dims () != dims || native < 0
+          || H5Tget_class (native) != H5Tget_class (type)
+          || H5Tget_size (native) != H5Tget_size (type)
+          || (H5Tget_class (type) == H5T_INTEGER
+              && H5Tget_sign (native) != H5Tget_sign (type)))
+        continue;
+
+      // Once the pool lets go of the value, the array is the only
+      // reference to its storage, so fortran_vec does not copy it.
+#define REUSE_NUMERIC_ARRAY(arraytype, ovtype, valfcn)  \
+      {                                                 \
+        arraytype ret = val.valfcn ();                  \
+        val = octave_value ();                          \
+        *data = ret.fortran_vec ();                     \
+        retval = octave_value (new ovtype (ret));       \
+      }
+
+      string cls = val.class_name ();
+      if (cls == "double")
+        REUSE_NUMERIC_ARRAY (NDArray, octave_matrix, array_value)
+      else if (cls == "single")
+        REUSE_NUMERIC_ARRAY (FloatNDArray, octave_float_matrix, float_array_value)
+      else if (cls == "uint64")
+        REUSE_NUMERIC_ARRAY (uint64NDArray, octave_uint64_matrix, uint64_array_value)
+      else if (cls == "uint32")
+        REUSE_NUMERIC_ARRAY (uint32NDArray, octave_uint32_matrix, uint32_array_value)
+      else if (cls == "uint16")
+        REUSE_NUMERIC_ARRAY (uint16NDArray, octave_uint16_matrix, uint16_array_value)
+      else if (cls == "uint8")
+        REUSE_NUMERIC_ARRAY (uint8NDArray, octave_uint8_matrix, uint8_array_value)
+      else if (cls == "int64")
+        REUSE_NUMERIC_ARRAY (int64NDArray, octave_int64_matrix, int64_array_value)
+      else if (cls == "int32")
+        REUSE_NUMERIC_ARRAY (int32NDArray, octave_int32_matrix, int32_array_value)
+      else if (cls == "int16")
+        REUSE_NUMERIC_ARRAY (int16NDArray, octave_int16_matrix, int16_array_value)
       else
-        err = err || ! check_vec (args(5), stride, "STRIDE", false);
+        REUSE_NUMERIC_ARRAY (int8NDArray, octave_int8_matrix, int8_array_value)
 
-      if (nargin <= 6)
+      *mem_type = H5Tcopy (native);
+      h5read_pool.erase (h5read_pool.begin () + i);
+      break;
+    }
+  return retval;
+}
+
+// Keep the array VAL returned by h5read in h5read_pool, replacing arrays
+// of another class or other dimensions and the oldest ones.
+void
+keep_numeric_array (const octave_value& val)
+{
+  if (val.numel () <= 1)
+    return;
+  for (size_t i = 0; i < h5read_pool.size (); i++)
+    {
+      if (h5read_pool[i].class_name () != val.class_name ()
+          || h5read_pool[i].dims () != val.dims ())
+        {
+          h5read_pool.clear ();
+          break;
+        }
+    }
+  h5read_pool.push_back (val);
+  if (h5read_pool.size () > H5READ_POOL_SIZE)
+    h5read_pool.erase (h5read_pool.begin ());
+}
+
+// Parse the key/value pairs ARGS(FIRST:end) given to h5read into OPTS.
+int
+parse_read_options (const octave_value_list& args, int first,
+                    H5ReadOptions& opts/*out*/)
+{
+  for (int i = first; i+1 < args.length (); i+=2)
+    {
+      if (! args(i).is_string ())
+        {
+          error ("option names must be strings");
+          return 0;
+        }
+      string key = args(i).string_value ();
+      if (key == "Fields")
+        {
+          if (args(i+1).is_string ())
+            opts.fields = string_vector (args(i+1).string_value ());
+          else if (args(i+1).is_cellstr ())
+            {
+              Array<string> names = args(i+1).cellstr_value ();
+              opts.fields = string_vector (names.numel ());
+              for (octave_idx_type j = 0; j < names.numel (); j++)
+                opts.fields[j] = names(j);
+            }
+          else
+            {
+              error ("Fields must be a string or a cell array of strings");
+              return 0;
+            }
+        }
+      else if (key == "OutputType")
+        {
+          opts.output_type = args(i+1).string_value ();
+          if (error_state || native_type_by_name (opts.output_type) < 0)
+            {
+              error ("OutputType must be one of double, single, int8, uint8, \
+int16, uint16, int32, uint32, int64 or uint64");
+              return 0;
+            }
+        }
+      else if (key == "ScaleFactor" || key == "AddOffset")
+        {
+          double val = args(i+1).double_value ();
+          if (error_state || ! args(i+1).is_real_scalar ())
+            {
+              error ("%s must be a real scalar", key.c_str ());
+              return 0;
+            }
+          if (key == "ScaleFactor")
+            opts.scale_factor = val;
+          else
+            opts.add_offset = val;
+          opts.scale = true;
+        }
+      else if (key == "Order")
+        {
+          if (! parse_order_option (args(i+1), opts.c_order))
+            return 0;
+        }
+      else if (key == "Collective")
+        {
+          opts.collective = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("Collective must be true or false");
+              return 0;
+            }
+        }
+      else if (key == "ReuseBuffer")
+        {
+          opts.reuse_buffer = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("ReuseBuffer must be true or false");
+              return 0;
+            }
+          if (! opts.reuse_buffer)
+            h5read_pool.clear ();
+        }
+      else
+        {
+          error ("unknown parameter name %s", key.c_str ());
+          return 0;
+        }
+    }
+  return 1;
+}
+
+// Parse the key/value pairs ARGS(FIRST:end) given to h5write into OPTS.
+int
+parse_write_options (const octave_value_list& args, int first,
+                     H5WriteOptions& opts/*out*/)
+{
+  for (int i = first; i+1 < args.length (); i+=2)
+    {
+      if (! args(i).is_string ())
+        {
+          error ("option names must be strings");
+          return 0;
+        }
+      string key = args(i).string_value ();
+      if (key == "Order")
+        {
+          if (! parse_order_option (args(i+1), opts.c_order))
+            return 0;
+        }
+      else if (key == "Collective")
+        {
+          opts.collective = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("Collective must be true or false");
+              return 0;
+            }
+        }
+      else
+        {
+          error ("unknown parameter name %s", key.c_str ());
+          return 0;
+        }
+    }
+  return 1;
+}
+
+// Copy the member at byte offset OFFSET of each of the N records of size
+// RECSIZE in BUF to the array DATA.
+template <typename T>
+void
+unpack_member (const char *buf, size_t recsize, size_t offset,
+               hsize_t n, void *data)
+{
+  T *dst = (T*)data;
+  for (hsize_t i = 0; i < n; i++)
+    memcpy (dst + i, buf + i*recsize + offset, sizeof (T));
+}
+
+// Copy the N = END-BEGIN elements of the array DATA starting at BEGIN
+// to the member at byte offset OFFSET of the records of size RECSIZE
+// in BUF, which starts with record BEGIN.
+template <typename T>
+void
+pack_member (char *buf, size_t recsize, size_t offset,
+             const void *data, hsize_t begin, hsize_t end)
+{
+  const T *src = (const T*)data;
+  for (hsize_t i = begin; i < end; i++)
+    memcpy (buf + (i-begin)*recsize + offset, src + i, sizeof (T));
+}
+
+// Return a pointer to the elements of the real numeric or logical
+// array VAL, stored as an array of its own Octave class. For values
+// which are not stored that way (e.g. ranges and scalars), the
+// elements are converted. HOLD keeps the storage alive and MEM_TYPE
+// receives a copy of the matching native HDF5 type, or the enum of
+// make_bool_type for logical arrays. NULL is returned
+// for values of any other type.
+const void *
+numeric_array_data (const octave_value& val, octave_value& hold,
+                    hid_t *mem_type)
+{
+  const void *data = NULL;
+
+#define HOLD_NUMERIC_ARRAY(arraytype, valuefcn, ovtype, native) \
+  {                                                             \
+    arraytype a = val.valuefcn ();                              \
+    data = a.data ();                                           \
+    *mem_type = H5Tcopy (native);                               \
+    hold = octave_value (new ovtype (a));                       \
+  }
+
+  if (val.is_complex_type ())
+    return NULL;
+  else if (val.is_uint64_type ())
+    HOLD_NUMERIC_ARRAY (uint64NDArray, uint64_array_value, octave_uint64_matrix, H5T_NATIVE_UINT64)
+  else if (val.is_uint32_type ())
+    HOLD_NUMERIC_ARRAY (uint32NDArray, uint32_array_value, octave_uint32_matrix, H5T_NATIVE_UINT32)
+  else if (val.is_uint16_type ())
+    HOLD_NUMERIC_ARRAY (uint16NDArray, uint16_array_value, octave_uint16_matrix, H5T_NATIVE_UINT16)
+  else if (val.is_uint8_type ())
+    HOLD_NUMERIC_ARRAY (uint8NDArray, uint8_array_value, octave_uint8_matrix, H5T_NATIVE_UINT8)
+  else if (val.is_int64_type ())
+    HOLD_NUMERIC_ARRAY (int64NDArray, int64_array_value, octave_int64_matrix, H5T_NATIVE_INT64)
+  else if (val.is_int32_type ())
+    HOLD_NUMERIC_ARRAY (int32NDArray, int32_array_value, octave_int32_matrix, H5T_NATIVE_INT32)
+  else if (val.is_int16_type ())
+    HOLD_NUMERIC_ARRAY (int16NDArray, int16_array_value, octave_int16_matrix, H5T_NATIVE_INT16)
+  else if (val.is_int8_type ())
+    HOLD_NUMERIC_ARRAY (int8NDArray, int8_array_value, octave_int8_matrix, H5T_NATIVE_INT8)
+  else if (val.is_bool_type ())
+    {
+      // stored as the enum of logical datasets, see make_bool_type
+      boolNDArray a = val.bool_array_value ();
+      data = a.data ();
+      *mem_type = make_bool_type ();
+      hold = octave_value (new octave_bool_matrix (a));
+    }
+  else if (val.is_single_type ())
+    HOLD_NUMERIC_ARRAY (FloatNDArray, float_array_value, octave_float_matrix, H5T_NATIVE_FLOAT)
+  else if (val.is_real_type () && ! val.is_string () && ! val.is_cell ()
+           && ! val.is_map ())
+    HOLD_NUMERIC_ARRAY (NDArray, array_value, octave_matrix, H5T_NATIVE_DOUBLE)
+
+  return data;
+}
+
+// Return true if the atomic types TYPE and NATIVE are the same except
+// for their byte order.
+bool
+differs_in_byte_order_only (hid_t type, hid_t native)
+{
+  H5T_order_t order = H5Tget_order (type);
+  H5T_order_t native_order = H5Tget_order (native);
+  if ((order != H5T_ORDER_LE && order != H5T_ORDER_BE)
+      || (native_order != H5T_ORDER_LE && native_order != H5T_ORDER_BE)
+      || order == native_order)
+    return false;
+
+  hid_t swapped = H5Tcopy (type);
+  bool same = (H5Tset_order (swapped, native_order) >= 0
+               && H5Tequal (swapped, native) > 0);
+  H5Tclose (swapped);
+  return same;
+}
+
+// Reverse the bytes of each of the N elements of SIZE bytes at P.
+template <int SIZE>
+void
+swap_bytes_kernel (char *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++, p += SIZE)
+    {
+      if (SIZE == 2)
+        {
+          uint16_t v;
+          memcpy (&v, p, 2);
+          v = __builtin_bswap16 (v);
+          memcpy (p, &v, 2);
+        }
+      else if (SIZE == 4)
+        {
+          uint32_t v;
+          memcpy (&v, p, 4);
+          v = __builtin_bswap32 (v);
+          memcpy (p, &v, 4);
+        }
+      else
+        {
+          uint64_t v;
+          memcpy (&v, p, 8);
+          v = __builtin_bswap64 (v);
+          memcpy (p, &v, 8);
+        }
+    }
+}
+
+#if defined (H5_SWAP_BYTES_SIMD)
+// The shuffle mask reversing each element of SIZE bytes within 16 bytes
+template <int SIZE>
+void
+swap_bytes_mask (char *m)
+{
+  for (int j = 0; j < 16; j++)
+    m[j] = (j / SIZE) * SIZE + (SIZE - 1 - j % SIZE);
+}
+
+// As swap_bytes_kernel, 16 bytes at a time with SSSE3. These are
+// compiled for their instruction set whatever the target of the rest of
+// the file, and only called if the CPU supports it.
+template <int SIZE>
+__attribute__ ((target ("ssse3"))) void
+swap_bytes_ssse3 (char *p, size_t n)
+{
+  char m[16];
+  swap_bytes_mask<SIZE> (m);
+  __m128i mask = _mm_loadu_si128 ((const __m128i*)m);
+  size_t nbytes = n * SIZE;
+  size_t i = 0;
+  for (; i + 16 <= nbytes; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*)(p + i));
+      _mm_storeu_si128 ((__m128i*)(p + i), _mm_shuffle_epi8 (v, mask));
+    }
+  swap_bytes_kernel<SIZE> (p + i, (nbytes - i) / SIZE);
+}
+
+// As swap_bytes_kernel, 32 bytes at a time with AVX2
+template <int SIZE>
+__attribute__ ((target ("avx2"))) void
+swap_bytes_avx2 (char *p, size_t n)
+{
+  char m[32];
+  swap_bytes_mask<SIZE> (m);
+  swap_bytes_mask<SIZE> (m + 16);
+  __m256i mask = _mm256_loadu_si256 ((const __m256i*)m);
+  size_t nbytes = n * SIZE;
+  size_t i = 0;
+  for (; i + 32 <= nbytes; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*)(p + i));
+      _mm256_storeu_si256 ((__m256i*)(p + i), _mm256_shuffle_epi8 (v, mask));
+    }
+  swap_bytes_kernel<SIZE> (p + i, (nbytes - i) / SIZE);
+}
+#endif
+
+template <int SIZE>
+void
+swap_bytes_dispatch (char *p, size_t n)
+{
+#if defined (H5_SWAP_BYTES_SIMD)
+  static const int isa = (__builtin_cpu_supports ("avx2") ? 2
+                          : __builtin_cpu_supports ("ssse3") ? 1 : 0);
+  if (isa == 2)
+    swap_bytes_avx2<SIZE> (p, n);
+  else if (isa == 1)
+    swap_bytes_ssse3<SIZE> (p, n);
+  else
+#endif
+    swap_bytes_kernel<SIZE> (p, n);
+}
+
+// Reverse the byte order of the N elements of SIZE bytes at DATA, in
+// place.
+void
+swap_bytes (void *data, size_t n, size_t size)
+{
+  switch (size)
+    {
+    case 2:
+      swap_bytes_dispatch<2> ((char*)data, n);
+      break;
+    case 4:
+      swap_bytes_dispatch<4> ((char*)data, n);
+      break;
+    case 8:
+      swap_bytes_dispatch<8> ((char*)data, n);
+      break;
+    }
+}
+
+// Copy the elements with indices [FIRST, LAST) along the first
+// dimension of the RANK dimensional array of DIMS elements at SRC to
+// DST. The arrays are laid out with the element strides SSTRIDE and
+// DSTRIDE. The first and the last dimension are traversed in tiles of
+// TILE x TILE elements, so that both the reads and the writes stay in
+// the cache when one of them is contiguous along the first and the
+// other along the last dimension.
+template <int SIZE>
+void
+reorder_copy_kernel (const char *src, const hsize_t *sstride,
+                     char *dst, const hsize_t *dstride,
+                     const hsize_t *dims, int rank,
+                     hsize_t first, hsize_t last)
+{
+  struct elem { char b[SIZE]; };
+  const elem *s = (const elem*)src;
+  elem *d = (elem*)dst;
+  const hsize_t TILE = 32;
+  int l = rank - 1;
+
+  hsize_t nmid = 1;
+  for (int k = 1; k < l; k++)
+    nmid *= dims[k];
+
+  for (hsize_t m = 0; m < nmid; m++)
+    {
+      // offsets of the indices in the dimensions between the first
+      // and the last one
+      hsize_t soff = 0, doff = 0, rest = m;
+      for (int k = l-1; k > 0; k--)
+        {
+          hsize_t idx = rest % dims[k];
+          rest /= dims[k];
+          soff += idx * sstride[k];
+          doff += idx * dstride[k];
+        }
+      for (hsize_t i0 = first; i0 < last; i0 += TILE)
+        {
+          hsize_t i1 = std::min (i0 + TILE, last);
+          for (hsize_t j0 = 0; j0 < dims[l]; j0 += TILE)
+            {
+              hsize_t j1 = std::min (j0 + TILE, dims[l]);
+              for (hsize_t i = i0; i < i1; i++)
+                for (hsize_t j = j0; j < j1; j++)
+                  d[doff + i*dstride[0] + j*dstride[l]]
+                    = s[soff + i*sstride[0] + j*sstride[l]];
+            }
+        }
+    }
+}
+
+// Return the number of threads among which work on NUMEL elements is
+// split: one per 2^20 elements, at most one per processor and at most
+// MAXPARTS.
+hsize_t
+worker_count (hsize_t numel, hsize_t maxparts)
+{
+  hsize_t nthreads = std::min<hsize_t> (std::thread::hardware_concurrency (),
+                                        numel >> 20);
+  return std::min (std::max<hsize_t> (nthreads, 1), maxparts);
+}
+
+// Copy the RANK dimensional array of DIMS elements of ELSIZE bytes at
+// SRC, laid out with the element strides SSTRIDE, to DST, laid out with
+// DSTRIDE. RANK must be at least 2. Used to convert between Octave's
+// column major and HDF5's row major order; large arrays are split
+// along the first dimension among several threads.
+void
+reorder_copy (const void *src, const hsize_t *sstride,
+              void *dst, const hsize_t *dstride,
+              const hsize_t *dims, int rank, size_t elsize)
+{
+  void (*kernel) (const char*, const hsize_t*, char*, const hsize_t*,
+                  const hsize_t*, int, hsize_t, hsize_t);
+  switch (elsize)
+    {
+    case 1:
+      kernel = reorder_copy_kernel<1>;
+      break;
+    case 2:
+      kernel = reorder_copy_kernel<2>;
+      break;
+    case 4:
+      kernel = reorder_copy_kernel<4>;
+      break;
+    case 8:
+      kernel = reorder_copy_kernel<8>;
+      break;
+    case 16:
+      kernel = reorder_copy_kernel<16>;
+      break;
+    default:
+      return;
+    }
+
+  hsize_t numel = 1;
+  for (int k = 0; k < rank; k++)
+    numel *= dims[k];
+  hsize_t nthreads = worker_count (numel, dims[0]);
+
+  std::vector<std::thread> workers;
+  hsize_t per_thread = (dims[0] + nthreads - 1) / nthreads;
+  for (hsize_t t = 1; t < nthreads; t++)
+    {
+      hsize_t first = t * per_thread;
+      hsize_t last = std::min (first + per_thread, dims[0]);
+      if (first < last)
+        workers.push_back (std::thread (kernel, (const char*)src, sstride,
+                                        (char*)dst, dstride, dims, rank,
+                                        first, last));
+    }
+  kernel ((const char*)src, sstride, (char*)dst, dstride, dims, rank,
+          0, std::min (per_thread, dims[0]));
+  for (size_t t = 0; t < workers.size (); t++)
+    workers[t].join ();
+}
+
+// Allocate an Octave array of dimensions DIMS whose element type
+// matches the integer or floating point HDF5 type TYPE. A pointer to
+// its storage is returned in DATA and a copy of the matching native
+// HDF5 type in MEM_TYPE. The value is not narrowed yet (a 1x1 array
+// would otherwise be copied into a scalar), so call maybe_mutate on it
+// after DATA has been filled. The returned value is undefined if TYPE
+// has no matching Octave type.
+octave_value
+alloc_numeric_array (hid_t type, const dim_vector& dims,
+                     void **data, hid_t *mem_type)
+{
+  octave_value retval;
+  size_t size = H5Tget_size (type);
+
+#define ALLOC_NUMERIC_ARRAY(arraytype, ovtype, native)  \
+  {                                                     \
+    arraytype ret (dims);                               \
+    *data = ret.fortran_vec ();                         \
+    *mem_type = H5Tcopy (native);                       \
+    retval = octave_value (new ovtype (ret));           \
+  }
+
+  if (H5Tget_class (type) == H5T_INTEGER)
+    {
+      bool is_unsigned = (H5Tget_sign (type) == H5T_SGN_NONE);
+      switch (size*8)
+        {
+        case 64:
+          if (is_unsigned)
+            ALLOC_NUMERIC_ARRAY (uint64NDArray, octave_uint64_matrix, H5T_NATIVE_UINT64)
+          else
+            ALLOC_NUMERIC_ARRAY (int64NDArray, octave_int64_matrix, H5T_NATIVE_INT64)
+          break;
+        case 32:
+          if (is_unsigned)
+            ALLOC_NUMERIC_ARRAY (uint32NDArray, octave_uint32_matrix, H5T_NATIVE_UINT32)
+          else
+            ALLOC_NUMERIC_ARRAY (int32NDArray, octave_int32_matrix, H5T_NATIVE_INT32)
+          break;
+        case 16:
+          if (is_unsigned)
+            ALLOC_NUMERIC_ARRAY (uint16NDArray, octave_uint16_matrix, H5T_NATIVE_UINT16)
+          else
+            ALLOC_NUMERIC_ARRAY (int16NDArray, octave_int16_matrix, H5T_NATIVE_INT16)
+          break;
+        case 8:
+          if (is_unsigned)
+            ALLOC_NUMERIC_ARRAY (uint8NDArray, octave_uint8_matrix, H5T_NATIVE_UINT8)
+          else
+            ALLOC_NUMERIC_ARRAY (int8NDArray, octave_int8_matrix, H5T_NATIVE_INT8)
+          break;
+        }
+    }
+  else if (H5Tget_class (type) == H5T_FLOAT)
+    {
+      if (size == sizeof (float))
+        ALLOC_NUMERIC_ARRAY (FloatNDArray, octave_float_matrix, H5T_NATIVE_FLOAT)
+      else if (size == sizeof (double))
+        ALLOC_NUMERIC_ARRAY (NDArray, octave_matrix, H5T_NATIVE_DOUBLE)
+    }
+
+  return retval;
+}
+
+// A member of a group read by h5readgroup. The fields of the struct
+// are listed in NAMES, with the index of their value in the list of
+// values read, or of their node in GROUPS if they are subgroups.
+struct H5GroupNode
+{
+  std::vector<std::string> names;
+  std::vector<size_t> index;
+  std::vector<bool> is_group;
+  std::vector<H5GroupNode> groups;
+};
+
+// a dataset to be read by h5readgroup, into the value SLOT, ordered by
+// the file address ADDR of its data. A SPARSE member is a group holding
+// a sparse matrix, whose address is that of its data array.
+struct H5GroupMember
+{
+  std::string path;
+  haddr_t addr;
+  size_t slot;
+  bool sparse;
+};
+
+bool
+member_before (const H5GroupMember& a, const H5GroupMember& b)
+{
+  return a.addr < b.addr;
+}
+
+// A chunked dataset, compressed with deflate (and shuffle), whose raw
+// chunks are decompressed by inflate_chunks into the array VALUE, with
+// the storage DATA in the file's row major order. DIMS and CHUNK are in
+// the order of the file, and FILTERS in the order of the pipeline.
+struct H5ChunkedRead
+{
+  std::string path;
+  size_t slot;
+  octave_value value;
+  char *data;
+  std::vector<hsize_t> dims, chunk;
+  size_t elsize;
+  std::vector<H5Z_filter_t> filters;
+  bool ok;
+};
+
+// a raw chunk of the H5ChunkedRead number DSET, at the offset OFFSET,
+// as it is stored in the file
+struct H5RawChunk
+{
+  size_t dset;
+  std::vector<hsize_t> offset;
+  uint32_t filter_mask;
+  std::vector<char> raw;
+  bool ok;
+};
+
+herr_t
+collect_link_name (hid_t group, const char *name, const H5L_info_t *info,
+                   void *op_data)
+{
+  ((std::vector<std::string>*)op_data)->push_back (name);
+  return 0;
+}
+
+// Collect the names of the datasets with a zone map, visited by
+// H5Ovisit.
+herr_t
+collect_zonemapped (hid_t obj, const char *name, const H5O_info_t *info,
+                    void *op_data)
+{
+  if (info->type == H5O_TYPE_DATASET
+      && H5Aexists_by_name (obj, name, "zonemap", H5P_DEFAULT) > 0)
+    ((std::vector<std::string>*)op_data)->push_back (name);
+  return 0;
+}
+
+herr_t
+collect_attr_name (hid_t obj, const char *name, const H5A_info_t *info,
+                   void *op_data)
+{
+  ((std::vector<std::string>*)op_data)->push_back (name);
+  return 0;
+}
+
+// Build the struct of the group NODE from the values read.
+octave_scalar_map
+build_group_struct (const H5GroupNode& node,
+                    const std::vector<octave_value>& values)
+{
+  octave_scalar_map retval;
+  for (size_t i = 0; i < node.names.size (); i++)
+    {
+      if (node.is_group[i])
+        retval.assign (node.names[i],
+                       build_group_struct (node.groups[node.index[i]],
+                                           values));
+      else
+        retval.assign (node.names[i], values[node.index[i]]);
+    }
+  return retval;
+}
+
+#ifdef H5_HAVE_FILTER_DEFLATE
+// Undo the filters of the raw chunk C of the dataset D, which have not
+// been skipped when it was written, and copy the part of the chunk
+// which lies inside the dataset to its place in the array. BUF and TMP
+// are scratch buffers. No HDF5 function is called, so this can run on
+// several threads. Returns false if the chunk cannot be decompressed.
+bool
+inflate_chunk (const H5ChunkedRead& d, const H5RawChunk& c,
+               std::vector<char>& buf, std::vector<char>& tmp)
+{
+  int rank = d.dims.size ();
+  size_t elsize = d.elsize;
+  hsize_t numel = 1;
+  for (int k = 0; k < rank; k++)
+    numel *= d.chunk[k];
+  size_t nbytes = numel * elsize;
+
+  const char *src = &c.raw[0];
+  size_t len = c.raw.size ();
+  std::vector<char> *out = &buf;
+  for (int f = d.filters.size () - 1; f >= 0; f--)
+    {
+      if (c.filter_mask & (1u << f))
+        continue;
+      out->resize (nbytes);
+      if (d.filters[f] == H5Z_FILTER_DEFLATE)
+        {
+          uLongf outlen = nbytes;
+          if (uncompress ((Bytef*)&(*out)[0], &outlen, (const Bytef*)src,
+                          len) != Z_OK || outlen != nbytes)
+            return false;
+        }
+      else
+        {
+          // H5Z_FILTER_SHUFFLE stores the j-th bytes of all elements
+          // together
+          if (len != nbytes)
+            return false;
+          char *dst = &(*out)[0];
+          for (size_t j = 0; j < elsize; j++)
+            for (hsize_t i = 0; i < numel; i++)
+              dst[i*elsize + j] = src[j*numel + i];
+        }
+      src = &(*out)[0];
+      len = nbytes;
+      out = (out == &buf ? &tmp : &buf);
+    }
+  if (len != nbytes)
+    return false;
+
+  // the chunk is copied row by row (along the last dimension of the
+  // file), cut off at the end of the dataset
+  std::vector<hsize_t> ext (rank), idx (rank, 0);
+  hsize_t nrows = 1;
+  for (int k = 0; k < rank; k++)
+    {
+      ext[k] = std::min (d.chunk[k], d.dims[k] - c.offset[k]);
+      if (k < rank-1)
+        nrows *= ext[k];
+    }
+  size_t rowbytes = ext[rank-1] * elsize;
+  for (hsize_t r = 0; r < nrows; r++)
+    {
+      hsize_t s = 0, t = 0;
+      for (int k = 0; k < rank; k++)
+        {
+          hsize_t i = (k < rank-1 ? idx[k] : 0);
+          s = s * d.chunk[k] + i;
+          t = t * d.dims[k] + c.offset[k] + i;
+        }
+      memcpy (d.data + t * elsize, src + s * elsize, rowbytes);
+      for (int k = rank-2; k >= 0 && ++idx[k] == ext[k]; k--)
+        idx[k] = 0;
+    }
+  return true;
+}
+
+void
+inflate_worker (const std::vector<H5ChunkedRead> *reads,
+                std::vector<H5RawChunk> *chunks, std::atomic<size_t> *next)
+{
+  std::vector<char> buf, tmp;
+  for (size_t i = (*next)++; i < chunks->size (); i = (*next)++)
+    {
+      H5RawChunk& c = (*chunks)[i];
+      c.ok = inflate_chunk ((*reads)[c.dset], c, buf, tmp);
+      std::vector<char> ().swap (c.raw);
+    }
+}
+
+// Decompress the raw CHUNKS of the datasets READS on a pool of threads,
+// and clear the ok flag of the datasets of which a chunk failed.
+void
+inflate_chunks (std::vector<H5ChunkedRead>& reads,
+                std::vector<H5RawChunk>& chunks)
+{
+  if (chunks.empty ())
+    return;
+  hsize_t numel = 0;
+  for (size_t i = 0; i < chunks.size (); i++)
+    {
+      const H5ChunkedRead& d = reads[chunks[i].dset];
+      hsize_t n = 1;
+      for (size_t k = 0; k < d.chunk.size (); k++)
+        n *= d.chunk[k];
+      numel += n;
+    }
+  hsize_t nthreads = worker_count (numel, chunks.size ());
+
+  std::atomic<size_t> next (0);
+  std::vector<std::thread> workers;
+  for (hsize_t t = 1; t < nthreads; t++)
+    workers.push_back (std::thread (inflate_worker, &reads, &chunks, &next));
+  inflate_worker (&reads, &chunks, &next);
+  for (size_t t = 0; t < workers.size (); t++)
+    workers[t].join ();
+
+  for (size_t i = 0; i < chunks.size (); i++)
+    if (! chunks[i].ok)
+      reads[chunks[i].dset].ok = false;
+}
+#endif
+
+// Readahead of sequential hyperslab reads. When consecutive calls of
+// h5read (without options) read hyperslabs of the same shape from a
+// dataset, each starting further along one dimension by the same step
+// than the previous one, the next hyperslab of this sequence is read by
+// a background thread while the caller works on the current one, and
+// returned by the next call if it asks for exactly that hyperslab. Only
+// one hyperslab of at most H5READ_READAHEAD_BYTES is read ahead. It is
+// discarded by any other function which opens a file, so that it never
+// outlives a write. The library must be thread-safe for this.
+struct H5Readahead
+{
+  // the last hyperslab read, as given to h5read
+  string filename, dsetname;
+  Matrix start, count, stride, block;
+
+  // the hyperslab read ahead, into the array NEXT of the type MEM_TYPE,
+  // and whether this succeeded (once WORKER has finished)
+  Matrix next_start;
+  octave_value next;
+  hid_t mem_type = -1;
+  bool ok = false;
+  std::thread worker;
+
+  ~H5Readahead ()
+  {
+    if (worker.joinable ())
+      worker.join ();
+  }
+};
+
+static H5Readahead h5read_readahead;
+static const size_t H5READ_READAHEAD_BYTES = 256 << 20;
+
+static bool
+same_vec (const Matrix& a, const Matrix& b)
+{
+  if (a.nelem () != b.nelem ())
+    return false;
+  for (octave_idx_type i = 0; i < a.nelem (); i++)
+    if (a(i) != b(i))
+      return false;
+  return true;
+}
+
+// Read the hyperslab START, STRIDE, COUNT, BLOCK (in the order of the
+// file) of the dataset DSETNAME in FILENAME into DATA as MEM_TYPE, in
+// the background. OK is set to whether this succeeded.
+static void
+readahead_read (string filename, string dsetname,
+                std::vector<hsize_t> start, std::vector<hsize_t> stride,
+                std::vector<hsize_t> count, std::vector<hsize_t> block,
+                hid_t mem_type, void *data, bool *ok)
+{
+  // the hyperslab may well lie beyond the end of the dataset
+  H5Eset_auto (H5E_DEFAULT, 0, 0);
+  hid_t file = H5Fopen (filename.c_str (), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dset = file < 0 ? -1 : H5Dopen (file, dsetname.c_str (), H5P_DEFAULT);
+  hid_t space = dset < 0 ? -1 : H5Dget_space (dset);
+  bool result = false;
+  if (space >= 0 && H5Sget_simple_extent_ndims (space) == (int)start.size ()
+      && H5Sselect_hyperslab (space, H5S_SELECT_SET, &start[0], &stride[0],
+                              &count[0], &block[0]) >= 0
+      && H5Sselect_valid (space) > 0)
+    {
+      hsize_t npoints = H5Sget_select_npoints (space);
+      hid_t mem_space = H5Screate_simple (1, &npoints, NULL);
+      result = H5Dread (dset, mem_type, mem_space, space, H5P_DEFAULT,
+                        data) >= 0;
+      H5Sclose (mem_space);
+    }
+  if (space >= 0)
+    H5Sclose (space);
+  if (dset >= 0)
+    H5Dclose (dset);
+  if (file >= 0)
+    H5Fclose (file);
+  *ok = result;
+}
+
+// Wait for the hyperslab being read ahead, and discard it.
+void
+readahead_cancel ()
+{
+  H5Readahead& ra = h5read_readahead;
+  if (ra.worker.joinable ())
+    ra.worker.join ();
+  if (ra.mem_type >= 0)
+    H5Tclose (ra.mem_type);
+  ra.mem_type = -1;
+  ra.next = octave_value ();
+}
+
+// Return the hyperslab START, COUNT, STRIDE, BLOCK (as given to h5read)
+// of the dataset DSETNAME in FILENAME if it has been read ahead, or an
+// undefined value. Any other hyperslab read ahead is discarded.
+octave_value
+readahead_take (const string& filename, const string& dsetname,
+                const Matrix& start, const Matrix& count,
+                const Matrix& stride, const Matrix& block)
+{
+  H5Readahead& ra = h5read_readahead;
+  octave_value retval;
+  if (ra.worker.joinable ())
+    ra.worker.join ();
+  if (ra.next.is_defined () && ra.ok && ra.filename == filename
+      && ra.dsetname == dsetname && same_vec (ra.next_start, start)
+      && same_vec (ra.count, count) && same_vec (ra.stride, stride)
+      && same_vec (ra.block, block))
+    {
+      retval = ra.next;
+      retval.maybe_mutate ();
+    }
+  readahead_cancel ();
+  return retval;
+}
+
+// Note that the hyperslab START, COUNT, STRIDE, BLOCK (as given to
+// h5read) of the dataset DSETNAME in FILENAME has been read as RESULT,
+// and start reading the next one ahead if the reads are sequential.
+void
+readahead_record (const string& filename, const string& dsetname,
+                  const Matrix& start, const Matrix& count,
+                  const Matrix& stride, const Matrix& block,
+                  const octave_value& result)
+{
+  H5Readahead& ra = h5read_readahead;
+  readahead_cancel ();
+
+  // the one dimension along which the start moved forward
+  int moved = -1;
+  bool sequential = (ra.filename == filename && ra.dsetname == dsetname
+                     && same_vec (ra.count, count)
+                     && same_vec (ra.stride, stride)
+                     && same_vec (ra.block, block)
+                     && ra.start.nelem () == start.nelem ());
+  for (octave_idx_type i = 0; sequential && i < start.nelem (); i++)
+    if (start(i) != ra.start(i))
+      {
+        sequential = (moved < 0 && start(i) > ra.start(i));
+        moved = i;
+      }
+  sequential = sequential && moved >= 0;
+
+  Matrix next_start = start;
+  if (sequential)
+    next_start(moved) += start(moved) - ra.start(moved);
+  ra.filename = filename;
+  ra.dsetname = dsetname;
+  ra.start = start;
+  ra.count = count;
+  ra.stride = stride;
+  ra.block = block;
+
+#ifdef H5_HAVE_THREADSAFE
+#ifdef H5_HAVE_PARALLEL
+  // the processes of an MPI program read their own hyperslabs
+  int initialized = 0;
+  MPI_Initialized (&initialized);
+  if (initialized)
+    return;
+#endif
+  // a count of 0 reads as many blocks as there are, which depends on
+  // the start
+  for (octave_idx_type i = 0; i < count.nelem (); i++)
+    sequential = sequential && count(i) > 0;
+  hid_t type = -1;
+  if (sequential && result.is_real_type ())
+    type = native_type_by_name (result.class_name ());
+  if (type < 0 || result.numel () * H5Tget_size (type) > H5READ_READAHEAD_BYTES)
+    return;
+
+  // the arguments are given in reverse order
+  int rank = start.nelem ();
+  std::vector<hsize_t> hstart (rank), hstride (rank, 1), hcount (rank);
+  std::vector<hsize_t> hblock (rank, 1);
+  for (int i = 0; i < rank; i++)
+    {
+      hstart[rank-i-1] = next_start(i);
+      hcount[rank-i-1] = count(i);
+      if (stride.nelem () == rank)
+        hstride[rank-i-1] = stride(i);
+      if (block.nelem () == rank)
+        hblock[rank-i-1] = block(i);
+    }
+
+  void *data;
+  ra.next = alloc_numeric_array (type, result.dims (), &data, &ra.mem_type);
+  ra.next_start = next_start;
+  ra.ok = false;
+  ra.worker = std::thread (readahead_read, filename, dsetname, hstart,
+                           hstride, hcount, hblock, ra.mem_type, data,
+                           &ra.ok);
+#endif
+}
+
+// error codes of read_stack_member
+enum
+{
+  H5STACK_OK = 0,
+  H5STACK_OPEN_FILE,
+  H5STACK_OPEN_DSET,
+  H5STACK_SHAPE,
+  H5STACK_TYPE,
+  H5STACK_READ,
+  H5STACK_NOT_DONE    // taken by a worker process which died
+};
+
+// Read the hyperslab HSTART, HCOUNT of the dataset DSETNAME in the file
+// FILENAME into BUF, converted to MEM_TYPE. The dataset must have the
+// dimensions DIMS and a type of the class CLS. Returns an H5STACK_ code.
+// As only HDF5 functions are called, this can run in a worker process.
+int
+read_stack_member (const char *filename, const char *dsetname,
+                   const std::vector<hsize_t>& dims, H5T_class_t cls,
+                   const std::vector<hsize_t>& hstart,
+                   const std::vector<hsize_t>& hcount,
+                   hid_t mem_type, void *buf)
+{
+  int rank = dims.size ();
+  hid_t file = H5Fopen (filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file < 0)
+    return H5STACK_OPEN_FILE;
+  hid_t dset = H5Dopen (file, dsetname, H5P_DEFAULT);
+  if (dset < 0)
+    {
+      H5Fclose (file);
+      return H5STACK_OPEN_DSET;
+    }
+
+  int result = H5STACK_OK;
+  hid_t space = H5Dget_space (dset);
+  std::vector<hsize_t> fdims (max (rank, 1));
+  if (H5Sget_simple_extent_ndims (space) != rank
+      || H5Sget_simple_extent_dims (space, &fdims[0], NULL) < 0
+      || ! std::equal (dims.begin (), dims.end (), fdims.begin ()))
+    result = H5STACK_SHAPE;
+
+  hid_t type = H5Dget_type (dset);
+  if (result == H5STACK_OK && H5Tget_class (type) != cls)
+    result = H5STACK_TYPE;
+  H5Tclose (type);
+
+  if (result == H5STACK_OK)
+    {
+      hsize_t npoints = 1;
+      for (int k = 0; k < rank; k++)
+        npoints *= hcount[k];
+      hid_t mem_space = H5Screate_simple (1, &npoints, NULL);
+      if ((rank > 0
+           && H5Sselect_hyperslab (space, H5S_SELECT_SET, &hstart[0], NULL,
+                                   &hcount[0], NULL) < 0)
+          || H5Dread (dset, mem_type, mem_space, space, H5P_DEFAULT, buf) < 0)
+        result = H5STACK_READ;
+      H5Sclose (mem_space);
+    }
+
+  H5Sclose (space);
+  H5Dclose (dset);
+  H5Fclose (file);
+  return result;
+}
+
+// Read the members of a stack, taking the next one from NEXT until all
+// NFILES are read, into consecutive slabs of SLABBYTES bytes of BUF,
+// and store their H5STACK_ codes in RESULTS.
+void
+read_stack_worker (const string_vector& files, const char *dsetname,
+                   const std::vector<hsize_t>& dims, H5T_class_t cls,
+                   const std::vector<hsize_t>& hstart,
+                   const std::vector<hsize_t>& hcount, hid_t mem_type,
+                   char *buf, size_t slabbytes, int *results,
+                   std::atomic<octave_idx_type> *next)
+{
+  octave_idx_type nfiles = files.numel ();
+  for (octave_idx_type i = (*next)++; i < nfiles; i = (*next)++)
+    results[i] = read_stack_member (files[i].c_str (), dsetname, dims, cls,
+                                    hstart, hcount, mem_type,
+                                    buf + i * slabbytes);
+}
+
+// Read the hyperslab START, COUNT (given as for h5read, the whole
+// dataset if empty) of the dataset DSETNAME from each of the FILES, and
+// return them stacked along a new last dimension. The first file
+// determines the dimensions and the type, which all others must have.
+// The array is allocated once; the files are read by up to NWORKERS
+// processes at a time, since HDF5 serializes all calls within one
+// process. The workers are forked and read into a shared mapping, which
+// is then copied into the array.
+octave_value
+read_stack (const string_vector& files, const string& dsetname,
+            const Matrix& start, const Matrix& count, int nworkers)
+{
+  octave_value retval;
+  octave_idx_type nfiles = files.numel ();
+
+  // no thread may be in the library when the workers are forked
+  readahead_cancel ();
+
+  H5E_auto_t oef;
+  void *olderr;
+  H5Eget_auto (H5E_DEFAULT, &oef, &olderr);
+  H5Eset_auto (H5E_DEFAULT, 0, 0);
+
+  // the dimensions and type of the first file
+  int rank = -1;
+  std::vector<hsize_t> dims;
+  hid_t type = -1;
+  hid_t file = H5Fopen (files[0].c_str (), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dset = (file < 0 ? -1 : H5Dopen (file, dsetname.c_str (),
+                                         H5P_DEFAULT));
+  if (dset >= 0)
+    {
+      hid_t space = H5Dget_space (dset);
+      rank = H5Sget_simple_extent_ndims (space);
+      dims.resize (max (rank, 1));
+      H5Sget_simple_extent_dims (space, &dims[0], NULL);
+      dims.resize (max (rank, 0));
+      H5Sclose (space);
+      type = H5Dget_type (dset);
+      H5Dclose (dset);
+    }
+  if (file >= 0)
+    H5Fclose (file);
+  H5Eset_auto (H5E_DEFAULT, oef, olderr);
+  if (file < 0)
+    {
+      error ("Opening the file failed, %s", files[0].c_str ());
+      return retval;
+    }
+  if (rank < 0)
+    {
+      error ("Error opening dataset %s of %s", dsetname.c_str (),
+             files[0].c_str ());
+      return retval;
+    }
+
+  H5T_class_t cls = H5Tget_class (type);
+  if (cls != H5T_INTEGER && cls != H5T_FLOAT)
+    {
+      H5Tclose (type);
+      error ("h5readstack only reads integer and floating point datasets");
+      return retval;
+    }
+
+  // the hyperslab, in the order of the file
+  std::vector<hsize_t> hstart (rank, 0), hcount (dims);
+  if (! start.is_empty ())
+    {
+      if (start.nelem () != rank || count.nelem () != rank)
+        {
+          H5Tclose (type);
+          error ("start and count must be vectors of length %d, the dataset rank",
+                 rank);
+          return retval;
+        }
+      for (int i = 0; i < rank; i++)
+        {
+          int k = rank-i-1;
+          hstart[k] = start(i);
+          hcount[k] = (count(i) == 0 ? dims[k] - min (hstart[k], dims[k])
+                       : (hsize_t)count(i));
+          if (hstart[k] + hcount[k] > dims[k])
+            {
+              H5Tclose (type);
+              error ("In dimension %d, dataset only has %d elements, but at least %d"
+                     " are required for requested hyperslab", i+1,
+                     (int)dims[k], (int)(hstart[k] + hcount[k]));
+              return retval;
+            }
+        }
+    }
+
+  // the stacked array, in the type h5read would return
+  dim_vector stack_dims;
+  stack_dims.resize (max (rank, 2) + 1);
+  stack_dims(0) = stack_dims(1) = 1;
+  hsize_t slabnumel = 1;
+  for (int i = 0; i < rank; i++)
+    {
+      stack_dims(i) = hcount[rank-i-1];
+      slabnumel *= hcount[i];
+    }
+  stack_dims(max (rank, 2)) = nfiles;
+  void *data;
+  hid_t mem_type;
+  retval = alloc_numeric_array (cls == H5T_INTEGER ? type : H5T_NATIVE_DOUBLE,
+                                stack_dims, &data, &mem_type);
+  H5Tclose (type);
+  if (retval.is_undefined ())
+    {
+      error ("unknown integer size of dataset %s", dsetname.c_str ());
+      return retval;
+    }
+  size_t slabbytes = slabnumel * H5Tget_size (mem_type);
+
+  nworkers = max<octave_idx_type> (min<octave_idx_type> (nworkers, nfiles), 1);
+#ifdef H5_HAVE_PARALLEL
+  // forking an MPI process is not safe with most MPI libraries
+  int initialized = 0;
+  MPI_Initialized (&initialized);
+  if (initialized)
+    nworkers = 1;
+#endif
+  std::vector<int> results (nfiles, H5STACK_OK);
+  bool worker_died = false;
+  H5Eset_auto (H5E_DEFAULT, 0, 0);
+#ifdef H5_STACK_WORKERS
+  if (nworkers > 1)
+    {
+      // the workers and this process read into a shared mapping, with
+      // the counter of the next file and the results at its start
+      size_t header = ((sizeof (std::atomic<octave_idx_type>)
+                        + nfiles * sizeof (int) + 63) / 64) * 64;
+      size_t mapsize = header + nfiles * slabbytes;
+      void *map = mmap (NULL, mapsize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+      if (map != MAP_FAILED)
+        {
+          std::atomic<octave_idx_type> *next
+            = new (map) std::atomic<octave_idx_type> (0);
+          int *shared_results = (int*)((char*)map + sizeof (*next));
+          std::fill (shared_results, shared_results + nfiles,
+                     (int)H5STACK_NOT_DONE);
+          char *buf = (char*)map + header;
+
+          std::vector<pid_t> pids;
+          for (int w = 1; w < nworkers; w++)
+            {
+              pid_t pid = fork ();
+              if (pid == 0)
+                {
+                  read_stack_worker (files, dsetname.c_str (), dims, cls,
+                                     hstart, hcount, mem_type, buf,
+                                     slabbytes, shared_results, next);
+                  _exit (0);
+                }
+              else if (pid > 0)
+                pids.push_back (pid);
+            }
+          // this process takes part, and reads everything if no worker
+          // could be started
+          read_stack_worker (files, dsetname.c_str (), dims, cls, hstart,
+                             hcount, mem_type, buf, slabbytes,
+                             shared_results, next);
+          for (size_t w = 0; w < pids.size (); w++)
+            {
+              int wstatus = 0;
+              if (waitpid (pids[w], &wstatus, 0) < 0
+                  || ! WIFEXITED (wstatus) || WEXITSTATUS (wstatus) != 0)
+                worker_died = true;
+            }
+
+          std::copy (shared_results, shared_results + nfiles,
+                     results.begin ());
+          memcpy (data, buf, nfiles * slabbytes);
+          munmap (map, mapsize);
+          nworkers = 0;
+        }
+    }
+#endif
+  if (nworkers != 0)
+    {
+      std::atomic<octave_idx_type> next (0);
+      read_stack_worker (files, dsetname.c_str (), dims, cls, hstart,
+                         hcount, mem_type, (char*)data, slabbytes,
+                         &results[0], &next);
+    }
+  H5Eset_auto (H5E_DEFAULT, oef, olderr);
+  H5Tclose (mem_type);
+
+  for (octave_idx_type i = 0; i < nfiles; i++)
+    {
+      const char *name = files[i].c_str ();
+      switch (results[i])
+        {
+        case H5STACK_OK:
+          continue;
+        case H5STACK_OPEN_FILE:
+          error ("Opening the file failed, %s", name);
+          break;
+        case H5STACK_OPEN_DSET:
+          error ("Error opening dataset %s of %s", dsetname.c_str (), name);
+          break;
+        case H5STACK_SHAPE:
+          error ("The dataset %s of %s has other dimensions than in %s",
+                 dsetname.c_str (), name, files[0].c_str ());
+          break;
+        case H5STACK_TYPE:
+          error ("The dataset %s of %s has another type class than in %s",
+                 dsetname.c_str (), name, files[0].c_str ());
+          break;
+        case H5STACK_NOT_DONE:
+          error ("the worker process reading %s died", name);
+          break;
+        default:
+          error ("error when reading the dataset %s of %s", dsetname.c_str (),
+                 name);
+        }
+      return octave_value ();
+    }
+  if (worker_died)
+    {
+      error ("a worker process of h5readstack died");
+      return octave_value ();
+    }
+
+  if (h5stats_current != NULL)
+    h5stats_current->bytes_read += nfiles * slabbytes;
+  retval.maybe_mutate ();
+  return retval;
+}
+
+int octave_h5dataset::t_id (-1);
+
+const std::string octave_h5dataset::t_name ("h5dataset");
+
+void
+octave_h5dataset::register_type ()
+{
+  static octave_h5dataset exemplar;
+  octave_value v (&exemplar, true);
+  t_id = octave_value_typeinfo::register_type (t_name, t_name, v);
+}
+
+dim_vector
+octave_h5dataset::dims () const
+{
+  file->proxy_dims (mat_dims);
+  return mat_dims;
+}
+
+octave_value
+octave_h5dataset::subsref (const std::string& type,
+                           const std::list<octave_value_list>& idx)
+{
+  if (type[0] != '(')
+    {
+      error ("%s cannot be indexed with %c", type_name ().c_str (), type[0]);
+      return octave_value ();
+    }
+
+  octave_value retval;
+  {
+    H5StatsScope stats ("h5dataset", dsetname);
+    retval = file->read_dset_index (idx.front ());
+  }
+  if (error_state || idx.size () < 2)
+    return retval;
+  return retval.next_subsref (type, idx);
+}
+
+NDArray
+octave_h5dataset::array_value (bool) const
+{
+  octave_value retval;
+  {
+    H5StatsScope stats ("h5dataset", dsetname);
+    retval = file->read_dset_index (octave_value_list ());
+  }
+  if (error_state)
+    return NDArray ();
+  return retval.array_value ();
+}
+
+void
+octave_h5dataset::print (std::ostream& os, bool pr_as_read_syntax)
+{
+  print_raw (os, pr_as_read_syntax);
+  newline (os);
+}
+
+void
+octave_h5dataset::print_raw (std::ostream& os, bool) const
+{
+  indent (os);
+  os << "<" << mat_dims.str () << " " << data_class << " dataset "
+     << dsetname << " in " << filename << ">";
+}
+
+bool
+octave_h5dataset::print_name_tag (std::ostream& os,
+                                  const std::string& name) const
+{
+  indent (os);
+  os << name << " = ";
+  return false;
+}
+
+#endif
+
+DEFUN_DLD (h5read, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname}, @var{start}, @var{count})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname}, @var{start}, @var{count}, @var{stride})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5read (@var{filename}, @var{dsetname}, @var{start}, @var{count}, @var{stride}, @var{block})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5read (@dots{}, @var{key}, @var{val}, @dots{})\n\
+Read a hyperslab of data from an HDF5 file specified by its @var{filename}. \n\
+The datatype will be coerced to double.\n\
+For example:\n\
+\n\
+@example\n\
+@group\n\
+data = h5read (\"mydata.h5\", \"/grid/time\");\n\
+@end group\n\
+@end example\n\
+\n\
+The variable @var{dsetname} is the name of the dataset in the HDF5\n\
+file to read. It has to be specified by its absolute path (or relative\n\
+to the root group / ).\n\
+\n\
+The other four arguments are 1xn or nx1 matrices, where n is the number of dimensions\n\
+in the dataset. If all are omitted, the entire dataset will be read.\n\
+\n\
+@var{start} is a 1-based starting offset\n\
+@var{count} is the number of blocks to read. If 0 or Inf\n\
+is specified in any dimension, as many blocks as possible \n\
+are read in that dimension (this is not valid for @code{h5write}).\n\
+@var{stride} is the offset between the start of each block. \n\
+Defaults to a vector of ones.\n\
+@var{block} is the size of each block to read. Defaults to a vector of ones.\n\
+\n\
+Datasets having a compound type consisting of two double values will\n\
+be interpreted as complex valued. Other compound datasets are returned\n\
+as a struct with one field per member, each holding an array of the\n\
+selected records in the Octave type matching the member type. Members\n\
+stored as the enum of logical datasets are returned as logical arrays,\n\
+other members which are not integer or floating point are skipped.\n\
+\n\
+The hyperslab arguments may be followed by @var{key}, @var{val} pairs:\n\
+\n\
+@table @asis\n\
+@item @option{Fields}\n\
+A string or a cell array of strings naming the members of a compound\n\
+dataset to read. Only these members are transferred from the file.\n\
+\n\
+@item @option{OutputType}\n\
+The class of the returned array for integer and floating point\n\
+datasets, one of the strings @samp{double} @samp{single} @samp{uint64}\n\
+@samp{uint32} @samp{uint16} @samp{uint8} @samp{int64} @samp{int32}\n\
+@samp{int16} @samp{int8}. The data is converted while it is read, so\n\
+that no intermediate copy in the type of the dataset is made.\n\
+\n\
+@item @option{ScaleFactor}, @option{AddOffset}\n\
+Return @code{data * ScaleFactor + AddOffset} instead of the stored\n\
+values (as for the CF conventions' @code{scale_factor} and\n\
+@code{add_offset} attributes). This is applied in the same pass as the\n\
+type conversion. The result is double unless @option{OutputType} is\n\
+given, also for packed integer data.\n\
+\n\
+@item @option{Order}\n\
+@samp{F} (the default) returns the dimensions of the dataset in\n\
+reverse order, so that the array has the same memory layout as in the\n\
+file. @samp{C} returns them in the order of the file, i.e. as C, h5py\n\
+or the @command{h5dump} tool index the dataset; @var{start}, @var{count},\n\
+@var{stride} and @var{block} are then given in that order as well. The\n\
+data is transposed while it is copied out of the library's buffers, a\n\
+slab at a time and on several threads for large datasets, so no\n\
+@code{permute} of the whole array is needed. This is supported for\n\
+integer, floating point and complex datasets.\n\
+\n\
+@item @option{Collective}\n\
+If true, and hdf5oct was built against parallel HDF5 and runs under\n\
+MPI with several processes, the data is read with collective MPI-IO\n\
+transfers, in which the processes read their (different) hyperslabs\n\
+together. Otherwise it is ignored. See @code{h5write}.\n\
+\n\
+@item @option{ReuseBuffer}\n\
+If true, the returned integer or floating point array is kept, and a\n\
+later call with this option that reads data of the same class and\n\
+dimensions fills it again in place instead of allocating a new array,\n\
+as soon as nothing else refers to it any more. Two arrays are kept, so\n\
+a loop like @code{for k = 1:n, x = h5read (@dots{}, \"ReuseBuffer\",\n\
+true); @dots{}, end} makes no large allocations after its first two\n\
+iterations. The result is an ordinary array, which may be kept (then\n\
+it is not reused). As the kept array still refers to it, modifying the\n\
+result in place, e.g. with @code{x(i) = v}, copies the whole array\n\
+first; read it without this option if it is to be modified. Arrays of\n\
+other classes or dimensions replace the kept ones, and\n\
+@code{\"ReuseBuffer\", false} releases them.\n\
+@end table\n\
+\n\
+When consecutive calls without options read hyperslabs of the same\n\
+shape from a dataset, each starting further along one dimension by the\n\
+same step, the next hyperslab of this sequence is read and decompressed\n\
+in the background (with a thread-safe HDF5 library), so that the next\n\
+call returns it at once. This uses at most 256 MB, and the hyperslab is\n\
+discarded by any other access to a file.\n\
+\n\
+String datasets are read with a single call to the HDF5 library.\n\
+Fixed length strings of a scalar or one dimensional dataset are\n\
+returned as a char matrix with one string per row; variable length\n\
+strings and strings of higher rank datasets are returned as a cell\n\
+array of strings.\n\
+\n\
+Generally this function tries to use the Octave datatype of\n\
+the appropriate size for the given HDF5 type. Integer and floating\n\
+point data stored in the byte order of another machine is read\n\
+without conversion and byte swapped in place.\n\
+\n\
+@seealso{h5write}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature ("h5read", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  // the hyperslab arguments may be followed by key/value options
+  int npos = nargin;
+  for (int i = 2; i < nargin; i++)
+    {
+      if (args(i).is_string ())
+        {
+          npos = i;
+          break;
+        }
+    }
+
+  if (npos < 2 || npos == 3 || npos > 6 || (nargin - npos) % 2 != 0
+      || nargout > 1)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args (1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string dsetname = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  H5ReadOptions opts;
+  if (! parse_read_options (args, npos, opts))
+    return octave_value_list ();
+  // hyperslabs read without options may be read ahead
+  bool readahead = (npos == nargin && nargin >= 4);
+  nargin = npos;
+
+  H5StatsScope stats ("h5read", dsetname);
+
+  if (nargin < 4)
+    {
+      //open the hdf5 file
+      H5File file (filename.c_str (), false);
+      if (error_state)
+        return octave_value_list ();
+      file.set_read_options (opts);
+
+      octave_value retval = file.read_dset_complete (dsetname.c_str ());
+      return retval;
+    }
+  else
+    {
+      Matrix start, count, stride, block;
+      int err = 0;
+    
+      err = err || ! check_vec (args(2), start, "START", false);
+      start -= 1;
+
+      err = err || ! check_vec (args(3), count, "COUNT", true);
+
+      if (nargin < 5)
+        stride = Matrix ();
+      else
+        err = err || ! check_vec (args(4), stride, "STRIDE", false);
+
+      if (nargin < 6)
+        block = Matrix ();
+      else
+        err = err || ! check_vec (args(5), block, "BLOCK", false);
+
+      if (err)
+        return octave_value_list ();
+
+      octave_value retval;
+      if (readahead)
+        retval = readahead_take (filename, dsetname, start, count, stride,
+                                 block);
+      if (retval.is_undefined ())
+        {
+          //open the hdf5 file
+          H5File file (filename.c_str (), false);
+          if (error_state)
+            return octave_value_list ();
+          file.set_read_options (opts);
+
+          retval = file.read_dset_hyperslab (dsetname.c_str (), start, count,
+                                             stride, block, nargin-2);
+          if (error_state)
+            return octave_value_list ();
+        }
+      if (readahead)
+        readahead_record (filename, dsetname, start, count, stride, block,
+                          retval);
+      return retval;
+    }
+#endif
+}
+
+DEFUN_DLD (h5readatt, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{data} =} h5readatt (@var{filename}, @var{objectname}, @var{attname})\n\
+\n\
+Reads one attribute of an object from an HDF5 file, specified by the\n\
+@var{filename} and the @var{objectname}.\n\
+The third argument @var{attname} is the name of the attribute which \n\
+is to read.\n\
+\n\
+Numeric attributes may be scalars or arrays of any rank, and are\n\
+returned with the Octave type of the appropriate size for their HDF5\n\
+integer or floating point type.\n\
+\n\
+@seealso{h5writeatt}\n\
+@end deftypefn")
+{
+  octave_value retval;
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature ("h5readatt", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+  if (nargin != 3)
+    {
+      print_usage ();
+      return retval;
+    }
+  if (! (args(0).is_string () && args(1).is_string () && args(2).is_string ()))
+    {
+      print_usage ();
+      return retval;
+    }
+
+  string filename = args(0).string_value ();
+  string objname = args(1).string_value ();
+  string attname = args(2).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  H5StatsScope stats ("h5readatt", objname);
+  
+  //open the hdf5 file
+  H5File file (filename.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+        
+  retval = file.read_att (objname.c_str (), attname.c_str ());
+  return retval;
+
+#endif
+}
+
+
+DEFUN_DLD (h5write, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data})\n\
+@deftypefnx {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data}, @var{start}, @var{count})\n\
+@deftypefnx {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data}, @var{start}, @var{count}, @var{stride})\n\
+@deftypefnx {Loadable Function} h5write (@var{filename}, @var{dsetname}, @var{data}, @var{start}, @var{count}, @var{stride}, @var{block})\n\
+@deftypefnx {Loadable Function} h5write (@dots{}, @var{key}, @var{val}, @dots{})\n\
+\n\
+Write a matrix @var{data} to the specified location @var{dsetname} in \n\
+a HDF5 file specified by @var{filename}.\n\
+\n\
+In the  simplest form of this function, if the file @var{filename} does\n                                       \
+not exist, it will be created and if the dataset @var{dsetname} already\n\
+exists, it will be overwritten.\n\
+\n\
+If more than three arguments are specified, an error will be raised if\n\
+the file @var{filename} or the dataset @var{dsetname} do not exist\n\
+(use @code{h5create} in order to create an file or an empty dataset).\n \
+If the dataset exists, the data will be written into the specified \n\
+hyperslab. This way it is possible to append data to existing datasets,\n\
+provided their maximum size is sufficiently large.\n\
+\n\
+@var{start} is a 1-based starting offset\n\
+@var{count} is the number of blocks to read. In view of @code{h5read}, note that 0 or Inf\n\
+are not valid elements here.\n\
+@var{stride} is the offset between the start of each block. \n\
+Defaults to a vector of ones.\n\
+@var{block} is the size of each block to read. Defaults to a vector of ones.\n\
+\n\
+Complex valued data will lead to datasets having a compound type consisting\n\
+of two double values.\n\
+\n\
+A char matrix is written as a dataset of fixed length strings, one per\n\
+row, and a cell array of strings as a dataset of variable length\n\
+strings of the same shape.\n\
+\n\
+Generally this function tries to use the HDF5 datatype of\n\
+the appropriate size for the given Octave type.\n\
+\n\
+With the option @option{Order} @samp{C}, the dimensions of @var{data}\n\
+(and the hyperslab arguments) are taken in the order of the file\n\
+instead of reversed, see @code{h5read}. Cell arrays of strings can only\n\
+be written in the default order.\n\
+\n\
+When hdf5oct is built against parallel HDF5 (@code{make parallel}) and\n\
+runs under MPI with several processes (e.g. started by @command{mpirun}\n\
+and initialized by the MPI package), all processes open the files with\n\
+the MPI-IO driver and have to call the functions of this package in the\n\
+same order with the same files and objects. Each process can write its\n\
+own hyperslab of a dataset created by all of them, which is extended to\n\
+the largest extent that any of them needs. With the option\n\
+@option{Collective} true, the hyperslabs are written with collective\n\
+MPI-IO transfers, which lets the MPI library aggregate them into large\n\
+requests. It cannot be combined with @option{Order} @samp{C}, and\n\
+datasets with a zone map cannot be written by several processes.\n\
+\n\
+@seealso{h5read}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature ("h5write", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  // the hyperslab arguments may be followed by key/value options
+  int npos = nargin;
+  for (int i = 3; i < nargin; i++)
+    {
+      if (args(i).is_string ())
+        {
+          npos = i;
+          break;
+        }
+    }
+
+  if (! (npos == 3 || npos == 5 || npos  == 6 || npos == 7)
+      || (nargin - npos) % 2 != 0 || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  
+  if (error_state)
+    return octave_value_list ();
+
+  H5WriteOptions opts;
+  if (! parse_write_options (args, npos, opts))
+    return octave_value_list ();
+  nargin = npos;
+
+  H5StatsScope stats ("h5write", location);
+
+  if (nargin == 3)
+    {
+      //open the hdf5 file, create it if it does not exist
+      H5File file (filename.c_str (), true);
+      if (error_state)
+        return octave_value_list ();
+      file.set_write_options (opts);
+      file.write_dset (location.c_str (),
+                       args(2));
+    }
+  else  
+    {
+      //open the hdf5 file, complain if it does not exist
+      H5File file (filename.c_str (), false);
+      if (error_state)
+        return octave_value_list ();
+      file.set_write_options (opts);
+
+      Matrix start, count, stride, block;
+      int err = 0;
+      err = err || ! check_vec (args(3), start, "START", false);
+      start -= 1;
+
+      // A count value 0 is not allowed when writing data.
+      err = err || ! check_vec (args(4), count, "COUNT", false);
+
+      if (nargin <= 5)
+        stride = Matrix ();
+      else
+        err = err || ! check_vec (args(5), stride, "STRIDE", false);
+
+      if (nargin <= 6)
         block = Matrix ();
       else
-        err = err || ! check_vec (args(6), block, "BLOCK", false);
+        err = err || ! check_vec (args(6), block, "BLOCK", false);
+
+      if (err)
+        return octave_value_list ();
+
+      file.write_dset_hyperslab (location.c_str (),
+                                 args(2),
+                                 start, count, stride, block, nargin-3);
+    }
+
+  return octave_value_list ();
+#endif
+}
+
+
+DEFUN_DLD (h5writestruct, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5writestruct (@var{filename}, @var{location}, @var{s})\n\
+\n\
+Write the scalar struct @var{s} to the group @var{location} in the\n\
+HDF5 file specified by @var{filename}, which is created if it does not\n\
+exist.\n\
+\n\
+The group and the groups above it are created if necessary. Each field\n\
+of @var{s} that is a struct becomes a subgroup, written in the same\n\
+way. Single line strings and real scalars become attributes of the\n\
+group, and any other numeric, logical or char array or cell array of\n\
+strings becomes a dataset, as with @code{h5write}. Existing attributes\n\
+and datasets of the same names are overwritten.\n\
+\n\
+The file is opened once and flushed once at the end, which is much\n\
+faster than writing each field with a separate call.\n\
+\n\
+@seealso{h5write, h5writeatt}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5writestruct", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin != 3 || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(2).is_map () && args(2).numel () == 1))
+    {
+      error ("S must be a scalar struct");
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  octave_scalar_map s = args(2).scalar_map_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  H5StatsScope stats ("h5writestruct", location);
+
+  //open the hdf5 file, create it if it does not exist
+  H5File file (filename.c_str (), true);
+  if (error_state)
+    return octave_value_list ();
+  file.write_struct (location.c_str (), s);
+
+  return octave_value_list ();
+#endif
+}
+
+
+DEFUN_DLD (h5readgroup, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{s} =} h5readgroup (@var{filename}, @var{location})\n\
+@deftypefnx {Loadable Function} {@var{s} =} h5readgroup (@dots{}, @var{key}, @var{val})\n\
+\n\
+Read the group @var{location} of the HDF5 file specified by\n\
+@var{filename} into the struct @var{s}, the reverse of\n\
+@code{h5writestruct}. Each attribute of the group and each dataset in\n\
+it becomes a field of @var{s}, read as by @code{h5readatt} and\n\
+@code{h5read}. Groups holding a sparse matrix, as @code{h5write}\n\
+writes them, become sparse fields too. Zone maps of datasets (see\n\
+@code{h5create}) are left out.\n\
+\n\
+The following option may be given as a key/value pair:\n\
+\n\
+@table @asis\n\
+@item @option{Recursive}\n\
+If true, subgroups become nested structs, read in the same way.\n\
+Otherwise (the default) they are left out.\n\
+@end table\n\
+\n\
+The members of the group are listed in one pass and the datasets are\n\
+read in the order in which their data is stored in the file. The raw\n\
+chunks of datasets compressed with deflate (and shuffle) are read\n\
+without decompression and decompressed on several threads, which is\n\
+much faster than reading each dataset with @code{h5read}.\n\
+\n\
+@seealso{h5writestruct, h5read, h5readatt}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5readgroup", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin < 2 || nargin % 2 != 0 || nargout > 1)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  bool recursive = false;
+  for (int i = 2; i+1 < nargin; i+=2)
+    {
+      if (args(i).string_value () == "Recursive")
+        {
+          recursive = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("Recursive argument must be true or false");
+              return octave_value_list ();
+            }
+        }
+      else
+        {
+          error ("unknown parameter name %s", args(i).string_value ().c_str ());
+          return octave_value_list ();
+        }
+    }
+
+  H5StatsScope stats ("h5readgroup", location);
+
+  H5File file (filename.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+  return file.read_group (location.c_str (), recursive);
+#endif
+}
+
+
+DEFUN_DLD (h5readstack, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{data} =} h5readstack (@var{files}, @var{dsetname})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5readstack (@var{files}, @var{dsetname}, @var{start}, @var{count})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5readstack (@dots{}, @var{key}, @var{val})\n\
+\n\
+Read the dataset @var{dsetname} (or the hyperslab given by @var{start}\n\
+and @var{count}, as for @code{h5read}) from each of the HDF5 files in\n\
+the cell array of strings @var{files}, and return them stacked along a\n\
+new last dimension, i.e. @code{@var{data}(:,:,@dots{},@var{i})} holds the\n\
+data of @code{@var{files}@{@var{i}@}}.\n\
+\n\
+The first file determines the dimensions and the type of @var{data},\n\
+which is returned as by @code{h5read}. The dataset must have the same\n\
+dimensions and the same type class (integer or floating point) in all\n\
+files. Only integer and floating point datasets are supported.\n\
+\n\
+The result is allocated once, and the files are read concurrently by\n\
+several worker processes (as one process serializes all calls to the\n\
+HDF5 library), so that the throughput scales with the file system\n\
+rather than being bound by the latency of one file at a time. The\n\
+workers read into a shared memory mapping of the size of the result,\n\
+which is then copied into it, so that twice the memory of the result\n\
+is needed at the peak. In an MPI program, the files are always read by\n\
+the calling process alone. The following option may be given as a\n\
+key/value pair:\n\
+\n\
+@table @asis\n\
+@item @option{Workers}\n\
+The number of processes reading files at the same time, by default the\n\
+number of processors. With 1, the files are read one after another\n\
+straight into the result.\n\
+@end table\n\
+\n\
+@seealso{h5read}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5readstack", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  // the hyperslab arguments may be followed by key/value options
+  int npos = (nargin >= 4 && ! args(2).is_string () ? 4 : 2);
+  if (nargin < 2 || (nargin - npos) % 2 != 0 || nargout > 1)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_cellstr () && args(0).numel () > 0
+         && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string_vector files = args(0).all_strings ();
+  string dsetname = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  Matrix start, count;
+  if (npos == 4)
+    {
+      int err = 0;
+      err = err || ! check_vec (args(2), start, "START", false);
+      err = err || ! check_vec (args(3), count, "COUNT", true);
+      if (err)
+        return octave_value_list ();
+      start -= 1;
+    }
+
+  int nworkers = max (std::thread::hardware_concurrency (), 1u);
+  for (int i = npos; i+1 < nargin; i+=2)
+    {
+      if (args(i).is_string () && args(i).string_value () == "Workers")
+        {
+          nworkers = args(i+1).int_value ();
+          if (error_state || nworkers < 1)
+            {
+              error ("Workers must be a positive integer");
+              return octave_value_list ();
+            }
+        }
+      else
+        {
+          error ("unknown parameter name %s", args(i).string_value ().c_str ());
+          return octave_value_list ();
+        }
+    }
+
+  H5StatsScope stats ("h5readstack", dsetname);
+
+  return read_stack (files, dsetname, start, count, nworkers);
+#endif
+}
+
+
+DEFUN_DLD (h5dataset, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{d} =} h5dataset (@var{filename}, @var{dsetname})\n\
+\n\
+Return an object which refers to the dataset @var{dsetname} in the\n\
+HDF5 file specified by @var{filename}, without reading its data. The\n\
+file stays open while the object (or a copy of it) exists.\n\
+\n\
+@code{size (@var{d})} is the size of the array which @code{h5read}\n\
+returns for the whole dataset, and indexing @var{d} as that array,\n\
+e.g. @code{@var{d}(100:200, :, end)}, reads only the indexed elements.\n\
+Indices which are ranges with a positive increment or colons are\n\
+selected in the file; for other index vectors the range between their\n\
+smallest and largest elements is read. Linear indexing of a matrix\n\
+reads the whole dataset.\n\
+\n\
+@seealso{h5read}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5dataset", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin != 2 || nargout > 1)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string dsetname = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  static bool type_registered = false;
+  if (! type_registered)
+    {
+      octave_h5dataset::register_type ();
+      type_registered = true;
+    }
+  // the type may not be unregistered, nor this file unloaded
+  mlock ();
+
+  H5StatsScope stats ("h5dataset", dsetname);
+
+  std::shared_ptr<H5File> file (new H5File (filename.c_str (), false));
+  if (error_state)
+    return octave_value_list ();
+
+  dim_vector dims;
+  string cls;
+  if (file->open_dset_proxy (dsetname.c_str (), dims, cls) < 0)
+    return octave_value_list ();
+  return octave_value (new octave_h5dataset (file, filename, dsetname,
+                                             dims, cls));
+#endif
+}
+
+
+DEFUN_DLD (h5writeatt, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5writeatt (@var{filename}, @var{objectname}, @var{attname}, @var{attvalue})\n\
+\n\
+Write an attribute with name @var{attname} and value @var{attvalue} to\n\
+the object named @var{objectname} in the HDF5 file specified by @var{filename}.\n\
+\n\
+@var{attvalue} may be a string, or a real numeric scalar or array of any\n\
+integer or floating point type. An existing attribute of the same name\n\
+is replaced.\n\
+\n\
+Groups and datasets created by this package switch to dense attribute\n\
+storage once they carry more than a few attributes, which keeps\n\
+attribute lookup fast on objects with very many attributes.\n\
+\n\
+@seealso{h5readatt}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature ("h5writeatt", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin != 4 || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string () && args(2).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  string attname = args(2).string_value ();
+  
+  if (error_state)
+    return octave_value_list ();
+
+  H5StatsScope stats ("h5writeatt", location);
+    
+  //open the hdf5 file
+  H5File file (filename.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+
+  file.write_att (location.c_str (), attname.c_str (),
+                  args(3));
+
+  return octave_value_list ();
+#endif
+}
+
+
+DEFUN_DLD (h5append, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5append (@var{filename}, @var{dsetname}, @var{table})\n\
+@deftypefnx {Loadable Function} h5append (@var{filename}, @var{dsetname}, @var{table}, \"ChunkSize\", @var{rows})\n\
+\n\
+Append the rows of @var{table} to the one dimensional compound dataset\n\
+@var{dsetname} in the HDF5 file specified by @var{filename}.\n\
+\n\
+@var{table} is a scalar struct whose fields are real numeric or\n\
+logical arrays, all with the same number of elements. Each field\n\
+becomes a member of the compound type of the same name, and each\n\
+element a row of the table. Logical columns are stored as the enum\n\
+which @code{h5write} uses for logical arrays.\n\
+\n\
+If the file or the dataset do not exist, they are created. The\n\
+dataset is created with an unlimited extent and chunked by @var{rows}\n\
+records, which is chosen automatically if it is not given. Rows\n\
+appended to an existing dataset are matched with its members by name.\n\
+\n\
+All columns are packed into a buffer of records in memory, so that\n\
+each call writes all of them with a single write operation. Use\n\
+@code{h5read} to read the table back as a struct of columns.\n\
+\n\
+@seealso{h5read, h5write}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5append", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (! (nargin == 3 || nargin == 5) || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(2).is_map () && args(2).numel () == 1))
+    {
+      error ("TABLE must be a scalar struct");
+      return octave_value_list ();
+    }
+
+  hsize_t chunkrows = 0;
+  if (nargin == 5)
+    {
+      Matrix rows;
+      if (! args(3).is_string () || args(3).string_value () != "ChunkSize")
+        {
+          error ("unknown parameter name %s", args(3).string_value ().c_str ());
+          return octave_value_list ();
+        }
+      if (! check_vec (args(4), rows, "ChunkSize", false))
+        return octave_value_list ();
+      chunkrows = rows(0);
+    }
+
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  octave_scalar_map table = args(2).scalar_map_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  H5StatsScope stats ("h5append", location);
+
+  //open the hdf5 file, create it if it does not exist
+  H5File file (filename.c_str (), true);
+  if (error_state)
+    return octave_value_list ();
+  file.append_table (location.c_str (), table, chunkrows);
+
+  return octave_value_list ();
+#endif
+}
+
+
+DEFUN_DLD (h5reduce, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{data} =} h5reduce (@var{filename}, @var{dsetname}, @var{blockshape})\n\
+@deftypefnx {Loadable Function} {@var{data} =} h5reduce (@var{filename}, @var{dsetname}, @var{blockshape}, @var{op})\n\
+\n\
+Reduce each block of @var{blockshape} elements of the integer or\n\
+floating point dataset @var{dsetname} in the HDF5 file specified by\n\
+@var{filename} to a single value, and return the array of these\n\
+values. For example:\n\
+\n\
+@example\n\
+@group\n\
+preview = h5reduce (\"mydata.h5\", \"/grid/field\", [10 10 1], \"mean\");\n\
+@end group\n\
+@end example\n\
+\n\
+@var{blockshape} has one element per dimension of the dataset, in the\n\
+same order as the arguments of @code{h5read}, or is a scalar that\n\
+applies to all dimensions. The blocks at the upper end of a dimension\n\
+may be smaller if its size is not a multiple of the block size.\n\
+\n\
+@var{op} is one of @samp{mean} (the default), @samp{sum}, @samp{min}\n\
+and @samp{max}. As for the Octave functions of the same name,\n\
+@samp{min} and @samp{max} ignore NaN values.\n\
+\n\
+The dataset is read as double, a few rows of chunks at a time, and\n\
+each slab is reduced before the next one is read. Only the slab and\n\
+the result are held in memory, so previews of datasets much larger\n\
+than the memory can be computed.\n\
+\n\
+@seealso{h5read}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5reduce", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (! (nargin == 3 || nargin == 4) || nargout > 1)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (nargin == 4 && ! args(3).is_string ())
+    {
+      error ("OP must be a string");
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string dsetname = args(1).string_value ();
+  string op = (nargin == 4 ? args(3).string_value () : "mean");
+  Matrix blockshape;
+  if (error_state || ! check_vec (args(2), blockshape, "BLOCKSHAPE", false))
+    return octave_value_list ();
+  if (op != "mean" && op != "sum" && op != "min" && op != "max")
+    {
+      error ("OP must be one of mean, sum, min or max");
+      return octave_value_list ();
+    }
+
+  H5StatsScope stats ("h5reduce", dsetname);
+
+  H5File file (filename.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+
+  return file.reduce_dset (dsetname.c_str (), blockshape, op);
+#endif
+}
+
+DEFUN_DLD (h5stat, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{s} =} h5stat (@var{filename}, @var{dsetname})\n\
+@deftypefnx {Loadable Function} {@var{s} =} h5stat (@var{filename}, @var{dsetname}, @var{dims})\n\
+@deftypefnx {Loadable Function} {@var{s} =} h5stat (@dots{}, \"Edges\", @var{edges})\n\
+\n\
+Compute statistics of the integer or floating point dataset\n\
+@var{dsetname} in the HDF5 file specified by @var{filename}, without\n\
+reading it into memory as a whole. The result is a struct with the\n\
+fields\n\
+\n\
+@table @code\n\
+@item count\n\
+the number of values which are not NaN\n\
+@item nan_count\n\
+the number of NaN values\n\
+@item min\n\
+@itemx max\n\
+the smallest and largest value, in the class of the dataset\n\
+@item mean\n\
+@itemx std\n\
+the mean and the standard deviation (normalized with count-1, as by\n\
+@code{std}) of the values which are not NaN\n\
+@item histogram\n\
+only if @var{edges} is given, the number of values in each bin, as\n\
+counted by @code{histc (values, @var{edges})}\n\
+@end table\n\
+\n\
+By default all elements are summarized. If the vector @var{dims} is\n\
+given, only the dimensions it lists (in the order of the arguments of\n\
+@code{h5read}) are reduced, and each field is an array of the size of\n\
+the dataset with these dimensions set to 1. @code{histogram} then has\n\
+one more trailing dimension for the bins.\n\
+\n\
+The dataset is read in its own type a few rows of chunks at a time.\n\
+Each slab is split among several threads, whose partial statistics\n\
+are merged at the end.\n\
+\n\
+@seealso{h5reduce, h5read}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5stat", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  int npos = (nargin >= 3 && ! args(2).is_string () ? 3 : 2);
+  if (nargin < 2 || (nargin - npos) % 2 != 0 || nargout > 1)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string dsetname = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  Matrix dims, edges;
+  if (npos == 3 && ! check_vec (args(2), dims, "DIMS", false))
+    return octave_value_list ();
+  for (int i = npos; i < nargin; i += 2)
+    {
+      if (args(i).is_string () && args(i).string_value () == "Edges")
+        {
+          edges = args(i+1).matrix_value ();
+          if (error_state || ! (edges.is_vector () || edges.is_empty ()))
+            {
+              error ("Edges must be a vector");
+              return octave_value_list ();
+            }
+          for (octave_idx_type k = 1; k < edges.numel (); k++)
+            if (! (edges(k-1) < edges(k)))
+              {
+                error ("Edges must be increasing");
+                return octave_value_list ();
+              }
+        }
+      else
+        {
+          error ("unknown parameter name %s", args(i).string_value ().c_str ());
+          return octave_value_list ();
+        }
+    }
+
+  H5StatsScope stats ("h5stat", dsetname);
+
+  H5File file (filename.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+
+  return file.stat_dset (dsetname.c_str (), dims, edges);
+#endif
+}
+
+DEFUN_DLD (h5query, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {[@var{idx}, @var{values}] =} h5query (@var{filename}, @var{dsetname}, @var{lo}, @var{hi})\n\
+\n\
+Find the elements of the dataset @var{dsetname} in the HDF5 file\n\
+specified by @var{filename} whose values lie in the range\n\
+[@var{lo}, @var{hi}].\n\
+\n\
+@var{idx} is a column vector of the linear indices of these elements\n\
+into the array that @code{h5read} returns for the whole dataset, in\n\
+increasing order, and @var{values} the column vector of their values\n\
+(as double).\n\
+\n\
+The dataset must have been created by @code{h5create} with the option\n\
+@option{ZoneMap}. Only the chunks whose minimum and maximum overlap the\n\
+range are read.\n\
+\n\
+@seealso{h5create, h5read}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5query", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin != 4 || nargout > 2)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  string filename = args(0).string_value ();
+  string dsetname = args(1).string_value ();
+  double lo = args(2).double_value ();
+  double hi = args(3).double_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  H5StatsScope stats ("h5query", dsetname);
+
+  H5File file (filename.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+
+  return file.query_dset (dsetname.c_str (), lo, hi);
+#endif
+}
+
+DEFUN_DLD (h5copy, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5copy (@var{srcfile}, @var{srcname}, @var{dstfile}, @var{dstname})\n\
+@deftypefnx {Loadable Function} h5copy (@var{srcfile}, @var{srcname}, @var{dstfile}, @var{dstname}, @var{start}, @var{count})\n\
+\n\
+Copy the object @var{srcname} of the HDF5 file @var{srcfile} to\n\
+@var{dstname} in the HDF5 file @var{dstfile}, which is created if it\n\
+does not exist. Missing groups in @var{dstname} are created, but the\n\
+object itself must not exist yet.\n\
+\n\
+In the first form, a dataset or a group (with everything below it) is\n\
+copied as a whole, including its attributes and the zone map of a\n\
+dataset. The library copies the stored data, so compressed chunks\n\
+are not decompressed.\n\
+\n\
+In the second form, the hyperslab of the dataset @var{srcname} given by\n\
+@var{start} and @var{count} (as for @code{h5read}) is copied to a new\n\
+dataset with the same datatype, chunking and filters, but without\n\
+attributes. If the hyperslab consists of whole chunks, which is the\n\
+case if its start is a multiple of the chunk size and its count too,\n\
+or it extends to the end of the dataset, the chunks are copied as they\n\
+are stored (this needs HDF5 1.10.3 or later). Otherwise the data is\n\
+copied a slab at a time without type conversion.\n\
+\n\
+@seealso{h5read, h5write}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5copy", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (! (nargin == 4 || nargin == 6) || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  for (int i = 0; i < 4; i++)
+    {
+      if (! args(i).is_string ())
+        {
+          print_usage ();
+          return octave_value_list ();
+        }
+    }
+
+  string srcfile = args(0).string_value ();
+  string srcname = args(1).string_value ();
+  string dstfile = args(2).string_value ();
+  string dstname = args(3).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  Matrix start, count;
+  if (nargin == 6)
+    {
+      int err = 0;
+      err = err || ! check_vec (args(4), start, "START", false);
+      err = err || ! check_vec (args(5), count, "COUNT", true);
+      if (err)
+        return octave_value_list ();
+      start -= 1;
+    }
+
+  H5StatsScope stats ("h5copy", srcname);
+
+  H5File src (srcfile.c_str (), false);
+  if (error_state)
+    return octave_value_list ();
+  if (srcfile == dstfile)
+    src.copy_object (srcname.c_str (), src, dstname.c_str (), start, count);
+  else
+    {
+      H5File dst (dstfile.c_str (), true);
+      if (error_state)
+        return octave_value_list ();
+      src.copy_object (srcname.c_str (), dst, dstname.c_str (), start, count);
+    }
+
+  return octave_value_list ();
+#endif
+}
+
+DEFUN_DLD (h5repack, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5repack (@var{filename})\n\
+@deftypefnx {Loadable Function} h5repack (@var{srcfile}, @var{dstfile})\n\
+@deftypefnx {Loadable Function} h5repack (@dots{}, @var{key}, @var{val})\n\
+\n\
+Rewrite the HDF5 file @var{srcfile} compactly to the new file\n\
+@var{dstfile}, or the file @var{filename} in place. Space which was\n\
+freed in the file by @code{h5delete} or by overwriting datasets and\n\
+attributes is not copied. For the in-place form, the file is written\n\
+to @var{filename}@code{.repack} and then renamed.\n\
+\n\
+Groups, datasets and named datatypes are copied with their attributes,\n\
+soft and external links as they are. An object with several hard links\n\
+is copied once, and references in attributes point to the copies of\n\
+their objects. Datasets are copied as they are\n\
+stored, so compressed chunks are not decompressed, unless one of the\n\
+following options changes their layout:\n\
+\n\
+@table @asis\n\
+@item @option{ChunkSize}\n\
+A vector with the new chunk size of all datasets of the same rank, or\n\
+the string @samp{auto} to choose it for each dataset as @code{h5create}\n\
+does. Datasets with a zone map keep their chunk size.\n\
+\n\
+@item @option{Deflate}\n\
+The deflate compression level, from 1 to 9, of all datasets, or 0 to\n\
+store them uncompressed. Datasets which are not chunked get an\n\
+automatic chunk size.\n\
+\n\
+@item @option{PersistFreeSpace}\n\
+If true, the new file tracks its free space persistently (see\n\
+@code{h5create}). The setting of @var{srcfile} is kept otherwise.\n\
+@end table\n\
+\n\
+@seealso{h5delete, h5create, h5copy}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5repack", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin < 1 || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  for (int i = 0; i < nargin; i++)
+    {
+      // the values of the options need not be strings
+      if (! args(i).is_string () && (i < 2 || i % 2 == nargin % 2))
+        {
+          print_usage ();
+          return octave_value_list ();
+        }
+    }
+
+  // an even number of arguments names the destination file
+  bool in_place = (nargin % 2 == 1);
+  string srcfile = args(0).string_value ();
+  string dstfile = (in_place ? srcfile + ".repack" : args(1).string_value ());
+  if (error_state)
+    return octave_value_list ();
+
+  H5RepackOptions opts;
+  H5FileOptions fopts;
+  bool persist = false;
+  for (int i = (in_place ? 1 : 2); i+1 < nargin; i+=2)
+    {
+      if (args(i).string_value () == "ChunkSize")
+        {
+          if (args(i+1).is_string ())
+            {
+              if (args(i+1).string_value () != "auto")
+                {
+                  error ("ChunkSize argument must be either a vector, or the string 'auto'.");
+                  return octave_value_list ();
+                }
+              opts.chunksize = Matrix (1, 1, 0);
+            }
+          else if (! check_vec (args(i+1), opts.chunksize, "ChunkSize", false))
+            return octave_value_list ();
+        }
+      else if (args(i).string_value () == "Deflate")
+        {
+          opts.deflate = args(i+1).int_value ();
+          if (error_state || opts.deflate < 0 || opts.deflate > 9)
+            {
+              error ("Deflate argument must be a level from 0 to 9");
+              return octave_value_list ();
+            }
+        }
+      else if (args(i).string_value () == "PersistFreeSpace")
+        {
+          persist = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("PersistFreeSpace argument must be true or false");
+              return octave_value_list ();
+            }
+        }
+      else
+        {
+          error ("unknown parameter name %s", args(i).string_value ().c_str ());
+          return octave_value_list ();
+        }
+    }
+
+  file_stat fs (dstfile);
+  if (fs.exists ())
+    {
+      error ("The file %s exists already", dstfile.c_str ());
+      return octave_value_list ();
+    }
+
+  H5StatsScope stats ("h5repack", srcfile);
+
+  {
+    H5File src (srcfile.c_str (), false);
+    if (error_state)
+      return octave_value_list ();
+    fopts.persist_free_space = persist || src.persists_free_space ();
+    H5File dst (dstfile.c_str (), true, fopts);
+    if (error_state)
+      return octave_value_list ();
+    src.repack (dst, opts);
+  }
+  if (error_state)
+    remove (dstfile.c_str ());
+  else if (in_place && rename (dstfile.c_str (), srcfile.c_str ()) != 0)
+    error ("Renaming %s to %s failed: %s", dstfile.c_str (), srcfile.c_str (),
+           strerror (errno));
+
+  return octave_value_list ();
+#endif
+}
+
+DEFUN_DLD (h5create, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5create (@var{filename}, @var{dsetname}, @var{size}, @var{key}, @var{val},...)\n\
+\n\
+Create a dataset with name @var{dsetname} and size @var{size} \n\
+in the HDF5 file specified by @var{filename}.\n\
+\n\
+The vector @var{size} may contain one or several Inf (or \n\
+equivalently: zero) values.\n\
+This will lead to unlimited maximum extent of the dataset in the\n\
+respective dimensions and 0 initial extent.\n\
+Note that any dataset with at least one unlimited dimension must be chunked and\n\
+it is generally recommended for large datasets.\n\
+\n\
+The list of @var{key}, @var{val} arguments allows to specify\n\
+certain properties of the dataset. Allowed settings are:\n\
+\n\
+@table @asis\n\
+@item @option{Datatype}\n\
+one of the strings @samp{double} @samp{single} @samp{uint64} @samp{uint32} @samp{uint16} @samp{uint8} @samp{int64} @samp{int32} @samp{int16} @samp{int8} \n\
+\n\
+@item @option{ChunkSize}\n\
+The value may be either a vector specifying the chunk size,\n\
+or an empty vector [], which means no chunking (this is the default),\n\
+or the string @samp{auto} which makes the library choose automatically \n\
+an appropriate chunk size, as best as it can. Note that the @samp{auto}\n\
+setting is not @sc{matlab} compatible.\n\
+\n\
+@item @option{ZoneMap}\n\
+If true, the minimum and maximum of each chunk of the (chunked) dataset\n\
+are kept in the companion dataset @var{dsetname}@code{_zonemap}, and\n\
+updated by every @code{h5write} to the dataset. @code{h5query} uses it\n\
+to read only the chunks which may contain the values it searches.\n\
+\n\
+@item @option{PersistFreeSpace}\n\
+If true and the file is created by this call, the file keeps track of\n\
+its free space across closing and reopening it, so that the space of\n\
+deleted or overwritten datasets and attributes is reused. The file can\n\
+then only be opened with HDF5 1.10 or later. Use @code{h5repack} to\n\
+compact a file.\n\
+\n\
+@item @option{Shuffle}\n\
+If true, the bytes of the elements of each chunk are shuffled before\n\
+it is compressed.\n\
+\n\
+@item @option{Deflate}\n\
+The deflate compression level, from 0 (no compression) to 9.\n\
+\n\
+@item @option{Filter}\n\
+The identifier of a filter registered with The HDF Group, or one of\n\
+@samp{zstd}, @samp{lz4}, @samp{blosc}, @samp{bzip2}, which is applied\n\
+to the chunks after shuffle and deflate. Filters which are not built\n\
+into the HDF5 library are loaded as plugins from the directories in the\n\
+environment variable @env{HDF5_PLUGIN_PATH}. Several filters are applied\n\
+in the order in which they are given.\n\
+\n\
+@item @option{FilterParams}\n\
+A vector of non-negative integers, the parameters of the preceding\n\
+filter, such as its compression level.\n\
+@end table\n\
+\n\
+The filters need a chunked dataset.\n\
+\n\
+@seealso{h5write}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5create", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin < 3 || nargin % 2 == 0 || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  for (int i = 3; i < nargin; i+=2)
+    {
+      if (! args(i).is_string ())
+        {
+          print_usage ();
+          return octave_value_list ();
+        }
+    }
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+  
+  Matrix size;
+  if (! check_vec (args(2), size, "SIZE", true))
+    return octave_value_list ();
+
+
+  // loop over the key-value pairs and see what is given
+  string datatype = "double";
+  Matrix chunksize;
+  H5CreateOptions opts;
+  H5FileOptions fopts;
+  for (int i = 3; i+1 < nargin; i+=2)
+    {
+      if (args(i).string_value () == "Datatype")
+        {
+          datatype = args(i+1).string_value ();
+          if (error_state)
+            {
+              error ("Datatype argument must be a string");
+              return octave_value_list ();
+            }
+        }
+      else if (args(i).string_value () == "ChunkSize")
+        {
+	  if (args(i+1).is_string ())
+	    {
+	      if(args(i+1).string_value () != "auto")
+		{
+		  error ("ChunkSize argument must be either a vector, or the string 'auto'.");
+		  return octave_value_list ();
+		}
+	      chunksize = args(2).matrix_value ();
+	      chunksize(0) = 0;
+
+	    }
+          else if (! check_vec (args(i+1), chunksize, "ChunkSize", false))
+            return octave_value_list ();
+        }
+      else if (args(i).string_value () == "ZoneMap")
+        {
+          opts.zonemap = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("ZoneMap argument must be true or false");
+              return octave_value_list ();
+            }
+        }
+      else if (args(i).string_value () == "PersistFreeSpace")
+        {
+          fopts.persist_free_space = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("PersistFreeSpace argument must be true or false");
+              return octave_value_list ();
+            }
+        }
+      else if (args(i).string_value () == "Shuffle")
+        {
+          opts.shuffle = args(i+1).bool_value ();
+          if (error_state)
+            {
+              error ("Shuffle argument must be true or false");
+              return octave_value_list ();
+            }
+        }
+      else if (args(i).string_value () == "Deflate")
+        {
+          opts.deflate = args(i+1).int_value ();
+          if (error_state || opts.deflate < 0 || opts.deflate > 9)
+            {
+              error ("Deflate argument must be a level from 0 to 9");
+              return octave_value_list ();
+            }
+        }
+      else if (args(i).string_value () == "Filter")
+        {
+          H5Filter f;
+          f.id = filter_by_name (args(i+1));
+          if (error_state || f.id < 0)
+            {
+              error ("Filter argument must be a filter identifier or one of"
+                     " 'zstd', 'lz4', 'blosc', 'bzip2'");
+              return octave_value_list ();
+            }
+          opts.filters.push_back (f);
+        }
+      else if (args(i).string_value () == "FilterParams")
+        {
+          Matrix params;
+          if (opts.filters.empty ())
+            {
+              error ("FilterParams must follow a Filter");
+              return octave_value_list ();
+            }
+          if (! args(i+1).is_empty ()
+              && ! check_vec (args(i+1), params, "FilterParams", true))
+            return octave_value_list ();
+          for (octave_idx_type k = 0; k < params.nelem (); k++)
+            opts.filters.back ().params.push_back (params(k));
+        }
+      else
+        {
+          error ("unknown parameter name %s", args(i).string_value ().c_str ());
+          return octave_value_list ();
+        }
+    }
+
+  
+  
+  H5StatsScope stats ("h5create", location);
+
+  //open the hdf5 file
+  H5File file (filename.c_str (), true, fopts);
+  if (error_state)
+    return octave_value_list ();
+  if (fopts.persist_free_space && ! file.persists_free_space ())
+    warning ("h5create: the file %s exists already, PersistFreeSpace is ignored",
+             filename.c_str ());
+  file.create_dset (location.c_str (), size, datatype.c_str (), chunksize,
+                    opts);
+  
+  return octave_value_list ();
+#endif
+}
+
+
+DEFUN_DLD (h5delete, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} h5delete (@var{filename}, @var{objname})\n\
+@deftypefnx {Loadable Function} h5delete (@var{filename}, @var{objname}, @var{attname})\n\
+\n\
+In the first form, delete a dataset or group with name @var{objname}\n\
+in the HDF5 file specified by @var{filename}.\n\
+\n\
+In the second form, delete an attribute with name @var{attname} associated\n\
+to a dataset or group with name @var{objname}\n\
+in the HDF5 file specified by @var{filename}.\n\
+\n\
+Note that this function is not @sc{matlab} compliant.\n\
+\n\
+@seealso{h5create}\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5delete", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (! (nargin ==  2 || nargin == 3) || nargout != 0)
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (! (args(0).is_string () && args(1).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  if (nargin == 3 && ! args(2).is_string ())
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+  
+  string filename = args(0).string_value ();
+  string location = args(1).string_value ();
+  if (error_state)
+    return octave_value_list ();
+
+  H5StatsScope stats ("h5delete", location);
+
+  //open the hdf5 file
+  H5File file (filename.c_str (), true);
+  if (error_state)
+    return octave_value_list ();
+  if (nargin == 2)
+    file.delete_link (location.c_str ());
+  else if (nargin == 3)
+    {
+      string attname = args(2).string_value ();
+      if(!error_state)
+	file.delete_att (location.c_str (), attname.c_str ());
+    }
+  
+  return octave_value_list ();
+#endif
+}
+
+DEFUN_DLD (h5stats, args, nargout,
+           "-*- texinfo -*-\n\
+@deftypefn {Loadable Function} {@var{stats} =} h5stats ()\n\
+@deftypefnx {Loadable Function} h5stats (@var{cmd})\n\
+\n\
+Control the instrumentation of the functions of this package and\n\
+query the statistics collected by it. Instrumentation is off by\n\
+default. @var{cmd} may be one of\n\
+\n\
+@table @samp\n\
+@item on\n\
+start collecting statistics\n\
+@item off\n\
+stop collecting statistics (the collected ones are kept)\n\
+@item reset\n\
+discard the collected statistics\n\
+@end table\n\
+\n\
+Called without arguments, return a struct array with one element per\n\
+function and object (dataset, group or attribute location) that has\n\
+been accessed, with the fields\n\
+\n\
+@table @code\n\
+@item function, object\n\
+the name of the function and the object\n\
+@item calls\n\
+the number of calls\n\
+@item bytes_read, bytes_written\n\
+the number of bytes transferred to and from memory\n\
+@item time_total\n\
+the wall time in seconds spent in the calls\n\
+@item time_open, time_select, time_io\n\
+the part of it spent opening the file and dataset, building dataspace\n\
+selections, and reading or writing data (including type conversion)\n\
+@item conversions\n\
+the number of transfers which required a type conversion\n\
+@item mdc_hit_rate\n\
+the mean hit rate of the metadata cache of the file\n\
+@end table\n\
+\n\
+Note that this function is not @sc{matlab} compliant.\n\
+\n\
+@end deftypefn")
+{
+#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
+  gripe_disabled_feature("h5stats", "HDF5 IO");
+  return octave_value_list ();
+#else
+  int nargin = args.length ();
+
+  if (nargin > 1 || (nargin == 1 && ! args(0).is_string ()))
+    {
+      print_usage ();
+      return octave_value_list ();
+    }
+
+  if (nargin == 1)
+    {
+      string cmd = args(0).string_value ();
+      if (cmd == "on")
+        h5stats_enabled = true;
+      else if (cmd == "off")
+        h5stats_enabled = false;
+      else if (cmd == "reset")
+        h5stats_table.clear ();
+      else
+        error ("h5stats: unknown command %s", cmd.c_str ());
+      return octave_value_list ();
+    }
+
+  octave_idx_type n = h5stats_table.size ();
+  dim_vector dv (n, 1);
+  Cell fcn (dv), obj (dv), calls (dv), bytes_read (dv), bytes_written (dv);
+  Cell time_total (dv), time_open (dv), time_select (dv), time_io (dv);
+  Cell conversions (dv), mdc_hit_rate (dv);
+  octave_idx_type i = 0;
+  for (std::map<std::pair<string, string>, H5Stats>::const_iterator
+         it = h5stats_table.begin (); it != h5stats_table.end (); it++, i++)
+    {
+      const H5Stats& st = it->second;
+      fcn(i) = it->first.first;
+      obj(i) = it->first.second;
+      calls(i) = st.calls;
+      bytes_read(i) = st.bytes_read;
+      bytes_written(i) = st.bytes_written;
+      time_total(i) = st.time_total;
+      time_open(i) = st.time_phase[H5_PHASE_OPEN];
+      time_select(i) = st.time_phase[H5_PHASE_SELECT];
+      time_io(i) = st.time_phase[H5_PHASE_IO];
+      conversions(i) = st.conversions;
+      mdc_hit_rate(i) = st.calls > 0 ? st.mdc_hit_rate / st.calls : 0;
+    }
+
+  octave_map stats (dv);
+  stats.assign ("function", fcn);
+  stats.assign ("object", obj);
+  stats.assign ("calls", calls);
+  stats.assign ("bytes_read", bytes_read);
+  stats.assign ("bytes_written", bytes_written);
+  stats.assign ("time_total", time_total);
+  stats.assign ("time_open", time_open);
+  stats.assign ("time_select", time_select);
+  stats.assign ("time_io", time_io);
+  stats.assign ("conversions", conversions);
+  stats.assign ("mdc_hit_rate", mdc_hit_rate);
+  return octave_value (stats);
+#endif
+}
+
+#if defined (HAVE_HDF5) && defined (HAVE_HDF5_18)
+
+H5File::H5File (const char *filename, const bool create_if_nonexisting,
+                const H5FileOptions& fopts)
+{
+  H5E_auto_t oef;
+  void *olderr;
+  H5Eget_auto (H5E_DEFAULT,&oef,&olderr);
+  //suppress hdf5 error output
+  H5Eset_auto (H5E_DEFAULT,0,0);
+
+  H5PhaseTimer timer (H5_PHASE_OPEN);
+
+  // the file may be written, so a hyperslab read ahead may become stale
+  readahead_cancel ();
+
+  // datasets may use filters from plugins
+  update_plugin_path ();
+
+  // In a build against parallel HDF5 that runs under MPI with several
+  // processes, the file is opened by all of them with the MPI-IO
+  // driver, so that they can read and write it at the same time. They
+  // all have to make the same calls then.
+  hid_t fapl = H5Pcreate (H5P_FILE_ACCESS);
+#ifdef H5_HAVE_PARALLEL
+  int initialized = 0, finalized = 0, nprocs = 1;
+  MPI_Initialized (&initialized);
+  MPI_Finalized (&finalized);
+  if (initialized && ! finalized)
+    MPI_Comm_size (MPI_COMM_WORLD, &nprocs);
+  if (nprocs > 1
+      && H5Pset_fapl_mpio (fapl, MPI_COMM_WORLD, MPI_INFO_NULL) >= 0)
+    {
+      is_mpio = true;
+      // no process may create the file before all have checked whether
+      // it exists
+      MPI_Barrier (MPI_COMM_WORLD);
+    }
+#endif
+
+  file_stat fs (filename);
+  if (! fs.exists () && create_if_nonexisting)
+    {
+      hid_t fcpl = H5Pcreate (H5P_FILE_CREATE);
+      set_attr_storage (fcpl);
+      if (fopts.persist_free_space)
+        {
+#if H5_VERSION_GE (1, 10, 1)
+          // free space sections of any size are tracked, and aggregated
+          // for small objects as by default
+          H5Pset_file_space_strategy (fcpl, H5F_FSPACE_STRATEGY_FSM_AGGR,
+                                      1, 1);
+#else
+          error ("Tracking free space persistently needs HDF5 1.10.1 or later");
+#endif
+        }
+      if (! error_state)
+        file = H5Fcreate (filename, H5F_ACC_TRUNC, fcpl, fapl);
+      H5Pclose (fcpl);
+    }
+  else if (! fs.exists () && ! create_if_nonexisting)
+    error ("The file %s does not exist: %s", filename, strerror (errno));
+  else
+    {
+      // test if the existing file is in HDF5 format
+      if (! H5Fis_hdf5 (filename))
+        error ("The file is not in the HDF5 format, %s: %s", filename, strerror (errno));
+      else
+        {
+          file = H5Fopen (filename, H5F_ACC_RDWR, fapl);
+          if (file < 0)
+            error ("Opening the file failed, %s: %s", filename, strerror (errno));
+        }
+    }
+  H5Pclose (fapl);
+  // restore old setting
+  H5Eset_auto (H5E_DEFAULT,oef,olderr);
+}
+
+H5File::~H5File ()
+{
+  if (h5stats_current != NULL && H5Iis_valid (file))
+    {
+      double hit_rate;
+      if (H5Fget_mdc_hit_rate (file, &hit_rate) >= 0)
+        h5stats_current->mdc_hit_rate += hit_rate;
+    }
+
+  close_handles ();
+
+  if (xfer_plist != H5P_DEFAULT && H5Iis_valid (xfer_plist))
+    H5Pclose (xfer_plist);
+
+  if (H5Iis_valid (file))
+    H5Fclose (file);
+}
+
+// Close the handles of the last dataset, attribute and types which
+// were used, so that the next object can be opened with the same file.
+void
+H5File::close_handles ()
+{
+  if (H5Iis_valid (memspace_id))
+    H5Sclose (memspace_id);
+
+  if (H5Iis_valid (dspace_id))
+    H5Sclose (dspace_id);
+
+  if (H5Iis_valid (dset_id))
+    H5Dclose (dset_id);
+  
+  if (H5Iis_valid (att_id))
+    H5Aclose (att_id);
+
+  if (H5Iis_valid (obj_id))
+    H5Oclose (obj_id);
+
+  if (H5Iis_valid (type_id))
+    H5Tclose (type_id);
+  
+  if (H5Iis_valid (mem_type_id))
+    H5Tclose (mem_type_id);
+
+  memspace_id = dspace_id = dset_id = att_id = obj_id = -1;
+  type_id = mem_type_id = -1;
+
+  if (h5_dims != NULL)
+    {
+      free (h5_dims);
+      h5_dims = NULL;
+    }
+  if (h5_maxdims != NULL)
+    {
+      free (h5_maxdims);
+      h5_maxdims = NULL;
+    }
+}
+
+// T will be Matrix or dim_vector
+template <typename T>
+hsize_t*
+H5File::alloc_hsize (const T& dim, const int mode, const bool reverse)
+{
+  int rank = dim.length ();
+  hsize_t *hsize = (hsize_t*)malloc (rank * sizeof (hsize_t));
+  for (int i = 0; i < rank; i++)
+    {
+      int j = reverse ? rank-i-1 : i;
+      if (mode == ALLOC_HSIZE_INFZERO_TO_UNLIMITED && (dim(i) == octave_Inf || dim(i) == 0))
+        hsize[j] = H5S_UNLIMITED;
+      else if (mode == ALLOC_HSIZE_INF_TO_ZERO && dim(i) == octave_Inf)
+        hsize[j] = 0;
+      else
+        hsize[j] = dim(i);
+    }
+  return hsize;
+}
+
+
+int
+H5File::open_dset (const char *dsetname)
+{
+  H5PhaseTimer timer (H5_PHASE_OPEN);
+  dset_id = H5Dopen (file, dsetname, H5P_DEFAULT);
+  if (dset_id < 0)
+    {
+      error ("Error opening dataset %s", dsetname);
+      return -1;
+    }
+
+  dspace_id = H5Dget_space (dset_id);
+  if (dspace_id < 0)
+    {
+      error ("Error opening dataspace of dataset %s", dsetname);
+      return -1;
+    }
+
+  rank = H5Sget_simple_extent_ndims (dspace_id);
+  if (rank < 0)
+    {
+      error ("Error reading extent of %s", dsetname);
+      return -1;
+    }
+
+  h5_dims = (hsize_t*)malloc (rank * sizeof(hsize_t));
+  h5_maxdims = (hsize_t*)malloc (rank * sizeof(hsize_t));
+  if (! h5_dims || ! h5_maxdims)
+    {
+      error ("Error allocating memory for %s", dsetname);
+      return -1;
+    }
+  if (H5Sget_simple_extent_dims (dspace_id, h5_dims, h5_maxdims) < 0)
+    {
+      error ("Error determining current dimensions and maximum size of dataset %s", dsetname);
+      return -1;
+    }
+  
+  return 0;
+}
+
+octave_value
+H5File::read_dset_complete (const char *dsetname)
+{
+  if (is_sparse_group (dsetname))
+    return read_sparse_group (dsetname);
+
+  if (open_dset (dsetname) < 0)
+    return octave_value_list ();
+
+  mat_dims.resize (max (rank, 2));
+  // .resize(1) still leaves mat_dims with a length of 2 for some reason, so
+  // we need at least 2 filled
+  mat_dims(0) = mat_dims(1) = 1;
+  for (int i = 0; i < rank; i++)
+    //note that this is reversing the order, unless C order is requested
+    mat_dims(i) = h5_dims[read_opts.c_order ? i : rank-i-1];
+
+  if (H5Sselect_all (dspace_id) < 0)
+    {
+      error ("Error selecting complete dataset %s", dsetname);
+      return octave_value_list ();
+    }
+  sel_start.assign (rank, 0);
+  sel_stride.assign (rank, 1);
+  sel_count.assign (h5_dims, h5_dims + rank);
+  sel_block.assign (rank, 1);
+
+  octave_value retval = read_dset ();
+  return retval;
+}
+
+octave_value
+H5File::read_dset_hyperslab (const char *dsetname,
+                             const Matrix& start, const Matrix& count,
+                             const Matrix& stride, const Matrix& block,
+                             int nargin)
+{
+  if (is_sparse_group (dsetname))
+    {
+      error ("Cannot read a hyperslab of the sparse matrix %s", dsetname);
+      return octave_value_list ();
+    }
+
+  if (open_dset (dsetname) < 0)
+    return octave_value_list ();
+
+  if (rank == 0 && ! (start.is_empty () && count.is_empty ()
+                      && stride.is_empty () && block.is_empty ()))
+    {
+      error ("Cannot specify hyperslab for scalar datasets (rank 0)");
+      return octave_value_list ();
+    }
+
+  if (start.nelem () != rank)
+    {
+      error ("start must be a vector of length %d, the dataset rank", rank);
+      return octave_value_list ();
+    }
+  if (count.nelem () != rank)
+    {
+      error ("count must be a vector of length %d, the dataset rank", rank);
+      return octave_value_list ();
+    }
+  
+  Matrix _stride = stride;
+  if (nargin < 3)
+    _stride = Matrix (dim_vector(1, rank), 1);
+  if (_stride.nelem () != rank)
+    {
+      error ("stride must be a vector of length %d, the dataset rank", rank);
+      return octave_value_list ();
+    }
+  Matrix _block = block;
+  if (nargin < 4)
+    _block = Matrix (dim_vector(1, rank), 1);
+  if (_block.nelem () != rank)
+    {
+      error ("block must be a vector of length %d, the dataset rank", rank);
+      return octave_value_list ();
+    }
+  
+  // .resize(1) still leaves mat_dims with a length of 2 for some reason, so
+  // we need at least 2 filled
+  mat_dims.resize (max (rank, 2));
+  mat_dims(0) = mat_dims(1) = 1;
+
+  // the arguments are given in the order of the file for C order,
+  // reversed otherwise
+  bool reverse = ! read_opts.c_order;
+  Matrix _count = count;
+  for (int i = 0; i < rank; i++)
+    {
+      hsize_t dim = h5_dims[reverse ? rank-i-1 : i];
+      if (_stride(i) < _block(i))
+        {
+          error ("In dimension %d, requested stride %d smaller than block size %d",
+                 i+1, (int)_stride(i), (int)_block(i));
+          return octave_value_list ();
+        }
+      if (_count(i) == 0)
+        {
+          // a value of 0 (or Inf) means that as many blocks as possible
+          // shall be read in this dimension
+          _count(i) = (dim - start(i) - _block(i)) / _stride(i) + 1;
+        }
+      mat_dims(i) = _count(i)*_block(i);
+      int end = start(i) + _stride(i)*(_count(i)-1) + _block(i); // exclusive
+      if (dim < end)
+        {
+          error ("In dimension %d, dataset only has %d elements, but at least %d"
+                 " are required for requested hyperslab", i+1, (int)dim,
+                 end);
+          return octave_value_list ();
+        }
+    }
+
+  hsize_t *hstart = alloc_hsize (start, ALLOC_HSIZE_DEFAULT, reverse);
+  hsize_t *hstride = alloc_hsize (_stride, ALLOC_HSIZE_DEFAULT, reverse);
+  hsize_t *hcount = alloc_hsize (_count, ALLOC_HSIZE_DEFAULT, reverse);
+  hsize_t *hblock = alloc_hsize (_block, ALLOC_HSIZE_DEFAULT, reverse);
+  // TODO check these (and hmem) for NULLs
+
+  herr_t sel_result;
+  {
+    H5PhaseTimer timer (H5_PHASE_SELECT);
+    sel_result = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, hstart,
+                                      hstride, hcount, hblock);
+  }
+  sel_start.assign (hstart, hstart + rank);
+  sel_stride.assign (hstride, hstride + rank);
+  sel_count.assign (hcount, hcount + rank);
+  sel_block.assign (hblock, hblock + rank);
+
+  free (hstart);
+  free (hstride);
+  free (hcount);
+  free (hblock);
+
+  if (sel_result < 0)
+    return octave_value_list ();
+
+  octave_value retval = read_dset ();
+  return retval;
+}
+
+// Open the dataset DSETNAME for h5dataset and keep it open for
+// read_dset_index. DIMS is set to the dimensions of the array which
+// h5read returns for it, CLS to the class of that array.
+int
+H5File::open_dset_proxy (const char *dsetname, dim_vector& dims,
+                         std::string& cls)
+{
+  if (open_dset (dsetname) < 0)
+    return -1;
+
+  dims.resize (max (rank, 2));
+  dims(0) = dims(1) = 1;
+  for (int i = 0; i < rank; i++)
+    dims(i) = h5_dims[rank-i-1];
+
+  hid_t dtype = H5Dget_type (dset_id);
+  hid_t complex_type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
+  switch (H5Tget_class (dtype))
+    {
+    case H5T_INTEGER:
+      cls = (H5Tget_sign (dtype) == H5T_SGN_NONE ? "uint" : "int")
+            + std::to_string (8 * H5Tget_size (dtype));
+      break;
+    case H5T_FLOAT:
+      cls = "double";
+      break;
+    case H5T_STRING:
+      cls = (rank <= 1 || (rank > 2 && H5Tget_size (dtype) == 1)
+             ? "char" : "cell");
+      break;
+    case H5T_ENUM:
+      cls = is_bool_type (dtype) ? "logical" : "unknown";
+      break;
+    case H5T_COMPOUND:
+      cls = hdf5_types_compatible (dtype, complex_type_id) > 0
+            ? "double" : "struct";
+      break;
+    default:
+      cls = "unknown";
+    }
+  H5Tclose (complex_type_id);
+  H5Tclose (dtype);
+  return 0;
+}
+
+// Set DIMS to the current dimensions of the dataset opened by
+// open_dset_proxy, as h5read returns them, which change if it is
+// extended.
+int
+H5File::proxy_dims (dim_vector& dims)
+{
+  hid_t space = H5Dget_space (dset_id);
+  if (space < 0)
+    return -1;
+  std::vector<hsize_t> hdims (max (rank, 1));
+  herr_t status = H5Sget_simple_extent_dims (space, &hdims[0], NULL);
+  H5Sclose (space);
+  if (status < 0)
+    return -1;
+  dims.resize (max (rank, 2));
+  dims(0) = dims(1) = 1;
+  for (int i = 0; i < rank; i++)
+    dims(i) = hdims[rank-i-1];
+  return 0;
+}
+
+// Read the elements of the dataset opened by open_dset_proxy which the
+// Octave indices IDX select, as if the array returned by h5read for
+// the whole dataset was indexed with them. An index which is a colon,
+// a scalar or a range with a positive increment becomes part of a
+// hyperslab selection, so that only the indexed elements are read. For
+// any other index, the range between its smallest and largest element
+// is read and then indexed in memory. An index list whose length
+// differs from the number of dimensions (as for linear indexing) is
+// applied in memory to the whole dataset.
+octave_value
+H5File::read_dset_index (const octave_value_list& idx)
+{
+  // the handles of the last read; the dataspace is opened again, as
+  // the dataset may have been extended since
+  if (H5Iis_valid (memspace_id))
+    H5Sclose (memspace_id);
+  if (H5Iis_valid (type_id))
+    H5Tclose (type_id);
+  if (H5Iis_valid (mem_type_id))
+    H5Tclose (mem_type_id);
+  if (H5Iis_valid (dspace_id))
+    H5Sclose (dspace_id);
+  memspace_id = type_id = mem_type_id = -1;
+
+  dspace_id = H5Dget_space (dset_id);
+  if (dspace_id < 0
+      || H5Sget_simple_extent_dims (dspace_id, h5_dims, h5_maxdims) < 0)
+    {
+      error ("Error reading extent of dataset");
+      return octave_value ();
+    }
+
+  int ndims = max (rank, 2);
+  int nidx = idx.length ();
+  mat_dims.resize (ndims);
+  mat_dims(0) = mat_dims(1) = 1;
+  for (int i = 0; i < rank; i++)
+    mat_dims(i) = h5_dims[rank-i-1];
+
+  // a vector stored as a one-dimensional dataset is a column vector, so
+  // that a single index is its row index
+  bool by_dims = (nidx == ndims || (nidx == 1 && rank <= 1));
+  if (! by_dims)
+    {
+      if (H5Sselect_all (dspace_id) < 0)
+        {
+          error ("Error selecting complete dataset");
+          return octave_value ();
+        }
+      sel_start.assign (rank, 0);
+      sel_stride.assign (rank, 1);
+      sel_count.assign (h5_dims, h5_dims + rank);
+      sel_block.assign (rank, 1);
+      octave_value retval = read_dset ();
+      if (error_state || nidx == 0)
+        return retval;
+      return retval.do_index_op (idx);
+    }
+
+  // per dimension of the array, in Octave's order
+  std::vector<hsize_t> start (ndims), stride (ndims), count (ndims);
+  octave_value_list memidx (ndims, octave_value ());
+  bool in_memory = false;
+  for (int i = 0; i < ndims; i++)
+    {
+      octave_idx_type n = mat_dims(i);
+      idx_vector iv = i < nidx ? idx(i).index_vector () : idx_vector::colon;
+      if (error_state)
+        return octave_value ();
+      octave_idx_type len = iv.length (n);
+      if (iv.extent (n) > n)
+        {
+          error ("index (%d): out of bound %d in dimension %d",
+                 (int)iv.extent (n), (int)n, i+1);
+          return octave_value ();
+        }
+
+      memidx(i) = octave_value (":");
+      if (iv.is_colon ())
+        {
+          start[i] = 0;
+          stride[i] = 1;
+          count[i] = n;
+        }
+      else if (len > 0 && (iv.is_scalar ()
+                           || (iv.idx_class () == idx_vector::class_range
+                               && iv.increment () > 0)))
+        {
+          start[i] = iv(0);
+          stride[i] = iv.is_scalar () ? 1 : iv.increment ();
+          count[i] = len;
+        }
+      else
+        {
+          // the bounding range, indexed in memory with the indices
+          // shifted to its start
+          octave_idx_type lo = 0, hi = 0;
+          if (len > 0)
+            lo = hi = iv(0);
+          for (octave_idx_type j = 1; j < len; j++)
+            {
+              lo = min (lo, iv(j));
+              hi = max (hi, iv(j));
+            }
+          NDArray shifted (dim_vector (len, 1));
+          for (octave_idx_type j = 0; j < len; j++)
+            shifted(j) = iv(j) - lo + 1;
+          memidx(i) = shifted;
+          in_memory = true;
+          start[i] = lo;
+          stride[i] = 1;
+          count[i] = hi - lo + 1;
+        }
+      mat_dims(i) = count[i];
+    }
+
+  // the selection in the order of the file; the dimensions beyond the
+  // rank of the dataset all have a length of 1
+  sel_start.resize (rank);
+  sel_stride.resize (rank);
+  sel_count.resize (rank);
+  sel_block.assign (rank, 1);
+  for (int i = 0; i < rank; i++)
+    {
+      sel_start[rank-i-1] = start[i];
+      sel_stride[rank-i-1] = stride[i];
+      sel_count[rank-i-1] = count[i];
+    }
+
+  herr_t sel_result;
+  {
+    H5PhaseTimer timer (H5_PHASE_SELECT);
+    if (rank == 0)
+      sel_result = H5Sselect_all (dspace_id);
+    else
+      sel_result = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET,
+                                        &sel_start[0], &sel_stride[0],
+                                        &sel_count[0], &sel_block[0]);
+  }
+  if (sel_result < 0)
+    {
+      error ("Error selecting the indexed elements of the dataset");
+      return octave_value ();
+    }
+
+  octave_value retval = read_dset ();
+  if (error_state || ! in_memory)
+    return retval;
+  return retval.do_index_op (memidx);
+}
+
+octave_value
+H5File::read_dset ()
+{
+  bool is_cmplx = false;
+  type_id = H5Dget_type (dset_id);
+  hid_t complex_type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
+
+  // The selected elements are stored contiguously in memory, in the
+  // order in which they are selected in the file. As the dimensions of
+  // the returned matrix are reversed, this is exactly Octave's column
+  // major order.
+  hsize_t npoints = H5Sget_select_npoints (dspace_id);
+  memspace_id = H5Screate_simple (1, &npoints, NULL);
+  if (memspace_id < 0)
+    {
+      error ("error when creating dataspace for data in memory");
+      return octave_value_list ();
+    }
+
+  octave_value retval;
+  bool is_numeric = (H5Tget_class (type_id) == H5T_INTEGER
+                     || H5Tget_class (type_id) == H5T_FLOAT);
+  bool is_bool = is_bool_type (type_id);
+  if (read_opts.c_order && rank > 1 && ! is_numeric && ! is_bool
+      && ! (H5Tget_class (type_id) == H5T_COMPOUND
+            && hdf5_types_compatible (type_id, complex_type_id) > 0))
+    error ("Order \"C\" is only supported for numeric datasets");
+  else if (H5Tget_class (type_id) == H5T_STRING)
+    retval = read_dset_strings ();
+  else if (H5Tget_class (type_id) == H5T_COMPOUND &&
+      H5Tget_class (complex_type_id) == H5T_COMPOUND &&
+      hdf5_types_compatible (type_id, complex_type_id) > 0)
+    {
+      ComplexNDArray ret (mat_dims);
+      // macro begin
+#define HDF5_READ_DATA(type)                                            \
+      if (H5Sselect_valid (dspace_id) <= 0)                             \
+        {                                                               \
+          error ("selected dataspace is not valid");                    \
+          return octave_value_list ();                                  \
+        }                                                               \
+                                                                        \
+      int mdc_nelem = -1;                                               \
+      size_t rdcc_nelem = -1;                                           \
+      size_t rdcc_nbytes = -1;                                          \
+      double rdcc_w0 = -1;                                              \
+      if (H5Pget_cache (H5Fget_access_plist (file), &mdc_nelem,         \
+                        &rdcc_nelem, &rdcc_nbytes, &rdcc_w0 ) < 0)      \
+        {                                                               \
+          error ("could not determine raw data chunk cache parameters."); \
+          return octave_value_list ();                                  \
+        }                                                               \
+      /*cout << "cache params:" << rdcc_nelem << "," << rdcc_nbytes << endl;*/ \
+      herr_t read_result;                                               \
+      if (read_opts.c_order && rank > 1)                                \
+        read_result = dset_io_c_order (type, ret.fortran_vec (),        \
+                                       false, false);                   \
+      else                                                              \
+        read_result = dset_read (type, memspace_id, dspace_id,          \
+                                 ret.fortran_vec ());                   \
+      if (read_result < 0)                                              \
+        {                                                               \
+          error ("error when reading dataset");                         \
+          return octave_value_list ();                                  \
+        }                                                               \
+      retval = octave_value (ret)
+      // macro end
+      
+      HDF5_READ_DATA (type_id);
+    }
+  else if (H5Tget_class (type_id) == H5T_COMPOUND)
+    retval = read_dset_compound ();
+  else if (is_numeric)
+    retval = read_dset_numeric ();
+  else if (is_bool)
+    {
+      // the library converts the members by name into the enum in
+      // which Octave's logical arrays are laid out
+      boolNDArray ret (mat_dims);
+      mem_type_id = make_bool_type ();
+      HDF5_READ_DATA (mem_type_id);
+    }
+  else
+    error ("the type of the dataset is not supported");
+  H5Tclose (complex_type_id);
+  
+  return retval;
+}
+
+octave_value
+H5File::read_dset_numeric ()
+{
+  // Integers are returned in the Octave type of the same size and
+  // signedness, floating point data and scaled data as double, unless
+  // another OutputType is requested. The library then converts the data
+  // while reading it into the final array.
+  bool is_integer = (H5Tget_class (type_id) == H5T_INTEGER);
+  hid_t array_type = (is_integer && ! read_opts.scale ? type_id
+                      : H5T_NATIVE_DOUBLE);
+  if (! read_opts.output_type.empty ())
+    array_type = native_type_by_name (read_opts.output_type);
+  void *data;
+  octave_value retval;
+  if (read_opts.reuse_buffer)
+    retval = reuse_numeric_array (array_type, mat_dims, &data, &mem_type_id);
+  if (retval.is_undefined ())
+    retval = alloc_numeric_array (array_type, mat_dims, &data, &mem_type_id);
+  if (retval.is_undefined ())
+    {
+      error ("unknown integer size %d", (int)H5Tget_size (type_id));
+      return retval;
+    }
+
+  // The scale factor and offset are applied by the library as a data
+  // transform, in the same pass as the type conversion.
+  if (read_opts.scale)
+    {
+      char expr[128];
+      snprintf (expr, sizeof (expr), "(x)*(%.17g)+(%.17g)",
+                read_opts.scale_factor, read_opts.add_offset);
+      if (xfer_plist == H5P_DEFAULT)
+        xfer_plist = H5Pcreate (H5P_DATASET_XFER);
+      if (H5Pset_data_transform (xfer_plist, expr) < 0)
+        {
+          error ("could not set the scale factor and offset");
+          return octave_value ();
+        }
+    }
+
+  if (H5Sselect_valid (dspace_id) <= 0)
+    {
+      error ("selected dataspace is not valid");
+      return octave_value ();
+    }
+
+  // If the file type is the native type, the library just copies the
+  // data. If it differs only in byte order, the raw data is read
+  // without conversion and swapped in place afterwards, which is much
+  // faster than the library's generic conversion. Anything else is
+  // converted by the library.
+  hid_t read_type = mem_type_id;
+  bool swap = false;
+  if (! read_opts.scale && H5Tequal (type_id, mem_type_id) <= 0
+      && differs_in_byte_order_only (type_id, mem_type_id))
+    {
+      read_type = type_id;
+      swap = true;
+    }
+
+  if (read_opts.c_order && rank > 1)
+    {
+      if (dset_io_c_order (read_type, data, false, swap) < 0)
+        {
+          error ("error when reading dataset");
+          return octave_value ();
+        }
+    }
+  else
+    {
+      if (dset_read (read_type, memspace_id, dspace_id, data) < 0)
+        {
+          error ("error when reading dataset");
+          return octave_value ();
+        }
+      if (swap)
+        swap_bytes (data, H5Sget_select_npoints (memspace_id),
+                    H5Tget_size (mem_type_id));
+    }
+
+  retval.maybe_mutate ();
+  if (read_opts.reuse_buffer)
+    keep_numeric_array (retval);
+  return retval;
+}
+
+octave_value
+H5File::read_dset_strings ()
+{
+  // All strings are read with a single H5Dread. Fixed length strings
+  // of a scalar or one dimensional dataset are returned as a char
+  // matrix with one string per row, any other string dataset as a
+  // cell array of strings.
+  octave_value retval;
+  hsize_t npoints = H5Sget_select_npoints (dspace_id);
+  size_t size = H5Tget_size (type_id);
+  htri_t is_vlen = H5Tis_variable_str (type_id);
+  if (is_vlen < 0)
+    {
+      error ("could not determine the kind of string type of the dataset");
+      return retval;
+    }
+
+  mem_type_id = H5Tcopy (H5T_C_S1);
+  H5Tset_size (mem_type_id, is_vlen ? H5T_VARIABLE : size);
+  H5Tset_cset (mem_type_id, H5Tget_cset (type_id));
+
+  if (is_vlen)
+    {
+      std::vector<char*> buf (npoints, (char*)NULL);
+      if (dset_read (mem_type_id, memspace_id, dspace_id, &buf[0]) < 0)
+        {
+          error ("error when reading dataset");
+          return retval;
+        }
+
+      Cell strings (mat_dims);
+      for (hsize_t i = 0; i < npoints; i++)
+        strings(i) = octave_value (buf[i] ? buf[i] : "");
+      
+      // the library allocated the strings, release all of them at once
+      H5Dvlen_reclaim (mem_type_id, memspace_id, H5P_DEFAULT, &buf[0]);
+
+      if (rank == 0)
+        retval = strings(0);
+      else
+        retval = octave_value (strings);
+    }
+  else
+    {
+      std::vector<char> buf (npoints * size);
+      if (dset_read (mem_type_id, memspace_id, dspace_id, &buf[0]) < 0)
+        {
+          error ("error when reading dataset");
+          return retval;
+        }
+
+      // strings end at the first null or at the full type size
+      std::vector<size_t> len (npoints);
+      size_t maxlen = 0;
+      for (hsize_t i = 0; i < npoints; i++)
+        {
+          const char *p = &buf[i*size];
+          len[i] = std::find (p, p + size, '\0') - p;
+          maxlen = max (maxlen, len[i]);
+        }
+
+      if (size == 1 && rank > 2)
+        {
+          // single characters, as multidimensional char arrays are
+          // written
+          charNDArray chars (mat_dims);
+          std::copy (buf.begin (), buf.end (), chars.fortran_vec ());
+          retval = octave_value (chars, '\'');
+        }
+      else if (rank <= 1)
+        {
+          charMatrix strings (npoints, maxlen, ' ');
+          char *dst = strings.fortran_vec ();
+          for (hsize_t i = 0; i < npoints; i++)
+            for (size_t j = 0; j < len[i]; j++)
+              dst[i + j*npoints] = buf[i*size + j];
+          retval = octave_value (strings, '\'');
+        }
+      else
+        {
+          Cell strings (mat_dims);
+          for (hsize_t i = 0; i < npoints; i++)
+            strings(i) = octave_value (string (&buf[i*size], len[i]));
+          retval = octave_value (strings);
+        }
+    }
+
+  return retval;
+}
+
+// Return true if member M of the compound type TYPE can be read into
+// an array: integers and floating point numbers, and logical values
+// stored as the enum of make_bool_type.
+static bool
+is_readable_member (hid_t type, int m)
+{
+  H5T_class_t cls = H5Tget_member_class (type, m);
+  if (cls == H5T_INTEGER || cls == H5T_FLOAT)
+    return true;
+  if (cls != H5T_ENUM)
+    return false;
+  hid_t member_type = H5Tget_member_type (type, m);
+  bool is_bool = is_bool_type (member_type);
+  H5Tclose (member_type);
+  return is_bool;
+}
+
+octave_value
+H5File::read_dset_compound ()
+{
+  // The requested members are read with a single H5Dread, using a
+  // packed memory compound type made of the native types of just these
+  // members. The records are then split into one array per member.
+  octave_value retval;
+  std::vector<int> members;
+  int nmembers = H5Tget_nmembers (type_id);
+  if (read_opts.fields.is_empty ())
+    {
+      for (int m = 0; m < nmembers; m++)
+        {
+          if (is_readable_member (type_id, m))
+            members.push_back (m);
+          else
+            {
+              char *name = H5Tget_member_name (type_id, m);
+              warning ("h5read: skipping member %s of unsupported type", name);
+              H5free_memory (name);
+            }
+        }
+    }
+  else
+    {
+      for (octave_idx_type i = 0; i < read_opts.fields.numel (); i++)
+        {
+          const char *name = read_opts.fields[i].c_str ();
+          int m = H5Tget_member_index (type_id, name);
+          if (m < 0)
+            {
+              error ("the dataset has no member %s", name);
+              return retval;
+            }
+          if (! is_readable_member (type_id, m))
+            {
+              error ("member %s is not of integer, floating point or logical type",
+                     name);
+              return retval;
+            }
+          members.push_back (m);
+        }
+    }
+
+  std::vector<hid_t> native (members.size ());
+  std::vector<bool> logical (members.size ());
+  std::vector<size_t> offset (members.size ());
+  size_t recsize = 0;
+  for (size_t k = 0; k < members.size (); k++)
+    {
+      hid_t member_type = H5Tget_member_type (type_id, members[k]);
+      logical[k] = is_bool_type (member_type);
+      if (logical[k])
+        native[k] = make_bool_type ();
+      else
+        native[k] = H5Tget_native_type (member_type, H5T_DIR_ASCEND);
+      H5Tclose (member_type);
+      offset[k] = recsize;
+      recsize += H5Tget_size (native[k]);
+    }
 
-      if (err)
-        return octave_value_list ();
+  octave_scalar_map fields;
+  mem_type_id = H5Tcreate (H5T_COMPOUND, max (recsize, (size_t)1));
+  for (size_t k = 0; k < members.size (); k++)
+    {
+      char *name = H5Tget_member_name (type_id, members[k]);
+      H5Tinsert (mem_type_id, name, offset[k], native[k]);
+      H5free_memory (name);
+    }
 
-      file.write_dset_hyperslab (location.c_str (),
-                                 args(2),
-                                 start, count, stride, block, nargin-3);
+  hsize_t npoints = H5Sget_select_npoints (dspace_id);
+  std::vector<char> buf (max (npoints * recsize, (hsize_t)1));
+  herr_t read_result = 0;
+  if (! members.empty ())
+    read_result = dset_read (mem_type_id, memspace_id, dspace_id, &buf[0]);
+
+  for (size_t k = 0; k < members.size (); k++)
+    {
+      if (read_result >= 0)
+        {
+          void *data;
+          octave_value member;
+          if (logical[k])
+            {
+              boolNDArray flags (mat_dims);
+              data = flags.fortran_vec ();
+              member = octave_value (flags);
+            }
+          else
+            {
+              hid_t array_type;
+              member = alloc_numeric_array (native[k], mat_dims,
+                                            &data, &array_type);
+              if (member.is_undefined ())
+                {
+                  error ("cannot handle the size of the type of member %d",
+                         members[k]);
+                  read_result = -1;
+                  H5Tclose (native[k]);
+                  continue;
+                }
+              H5Tclose (array_type);
+            }
+          switch (H5Tget_size (native[k]))
+            {
+            case 8:
+              unpack_member<uint64_t> (&buf[0], recsize, offset[k], npoints, data);
+              break;
+            case 4:
+              unpack_member<uint32_t> (&buf[0], recsize, offset[k], npoints, data);
+              break;
+            case 2:
+              unpack_member<uint16_t> (&buf[0], recsize, offset[k], npoints, data);
+              break;
+            default:
+              unpack_member<uint8_t> (&buf[0], recsize, offset[k], npoints, data);
+            }
+          member.maybe_mutate ();
+
+          char *name = H5Tget_member_name (type_id, members[k]);
+          fields.assign (name, member);
+          H5free_memory (name);
+        }
+      H5Tclose (native[k]);
     }
 
-  return octave_value_list ();
-#endif
+  if (read_result < 0)
+    {
+      if (! error_state)
+        error ("error when reading dataset");
+      return retval;
+    }
+
+  retval = octave_value (fields);
+  return retval;
 }
 
+// Read from the open dataset, like H5Dread does.
+herr_t
+H5File::dset_read (hid_t mem_type, hid_t mem_space, hid_t file_space,
+                   void *buf)
+{
+  H5PhaseTimer timer (H5_PHASE_IO);
+  herr_t status = H5Dread (dset_id, mem_type, mem_space, file_space,
+                           xfer_plist, buf);
+  if (h5stats_current != NULL)
+    {
+      hid_t space = (mem_space == H5S_ALL ? H5Dget_space (dset_id) : mem_space);
+      hid_t type = H5Dget_type (dset_id);
+      h5stats_transfer (mem_type, type, H5Sget_select_npoints (space), false);
+      H5Tclose (type);
+      if (mem_space == H5S_ALL)
+        H5Sclose (space);
+    }
+  return status;
+}
 
-DEFUN_DLD (h5writeatt, args, nargout,
-           "-*- texinfo -*-\n\
-@deftypefn {Loadable Function} h5writeatt (@var{filename}, @var{objectname}, @var{attname}, @var{attvalue})\n\
-\n\
-Write an attribute with name @var{attname} and value @var{attvalue} to\n\
-the object named @var{objectname} in the HDF5 file specified by @var{filename}.\n\
-\n\
-@seealso{h5readatt}\n\
-@end deftypefn")
+// Write to the open dataset, like H5Dwrite does.
+herr_t
+H5File::dset_write (hid_t mem_type, hid_t mem_space, hid_t file_space,
+                    const void *buf)
 {
-#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
-  gripe_disabled_feature ("h5writeatt", "HDF5 IO");
-  return octave_value_list ();
-#else
-  int nargin = args.length ();
+  H5PhaseTimer timer (H5_PHASE_IO);
+  herr_t status = H5Dwrite (dset_id, mem_type, mem_space, file_space,
+                            xfer_plist, buf);
+  if (h5stats_current != NULL)
+    {
+      hid_t space = (mem_space == H5S_ALL ? H5Dget_space (dset_id) : mem_space);
+      hid_t type = H5Dget_type (dset_id);
+      h5stats_transfer (mem_type, type, H5Sget_select_npoints (space), true);
+      H5Tclose (type);
+      if (mem_space == H5S_ALL)
+        H5Sclose (space);
+    }
+  return status;
+}
 
-  if (nargin != 4 || nargout != 0)
+// Read or write the hyperslab sel_start, sel_stride, sel_count,
+// sel_block of dspace_id from or to the Octave array at DATA, whose
+// dimensions are those of the hyperslab in the order of the file.
+// The selection is transferred in slabs of whole blocks along the first
+// dimension of the file through a buffer of at most about
+// C_ORDER_SLAB_BYTES, and reordered between the buffer and DATA with
+// reorder_copy. Read data is byte swapped if SWAP is true.
+herr_t
+H5File::dset_io_c_order (hid_t mem_type, void *data, bool is_write,
+                         bool swap)
+{
+  int rank = sel_start.size ();
+  size_t elsize = H5Tget_size (mem_type);
+
+  // dimensions of the selection, and the strides of DATA in Octave's
+  // column major order
+  std::vector<hsize_t> dims (rank), fstride (rank), cstride (rank);
+  hsize_t rowsize = 1;
+  for (int i = 0; i < rank; i++)
     {
-      print_usage ();
-      return octave_value_list ();
+      dims[i] = sel_count[i] * sel_block[i];
+      fstride[i] = (i == 0 ? 1 : fstride[i-1] * dims[i-1]);
+      if (i > 0)
+        rowsize *= dims[i];
     }
-  if (! (args(0).is_string () && args(1).is_string () && args(2).is_string ()))
+
+  hsize_t blocksize = sel_block[0] * rowsize * elsize;
+  hsize_t nblocks = C_ORDER_SLAB_BYTES / std::max<hsize_t> (blocksize, 1);
+  nblocks = std::min (std::max<hsize_t> (nblocks, 1), sel_count[0]);
+  char *buf = (char*)malloc (nblocks * blocksize);
+  if (buf == NULL && nblocks * blocksize > 0)
+    return -1;
+
+  hid_t slab_space = H5Scopy (dspace_id);
+  std::vector<hsize_t> start (sel_start), count (sel_count);
+  herr_t status = 0;
+  for (hsize_t c = 0; c < sel_count[0] && status >= 0; c += nblocks)
     {
-      print_usage ();
-      return octave_value_list ();
+      start[0] = sel_start[0] + c * sel_stride[0];
+      count[0] = std::min (nblocks, sel_count[0] - c);
+      {
+        H5PhaseTimer timer (H5_PHASE_SELECT);
+        status = H5Sselect_hyperslab (slab_space, H5S_SELECT_SET, &start[0],
+                                      &sel_stride[0], &count[0],
+                                      &sel_block[0]);
+      }
+      if (status < 0)
+        break;
+
+      // the slab is stored in the buffer in the file's row major order
+      dims[0] = count[0] * sel_block[0];
+      for (int i = rank-1; i >= 0; i--)
+        cstride[i] = (i == rank-1 ? 1 : cstride[i+1] * dims[i+1]);
+      hsize_t npoints = dims[0] * rowsize;
+      hid_t mem_space = H5Screate_simple (1, &npoints, NULL);
+      char *part = (char*)data + c * sel_block[0] * elsize;
+
+      if (is_write)
+        {
+          reorder_copy (part, &fstride[0], buf, &cstride[0],
+                        &dims[0], rank, elsize);
+          status = dset_write (mem_type, mem_space, slab_space, buf);
+        }
+      else
+        {
+          status = dset_read (mem_type, mem_space, slab_space, buf);
+          if (status >= 0 && swap)
+            swap_bytes (buf, npoints, elsize);
+          if (status >= 0)
+            reorder_copy (buf, &cstride[0], part, &fstride[0],
+                          &dims[0], rank, elsize);
+        }
+      H5Sclose (mem_space);
     }
 
-  string filename = args(0).string_value ();
-  string location = args(1).string_value ();
-  string attname = args(2).string_value ();
-  
-  if (error_state)
-    return octave_value_list ();
-    
-  //open the hdf5 file
-  H5File file (filename.c_str (), false);
-  if (error_state)
-    return octave_value_list ();
+  H5Sclose (slab_space);
+  free (buf);
+  return status;
+}
 
-  file.write_att (location.c_str (), attname.c_str (),
-                  args(3));
+// The dimension of the file along which all the elements selected by
+// sel_start, sel_stride, sel_count and sel_block lie, or -1 if they
+// span several dimensions or there are less than two of them.
+int
+H5File::line_dim ()
+{
+  int dim = -1;
+  for (int i = 0; i < (int)sel_count.size (); i++)
+    if (sel_count[i] * sel_block[i] > 1)
+      {
+        if (dim >= 0)
+          return -1;
+        dim = i;
+      }
+  return dim;
+}
 
-  return octave_value_list ();
-#endif
+// Write the range R to the elements of dspace_id selected along the
+// dimension DIM of the file (see line_dim) by sel_start, sel_stride,
+// sel_count and sel_block. The range is expanded in pieces of at most
+// STREAM_SLAB_BYTES, each written to the part of the selection between
+// the coordinates of its first and last element.
+herr_t
+H5File::write_range (const Range& r, int dim)
+{
+  int rank = sel_start.size ();
+  hsize_t n = r.nelem ();
+  hsize_t piece = std::max<hsize_t> (STREAM_SLAB_BYTES / sizeof (double), 1);
+  std::vector<double> buf (std::min (piece, n));
+  std::vector<hsize_t> bstart (rank, 0), bcount (rank);
+  H5Sget_simple_extent_dims (dspace_id, &bcount[0], NULL);
+
+  herr_t status = 0;
+  for (hsize_t e = 0; e < n && status >= 0; e += piece)
+    {
+      hsize_t len = std::min (piece, n - e);
+      for (hsize_t i = 0; i < len; i++)
+        buf[i] = r.elem (e + i);
+
+      // the coordinates of the first and last element of the piece
+      hsize_t first = sel_start[dim] + e / sel_block[dim] * sel_stride[dim]
+                      + e % sel_block[dim];
+      hsize_t last = sel_start[dim]
+                     + (e + len - 1) / sel_block[dim] * sel_stride[dim]
+                     + (e + len - 1) % sel_block[dim];
+      bstart[dim] = first;
+      bcount[dim] = last - first + 1;
+      hid_t piece_space = H5Scopy (dspace_id);
+      {
+        H5PhaseTimer timer (H5_PHASE_SELECT);
+        status = H5Sselect_hyperslab (piece_space, H5S_SELECT_AND,
+                                      &bstart[0], NULL, &bcount[0], NULL);
+      }
+      if (status >= 0)
+        {
+          hid_t mem_space = H5Screate_simple (1, &len, NULL);
+          status = dset_write (H5T_NATIVE_DOUBLE, mem_space, piece_space,
+                               &buf[0]);
+          H5Sclose (mem_space);
+        }
+      H5Sclose (piece_space);
+    }
+  return status;
 }
 
+void
+H5File::set_read_options (const H5ReadOptions& opts)
+{
+  read_opts = opts;
+  if (set_collective (opts.collective) < 0)
+    error ("could not set up collective transfers");
+}
 
-DEFUN_DLD (h5create, args, nargout,
-           "-*- texinfo -*-\n\
-@deftypefn {Loadable Function} h5create (@var{filename}, @var{dsetname}, @var{size}, @var{key}, @var{val},...)\n\
-\n\
-Create a dataset with name @var{dsetname} and size @var{size} \n\
-in the HDF5 file specified by @var{filename}.\n\
-\n\
-The vector @var{size} may contain one or several Inf (or \n\
-equivalently: zero) values.\n\
-This will lead to unlimited maximum extent of the dataset in the\n\
-respective dimensions and 0 initial extent.\n\
-Note that any dataset with at least one unlimited dimension must be chunked and\n\
-it is generally recommended for large datasets.\n\
-\n\
-The list of @var{key}, @var{val} arguments allows to specify\n\
-certain properties of the dataset. Allowed settings are:\n\
-\n\
-@table @asis\n\
-@item @option{Datatype}\n\
-one of the strings @samp{double} @samp{single} @samp{uint64} @samp{uint32} @samp{uint16} @samp{uint8} @samp{int64} @samp{int32} @samp{int16} @samp{int8} \n\
-\n\
-@item @option{ChunkSize}\n\
-The value may be either a vector specifying the chunk size,\n\
-or an empty vector [], which means no chunking (this is the default),\n\
-or the string @samp{auto} which makes the library choose automatically \n\
-an appropriate chunk size, as best as it can. Note that the @samp{auto}\n\
-setting is not @sc{matlab} compatible.\n\
-@end table\n\
-\n\
-@seealso{h5write}\n\
-@end deftypefn")
+void
+H5File::set_write_options (const H5WriteOptions& opts)
 {
-#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
-  gripe_disabled_feature("h5create", "HDF5 IO");
-  return octave_value_list ();
+  write_opts = opts;
+  if (set_collective (opts.collective) < 0)
+    error ("could not set up collective transfers");
+}
+
+// Make all reads and writes collective MPI-IO transfers if COLLECTIVE
+// and the file is open with the MPI-IO driver. Otherwise the processes
+// transfer their data independently. In C order, the number of
+// transfers depends on the selection of each process, so the two
+// cannot be combined.
+herr_t
+H5File::set_collective (bool collective)
+{
+  if (! (collective && is_mpio))
+    return 0;
+  if (read_opts.c_order || write_opts.c_order)
+    {
+      error ("Order \"C\" cannot be combined with collective transfers");
+      return 0;
+    }
+#ifdef H5_HAVE_PARALLEL
+  if (xfer_plist == H5P_DEFAULT)
+    xfer_plist = H5Pcreate (H5P_DATASET_XFER);
+  return H5Pset_dxpl_mpio (xfer_plist, H5FD_MPIO_COLLECTIVE);
 #else
-  int nargin = args.length ();
+  return 0;
+#endif
+}
+
+void
+H5File::write_dset (const char *dsetname,
+                    const octave_value ov_data, bool create_parents)
+{
+  int rank = ov_data.dims ().length ();
 
-  if (! (nargin ==  3 || nargin == 5 || nargin == 7) || nargout != 0)
+  if (write_opts.c_order && ov_data.is_cellstr ())
     {
-      print_usage ();
-      return octave_value_list ();
+      error ("cell arrays of strings can only be written in F order");
+      return;
     }
-  if (! (args(0).is_string () && args(1).is_string ()))
+
+  // the zone map could not be updated afterwards, see update_zonemap,
+  // so nothing is written
+  if (is_mpio && H5Lexists (file, dsetname, H5P_DEFAULT) > 0
+      && H5Aexists_by_name (file, dsetname, "zonemap", H5P_DEFAULT) > 0)
     {
-      print_usage ();
-      return octave_value_list ();
+      error ("the zone map of a dataset cannot be updated by several MPI processes");
+      return;
     }
-  if ((nargin == 5 && ! args(3).is_string ())
-      || (nargin == 7 && ! args(5).is_string ()))
+
+  hsize_t *dims = alloc_hsize (ov_data.dims(), ALLOC_HSIZE_DEFAULT,
+                               ! write_opts.c_order);
+  dspace_id = H5Screate_simple (rank, dims, NULL);
+  // in C order the whole dataset is written as a hyperslab, see
+  // dset_io_c_order
+  sel_start.assign (rank, 0);
+  sel_stride.assign (rank, 1);
+  sel_count.assign (dims, dims + rank);
+  sel_block.assign (rank, 1);
+  free (dims);
+
+  // determine the endianness of this system
+  H5T_order_t o = H5Tget_order (H5T_NATIVE_INT);
+  if (o == H5T_ORDER_ERROR)
     {
-      print_usage ();
-      return octave_value_list ();
+      error ("HDF5 lib could not determine endianness of current system");
+      return;
     }
-  string filename = args(0).string_value ();
-  string location = args(1).string_value ();
-  if (error_state)
-    return octave_value_list ();
-  
-  Matrix size;
-  if (! check_vec (args(2), size, "SIZE", true))
-    return octave_value_list ();
 
+  // new datasets switch to dense attribute storage when they get many
+  // attributes
+  hid_t dcpl = H5Pcreate (H5P_DATASET_CREATE);
+  set_attr_storage (dcpl);
 
-  // loop over the key-value pairs and see what is given
-  string datatype = "double";
-  Matrix chunksize;
-  for (int i = 3; i+1 < nargin; i+=2)
+  if (create_parents)
+    create_parent_groups (dsetname);
+
+  herr_t status;
+  // find the right type
+  if (ov_data.is_string () || ov_data.is_cellstr ())
+    status = write_dset_strings (dsetname, ov_data, dcpl);
+  else if (ov_data.is_sparse_type ())
     {
-      if (args(i).string_value () == "Datatype")
+      // written as a group, see write_sparse; sparse logical matrices
+      // are converted to double
+      H5Sclose (dspace_id);
+      dspace_id = -1;
+      if (ov_data.is_complex_type ())
+        {
+          const SparseComplexMatrix data
+            = ov_data.sparse_complex_matrix_value ();
+          type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
+          status = write_sparse (dsetname, data, type_id);
+        }
+      else
+        {
+          const SparseMatrix data = ov_data.sparse_matrix_value ();
+          status = write_sparse (dsetname, data, H5T_NATIVE_DOUBLE);
+        }
+    }
+  else if (ov_data.is_complex_type ())
+    {
+      //check if the data set already exists. if it does, open it,
+      //otherwise, create it.  Furthermore check if the datatype is
+      //compliant with given octave data.
+  
+#define OPEN_OR_CREATE if (H5Lexists (file,dsetname,H5P_DEFAULT))       \
+        {                                                               \
+          if (open_dset (dsetname) < 0)                                 \
+            {                                                           \
+              error ("Could not open existing dataset in order to write to"); \
+              return;                                                   \
+            }                                                           \
+        }                                                               \
+      else                                                              \
+        dset_id = H5Dcreate (file, dsetname, type_id, dspace_id,        \
+                             H5P_DEFAULT, dcpl, H5P_DEFAULT)
+
+      // The data is written from the storage of the array, which is
+      // still shared with ov_data, so it must not be accessed with
+      // fortran_vec: that would copy it.
+#define OPEN_AND_WRITE OPEN_OR_CREATE;                                  \
+                                                                        \
+      if (write_opts.c_order)                                           \
+        status = dset_io_c_order (type_id, (void*)data.data (),         \
+                                  true, false);                         \
+      else                                                              \
+        status = dset_write (type_id, H5S_ALL, H5S_ALL, data.data ())
+  
+      type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
+      ComplexNDArray data = ov_data.complex_array_value ();
+      OPEN_AND_WRITE;
+    }
+  else if (ov_data.is_integer_type ())
+    {
+      if (ov_data.is_uint64_type ())
+        {
+          uint64NDArray data = ov_data.uint64_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U64LE : H5T_STD_U64BE);
+          OPEN_AND_WRITE;
+        }
+      else if (ov_data.is_uint32_type ())
+        {
+          uint32NDArray data = ov_data.uint32_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U32LE : H5T_STD_U32BE);
+          OPEN_AND_WRITE;
+        }
+      else if (ov_data.is_uint16_type ())
+        {
+          uint16NDArray data = ov_data.uint16_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U16LE : H5T_STD_U16BE);
+          OPEN_AND_WRITE;
+        }
+      else if (ov_data.is_uint8_type ())
+        {
+          uint8NDArray data = ov_data.uint8_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U8LE : H5T_STD_U8BE);
+          OPEN_AND_WRITE;
+        }
+      else if (ov_data.is_int64_type ())
         {
-          datatype = args(i+1).string_value ();
-          if (error_state)
-            {
-              error ("Datatype argument must be a string");
-              return octave_value_list ();
-            }
+          int64NDArray data = ov_data.int64_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I64LE : H5T_STD_I64BE);
+          OPEN_AND_WRITE;
         }
-      else if (args(i).string_value () == "ChunkSize")
+      else if (ov_data.is_int32_type ())
         {
-	  if (args(i+1).is_string ())
-	    {
-	      if(args(i+1).string_value () != "auto")
-		{
-		  error ("ChunkSize argument must be either a vector, or the string 'auto'.");
-		  return octave_value_list ();
-		}
-	      chunksize = args(2).matrix_value ();
-	      chunksize(0) = 0;
-
-	    }
-          else if (! check_vec (args(i+1), chunksize, "ChunkSize", false))
-            return octave_value_list ();
+          int32NDArray data = ov_data.int32_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I32LE : H5T_STD_I32BE);
+          OPEN_AND_WRITE;
+        }
+      else if (ov_data.is_int16_type ())
+        {
+          int16NDArray data = ov_data.int16_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I16LE : H5T_STD_I16BE);
+          OPEN_AND_WRITE;
+        }
+      else if (ov_data.is_int8_type ())
+        {
+          int8NDArray data = ov_data.int8_array_value ();
+          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I8LE : H5T_STD_I8BE);
+          OPEN_AND_WRITE;
         }
       else
         {
-          error ("unknown parameter name %s", args(i).string_value ().c_str ());
-          return octave_value_list ();
+          uint64NDArray data = ov_data.uint64_array_value ();
+          type_id = H5Tcopy (H5T_NATIVE_INT);
+          OPEN_AND_WRITE;
         }
+      
     }
-
-  
-  
-  //open the hdf5 file
-  H5File file (filename.c_str (), true);
-  if (error_state)
-    return octave_value_list ();
-  file.create_dset (location.c_str (), size, datatype.c_str (), chunksize);
-  
-  return octave_value_list ();
-#endif
-}
-
-
-DEFUN_DLD (h5delete, args, nargout,
-           "-*- texinfo -*-\n\
-@deftypefn {Loadable Function} h5delete (@var{filename}, @var{objname})\n\
-@deftypefnx {Loadable Function} h5delete (@var{filename}, @var{objname}, @var{attname})\n\
-\n\
-In the first form, delete a dataset or group with name @var{objname}\n\
-in the HDF5 file specified by @var{filename}.\n\
-\n\
-In the second form, delete an attribute with name @var{attname} associated\n\
-to a dataset or group with name @var{objname}\n\
-in the HDF5 file specified by @var{filename}.\n\
-\n\
-Note that this function is not @sc{matlab} compliant.\n\
-\n\
-@seealso{h5create}\n\
-@end deftypefn")
-{
-#if ! (defined (HAVE_HDF5) && defined (HAVE_HDF5_18))
-  gripe_disabled_feature("h5delete", "HDF5 IO");
-  return octave_value_list ();
-#else
-  int nargin = args.length ();
-
-  if (! (nargin ==  2 || nargin == 3) || nargout != 0)
+  else if (ov_data.is_single_type ())
     {
-      print_usage ();
-      return octave_value_list ();
+      FloatNDArray data = ov_data.float_array_value ();
+      type_id = H5Tcopy (H5T_NATIVE_FLOAT);
+      OPEN_AND_WRITE;
     }
-  if (! (args(0).is_string () && args(1).is_string ()))
+  else if (ov_data.is_bool_type ())
     {
-      print_usage ();
-      return octave_value_list ();
+      boolNDArray data = ov_data.bool_array_value ();
+      type_id = make_bool_type ();
+      OPEN_AND_WRITE;
     }
-  if (nargin == 3 && ! args(2).is_string ())
+  else if (ov_data.is_range () && line_dim () >= 0)
     {
-      print_usage ();
-      return octave_value_list ();
+      type_id = H5Tcopy (H5T_NATIVE_DOUBLE);
+      OPEN_OR_CREATE;
+      status = write_range (ov_data.range_value (), line_dim ());
     }
-  
-  string filename = args(0).string_value ();
-  string location = args(1).string_value ();
-  if (error_state)
-    return octave_value_list ();
+  else
+    {
+      NDArray data = ov_data.array_value ();
+      type_id = H5Tcopy (H5T_NATIVE_DOUBLE);
+      OPEN_AND_WRITE;
+    }
+  H5Pclose (dcpl);
 
-  //open the hdf5 file
-  H5File file (filename.c_str (), true);
-  if (error_state)
-    return octave_value_list ();
-  if (nargin == 2)
-    file.delete_link (location.c_str ());
-  else if (nargin == 3)
+  if (status < 0)
     {
-      string attname = args(2).string_value ();
-      if(!error_state)
-	file.delete_att (location.c_str (), attname.c_str ());
+      error ("error when writing the dataset %s", dsetname);
+      return;
     }
-  
-  return octave_value_list ();
-#endif
-}
 
-#if defined (HAVE_HDF5) && defined (HAVE_HDF5_18)
+  if (! (ov_data.is_string () || ov_data.is_cellstr ()
+         || ov_data.is_complex_type () || ov_data.is_sparse_type ()))
+    update_zonemap (ov_data, write_opts.c_order);
+}
 
-H5File::H5File (const char *filename, const bool create_if_nonexisting)
+// Create the groups in the path LOCATION which do not exist yet.
+void
+H5File::create_parent_groups (const char *location)
 {
-  H5E_auto_t oef;
-  void *olderr;
-  H5Eget_auto (H5E_DEFAULT,&oef,&olderr);
-  //suppress hdf5 error output
-  H5Eset_auto (H5E_DEFAULT,0,0);
+  // new groups switch to dense attribute storage when they get many
+  // attributes
+  hid_t gcpl = H5Pcreate (H5P_GROUP_CREATE);
+  set_attr_storage (gcpl);
 
-  file_stat fs (filename);
-  if (! fs.exists () && create_if_nonexisting)
-    file = H5Fcreate (filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-  else if (! fs.exists () && ! create_if_nonexisting)
-    error ("The file %s does not exist: %s", filename, strerror (errno));
-  else
+  //check if all groups in the path exist. if not, create them
+  string path (location);
+  for (int i=1; i < path.length (); i++)
     {
-      // test if the existing file is in HDF5 format
-      if (! H5Fis_hdf5 (filename))
-        error ("The file is not in the HDF5 format, %s: %s", filename, strerror (errno));
-      else
+      if (path[i] == '/')
         {
-          file = H5Fopen (filename, H5F_ACC_RDWR, H5P_DEFAULT);
-          if (file < 0)
-            error ("Opening the file failed, %s: %s", filename, strerror (errno));
+          if (! H5Lexists (file, path.substr(0,i).c_str (), H5P_DEFAULT))
+            {
+              hid_t group_id = H5Gcreate (file, path.substr(0,i).c_str (), H5P_DEFAULT, gcpl, H5P_DEFAULT);
+              H5Gclose (group_id);
+            }
         }
     }
-  // restore old setting
-  H5Eset_auto (H5E_DEFAULT,oef,olderr);
+  H5Pclose (gcpl);
 }
 
-H5File::~H5File ()
+void
+H5File::write_struct (const char *location, const octave_scalar_map& s)
 {
-  if (H5Iis_valid (memspace_id))
-    H5Sclose (memspace_id);
-
-  if (H5Iis_valid (dspace_id))
-    H5Sclose (dspace_id);
-
-  if (H5Iis_valid (dset_id))
-    H5Dclose (dset_id);
-  
-  if (H5Iis_valid (att_id))
-    H5Aclose (att_id);
-
-  if (H5Iis_valid (obj_id))
-    H5Oclose (obj_id);
-
-  if (H5Iis_valid (type_id))
-    H5Tclose (type_id);
-  
-  if (H5Iis_valid (mem_type_id))
-    H5Tclose (mem_type_id);
-
-  if (H5Iis_valid (file))
-    H5Fclose (file);
-
+  hid_t lcpl = H5Pcreate (H5P_LINK_CREATE);
+  hid_t gcpl = H5Pcreate (H5P_GROUP_CREATE);
+  H5Pset_create_intermediate_group (lcpl, 1);
+  set_attr_storage (gcpl);
+
+  string path (location);
+  while (path.length () > 1 && path[path.length () - 1] == '/')
+    path.erase (path.length () - 1);
+  write_struct_group (path, s, lcpl, gcpl);
+
+  H5Pclose (gcpl);
+  H5Pclose (lcpl);
+
+  // everything is flushed to the file at once
+  if (! error_state && H5Fflush (file, H5F_SCOPE_LOCAL) < 0)
+    error ("could not flush the file");
+}
 
-  if (h5_dims != NULL)
+// Write the fields of S to the group PATH, creating it (and the groups
+// above it) with the link and group creation property lists LCPL and
+// GCPL if it does not exist. Structs become subgroups, strings and real
+// scalars attributes of the group, and any other value a dataset as
+// written by h5write.
+void
+H5File::write_struct_group (const string& path, const octave_scalar_map& s,
+                            hid_t lcpl, hid_t gcpl)
+{
+  if (path != "/" && H5Lexists (file, path.c_str (), H5P_DEFAULT) <= 0)
     {
-      free (h5_dims);
-      h5_dims = NULL;
+      hid_t group_id = H5Gcreate (file, path.c_str (), lcpl, gcpl,
+                                  H5P_DEFAULT);
+      if (group_id < 0)
+        {
+          error ("could not create the group %s", path.c_str ());
+          return;
+        }
+      H5Gclose (group_id);
     }
-  if (h5_maxdims != NULL)
+
+  string_vector keys = s.fieldnames ();
+  for (octave_idx_type i = 0; i < keys.numel () && ! error_state; i++)
     {
-      free (h5_maxdims);
-      h5_maxdims = NULL;
+      octave_value val = s.contents (keys[i]);
+      string child = (path == "/" ? "/" : path + "/") + keys[i];
+      if (val.is_map ())
+        {
+          if (val.numel () != 1)
+            {
+              error ("the field %s is a struct array, only scalar structs are supported",
+                     child.c_str ());
+              return;
+            }
+          write_struct_group (child, val.scalar_map_value (), lcpl, gcpl);
+        }
+      else if ((val.is_string () && val.rows () <= 1)
+               || (val.numel () == 1 && ! val.is_complex_type ()
+                   && (val.is_numeric_type () || val.is_bool_type ())))
+        write_att (path.c_str (), keys[i].c_str (), val);
+      else if (val.is_numeric_type () || val.is_bool_type ()
+               || val.is_string () || val.is_cellstr ())
+        write_dset (child.c_str (), val, false);
+      else
+        {
+          error ("the field %s has an unsupported type", child.c_str ());
+          return;
+        }
+      close_handles ();
     }
 }
 
-// T will be Matrix or dim_vector
-template <typename T>
-hsize_t*
-H5File::alloc_hsize (const T& dim, const int mode, const bool reverse)
+octave_value
+H5File::read_group (const char *location, bool recursive)
 {
-  int rank = dim.length ();
-  hsize_t *hsize = (hsize_t*)malloc (rank * sizeof (hsize_t));
-  for (int i = 0; i < rank; i++)
+  string path (location);
+  while (path.length () > 1 && path[path.length () - 1] == '/')
+    path.erase (path.length () - 1);
+
+  H5GroupNode root;
+  std::vector<octave_value> values;
+  std::vector<H5GroupMember> members;
+  read_group_walk (path, recursive, root, values, members);
+  if (error_state)
+    return octave_value ();
+
+  // The datasets are read in the order in which their data is stored
+  // in the file. The raw chunks of compressed datasets are only
+  // collected here and decompressed in parallel afterwards.
+  std::stable_sort (members.begin (), members.end (), member_before);
+  std::vector<H5ChunkedRead> reads;
+  std::vector<H5RawChunk> chunks;
+  for (size_t i = 0; i < members.size (); i++)
     {
-      int j = reverse ? rank-i-1 : i;
-      if (mode == ALLOC_HSIZE_INFZERO_TO_UNLIMITED && (dim(i) == octave_Inf || dim(i) == 0))
-        hsize[j] = H5S_UNLIMITED;
-      else if (mode == ALLOC_HSIZE_INF_TO_ZERO && dim(i) == octave_Inf)
-        hsize[j] = 0;
+      const char *dsetname = members[i].path.c_str ();
+      if (members[i].sparse)
+        {
+          values[members[i].slot] = read_sparse_group (dsetname);
+          close_handles ();
+          if (error_state)
+            return octave_value ();
+          continue;
+        }
+      if (open_dset (dsetname) < 0)
+        return octave_value ();
+      bool is_raw = read_raw_chunks (members[i], reads, chunks);
+      close_handles ();
+      if (! is_raw)
+        {
+          values[members[i].slot] = read_dset_complete (dsetname);
+          close_handles ();
+          if (error_state)
+            return octave_value ();
+        }
+    }
+
+#ifdef H5_HAVE_FILTER_DEFLATE
+  {
+    H5PhaseTimer timer (H5_PHASE_IO);
+    inflate_chunks (reads, chunks);
+  }
+#endif
+  for (size_t i = 0; i < reads.size (); i++)
+    {
+      if (reads[i].ok)
+        {
+          reads[i].value.maybe_mutate ();
+          values[reads[i].slot] = reads[i].value;
+        }
       else
-        hsize[j] = dim(i);
+        {
+          // let the library try the chunks which could not be
+          // decompressed
+          values[reads[i].slot] = read_dset_complete (reads[i].path.c_str ());
+          close_handles ();
+          if (error_state)
+            return octave_value ();
+        }
     }
-  return hsize;
-}
 
+  return octave_value (build_group_struct (root, values));
+}
 
-int
-H5File::open_dset (const char *dsetname)
+// Add the attributes and members of the group PATH to NODE, descending
+// into subgroups if RECURSIVE. Attributes are read right away into
+// VALUES; for datasets and sparse matrices, an empty value is reserved,
+// and they are added to MEMBERS with the address of their data. The
+// zone maps of datasets are left out.
+void
+H5File::read_group_walk (const string& path, bool recursive,
+                         H5GroupNode& node, std::vector<octave_value>& values,
+                         std::vector<H5GroupMember>& members)
 {
-  dset_id = H5Dopen (file, dsetname, H5P_DEFAULT);
-  if (dset_id < 0)
+  std::vector<string> attnames, links;
+  hid_t group_id = H5Gopen (file, path.c_str (), H5P_DEFAULT);
+  if (group_id < 0)
     {
-      error ("Error opening dataset %s", dsetname);
-      return -1;
+      error ("could not open the group %s", path.c_str ());
+      return;
+    }
+  herr_t status = H5Aiterate2 (group_id, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                               collect_attr_name, &attnames);
+  if (status >= 0)
+    status = H5Literate (group_id, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                         collect_link_name, &links);
+  H5Gclose (group_id);
+  if (status < 0)
+    {
+      error ("could not list the members of the group %s", path.c_str ());
+      return;
     }
 
-  dspace_id = H5Dget_space (dset_id);
-  if (dspace_id < 0)
+  for (size_t i = 0; i < attnames.size (); i++)
     {
-      error ("Error opening dataspace of dataset %s", dsetname);
-      return -1;
+      octave_value val = read_att (path.c_str (), attnames[i].c_str ());
+      close_handles ();
+      if (error_state)
+        return;
+      node.names.push_back (attnames[i]);
+      node.index.push_back (values.size ());
+      node.is_group.push_back (false);
+      values.push_back (val);
+    }
+
+  // the address of the data of a dataset is not defined before it is
+  // allocated, which is reported as an error
+  H5E_auto_t oef;
+  void *olderr;
+  H5Eget_auto (H5E_DEFAULT, &oef, &olderr);
+  H5Eset_auto (H5E_DEFAULT, 0, 0);
+  for (size_t i = 0; i < links.size () && ! error_state; i++)
+    {
+      const string& name = links[i];
+      if (name.length () > 8
+          && name.compare (name.length () - 8, 8, "_zonemap") == 0
+          && std::find (links.begin (), links.end (),
+                        name.substr (0, name.length () - 8)) != links.end ())
+        continue;
+      string child = (path == "/" ? "/" : path + "/") + name;
+      hid_t obj = H5Oopen (file, child.c_str (), H5P_DEFAULT);
+      if (obj < 0)
+        continue;  // dangling soft or external links
+      H5I_type_t type = H5Iget_type (obj);
+      bool sparse = (type == H5I_GROUP && is_sparse_group (child.c_str ()));
+      if (sparse)
+        {
+          // the sparse matrix is found at the address of its data
+          H5Oclose (obj);
+          obj = H5Dopen (file, (child + "/data").c_str (), H5P_DEFAULT);
+        }
+      if (type == H5I_DATASET || sparse)
+        {
+          H5GroupMember m;
+          m.path = child;
+          m.slot = values.size ();
+          m.sparse = sparse;
+          m.addr = obj < 0 ? HADDR_UNDEF : H5Dget_offset (obj);
+#if H5_VERSION_GE (1, 10, 5)
+          hsize_t nchunks = 0;
+          if (obj >= 0 && m.addr == HADDR_UNDEF
+              && H5Dget_num_chunks (obj, H5S_ALL, &nchunks) >= 0
+              && nchunks > 0)
+            H5Dget_chunk_info (obj, H5S_ALL, 0, NULL, NULL, &m.addr, NULL);
+#endif
+          if (obj >= 0)
+            H5Oclose (obj);
+          node.names.push_back (name);
+          node.index.push_back (values.size ());
+          node.is_group.push_back (false);
+          values.push_back (octave_value ());
+          members.push_back (m);
+        }
+      else if (type == H5I_GROUP && recursive)
+        {
+          H5Oclose (obj);
+          node.names.push_back (name);
+          node.index.push_back (node.groups.size ());
+          node.is_group.push_back (true);
+          node.groups.push_back (H5GroupNode ());
+          H5Eset_auto (H5E_DEFAULT, oef, olderr);
+          read_group_walk (child, recursive, node.groups.back (), values,
+                           members);
+          H5Eset_auto (H5E_DEFAULT, 0, 0);
+        }
+      else
+        H5Oclose (obj);
     }
+  H5Eset_auto (H5E_DEFAULT, oef, olderr);
+}
 
-  rank = H5Sget_simple_extent_ndims (dspace_id);
-  if (rank < 0)
+// Read the raw chunks of the dataset open as dset_id, the member M of a
+// group, into CHUNKS, and add the dataset to READS, so that the chunks
+// are decompressed by inflate_chunks. This is only done if the dataset
+// is chunked and compressed with nothing but deflate and shuffle, all
+// of its chunks have been written, and its type is the native type of
+// the array it is read into. Returns false (with nothing read)
+// otherwise.
+bool
+H5File::read_raw_chunks (const H5GroupMember& m,
+                         std::vector<H5ChunkedRead>& reads,
+                         std::vector<H5RawChunk>& chunks)
+{
+#if H5_VERSION_GE (1, 10, 3) && defined (H5_HAVE_FILTER_DEFLATE)
+  if (rank == 0)
+    return false;
+  hsize_t numel = 1;
+  for (int k = 0; k < rank; k++)
+    numel *= h5_dims[k];
+  if (numel == 0)
+    return false;
+
+  H5ChunkedRead d;
+  d.chunk.resize (rank);
+  hid_t dcpl = H5Dget_create_plist (dset_id);
+  bool ok = (H5Pget_layout (dcpl) == H5D_CHUNKED
+             && H5Pget_chunk (dcpl, rank, &d.chunk[0]) == rank);
+  bool deflate = false;
+  int nfilters = (ok ? H5Pget_nfilters (dcpl) : 0);
+  for (int f = 0; f < nfilters && ok; f++)
     {
-      error ("Error reading extent of %s", dsetname);
-      return -1;
+      unsigned flags, filter_config;
+      size_t nelmts = 0;
+      H5Z_filter_t id = H5Pget_filter (dcpl, f, &flags, &nelmts, NULL,
+                                       0, NULL, &filter_config);
+      ok = (id == H5Z_FILTER_DEFLATE || id == H5Z_FILTER_SHUFFLE);
+      deflate = deflate || id == H5Z_FILTER_DEFLATE;
+      d.filters.push_back (id);
     }
+  H5Pclose (dcpl);
+  if (! ok || ! deflate)
+    return false;
 
-  h5_dims = (hsize_t*)malloc (rank * sizeof(hsize_t));
-  h5_maxdims = (hsize_t*)malloc (rank * sizeof(hsize_t));
-  if (! h5_dims || ! h5_maxdims)
+  type_id = H5Dget_type (dset_id);
+  H5T_class_t cls = H5Tget_class (type_id);
+  if (cls != H5T_INTEGER && cls != H5T_FLOAT)
+    return false;
+
+  // the offsets and sizes of all chunks, none of which may be missing
+  std::vector<hsize_t> grid (rank, 0), ngrid (rank);
+  hsize_t nchunks = 1;
+  for (int k = 0; k < rank; k++)
     {
-      error ("Error allocating memory for %s", dsetname);
-      return -1;
+      ngrid[k] = (h5_dims[k] + d.chunk[k] - 1) / d.chunk[k];
+      nchunks *= ngrid[k];
     }
-  if (H5Sget_simple_extent_dims (dspace_id, h5_dims, h5_maxdims) < 0)
+  std::vector<H5RawChunk> raw (nchunks);
+  H5E_auto_t oef;
+  void *olderr;
+  H5Eget_auto (H5E_DEFAULT, &oef, &olderr);
+  H5Eset_auto (H5E_DEFAULT, 0, 0);
+  for (hsize_t c = 0; c < nchunks && ok; c++)
     {
-      error ("Error determining current dimensions and maximum size of dataset %s", dsetname);
-      return -1;
+      raw[c].offset.resize (rank);
+      for (int k = 0; k < rank; k++)
+        raw[c].offset[k] = grid[k] * d.chunk[k];
+      for (int k = rank-1; k >= 0 && ++grid[k] == ngrid[k]; k--)
+        grid[k] = 0;
+      hsize_t size = 0;
+      ok = (H5Dget_chunk_storage_size (dset_id, &raw[c].offset[0], &size) >= 0
+            && size > 0);
+      if (ok)
+        raw[c].raw.resize (size);
     }
-  
-  return 0;
-}
-
-octave_value
-H5File::read_dset_complete (const char *dsetname)
-{
-  if (open_dset (dsetname) < 0)
-    return octave_value_list ();
+  H5Eset_auto (H5E_DEFAULT, oef, olderr);
+  if (! ok)
+    return false;
 
   mat_dims.resize (max (rank, 2));
-  // .resize(1) still leaves mat_dims with a length of 2 for some reason, so
-  // we need at least 2 filled
   mat_dims(0) = mat_dims(1) = 1;
   for (int i = 0; i < rank; i++)
-    //note that this is reversing the order
     mat_dims(i) = h5_dims[rank-i-1];
+  void *data;
+  d.value = alloc_numeric_array (cls == H5T_INTEGER ? type_id
+                                 : H5T_NATIVE_DOUBLE,
+                                 mat_dims, &data, &mem_type_id);
+  if (d.value.is_undefined () || H5Tequal (type_id, mem_type_id) <= 0)
+    return false;
+
+  {
+    H5PhaseTimer timer (H5_PHASE_IO);
+    for (hsize_t c = 0; c < nchunks; c++)
+      {
+        if (H5Dread_chunk (dset_id, H5P_DEFAULT, &raw[c].offset[0],
+                           &raw[c].filter_mask, &raw[c].raw[0]) < 0)
+          return false;
+        raw[c].dset = reads.size ();
+        raw[c].ok = true;
+        if (h5stats_current != NULL)
+          h5stats_current->bytes_read += raw[c].raw.size ();
+      }
+  }
+
+  d.path = m.path;
+  d.slot = m.slot;
+  d.data = (char*)data;
+  d.dims.assign (h5_dims, h5_dims + rank);
+  d.elsize = H5Tget_size (type_id);
+  d.ok = true;
+  reads.push_back (d);
+  chunks.insert (chunks.end (), std::make_move_iterator (raw.begin ()),
+                 std::make_move_iterator (raw.end ()));
+  return true;
+#else
+  return false;
+#endif
+}
 
-  if (H5Sselect_all (dspace_id) < 0)
+herr_t
+H5File::write_dset_strings (const char *dsetname, const octave_value& ov_data,
+                            hid_t dcpl)
+{
+  // A char matrix is written as a dataset of fixed length strings, one
+  // per row (a scalar dataset for a single row). A char array of more
+  // dimensions is written as a dataset of the same shape of strings of
+  // length 1, i.e. of single characters. A cell array of strings is
+  // written as a dataset of variable length strings of the same shape.
+  // In all cases all strings go into a single H5Dwrite.
+  std::vector<char> fixed_buf;
+  std::vector<const char*> vlen_buf;
+  Array<string> cellstr;
+  charNDArray chars;
+  const void *buf;
+
+  H5Sclose (dspace_id);
+  if (ov_data.is_string () && ov_data.ndims () > 2)
     {
-      error ("Error selecting complete dataset %s", dsetname);
-      return octave_value_list ();
+      chars = ov_data.char_array_value ();
+      type_id = H5Tcopy (H5T_C_S1);
+      H5Tset_size (type_id, 1);
+      H5Tset_strpad (type_id, H5T_STR_NULLPAD);
+      buf = chars.data ();
+
+      hsize_t *dims = alloc_hsize (chars.dims (), ALLOC_HSIZE_DEFAULT, true);
+      dspace_id = H5Screate_simple (chars.ndims (), dims, NULL);
+      free (dims);
     }
+  else if (ov_data.is_string ())
+    {
+      charMatrix strings = ov_data.char_matrix_value ();
+      hsize_t n = strings.rows ();
+      size_t len = strings.cols ();
 
-  octave_value retval = read_dset ();
-  return retval;
+      type_id = H5Tcopy (H5T_C_S1);
+      H5Tset_size (type_id, max (len, (size_t)1));
+      H5Tset_strpad (type_id, H5T_STR_NULLPAD);
+
+      // the rows of the column major char matrix become consecutive
+      // strings
+      fixed_buf.resize (max (n * len, (hsize_t)1), '\0');
+      const char *src = strings.data ();
+      for (hsize_t i = 0; i < n; i++)
+        for (size_t j = 0; j < len; j++)
+          fixed_buf[i*len + j] = src[i + j*n];
+      buf = &fixed_buf[0];
+
+      if (n == 1)
+        dspace_id = H5Screate (H5S_SCALAR);
+      else
+        dspace_id = H5Screate_simple (1, &n, NULL);
+    }
+  else
+    {
+      cellstr = ov_data.cellstr_value ();
+      octave_idx_type n = cellstr.numel ();
+
+      type_id = H5Tcopy (H5T_C_S1);
+      H5Tset_size (type_id, H5T_VARIABLE);
+
+      vlen_buf.resize (max (n, (octave_idx_type)1));
+      for (octave_idx_type i = 0; i < n; i++)
+        vlen_buf[i] = cellstr(i).c_str ();
+      buf = &vlen_buf[0];
+
+      hsize_t *dims = alloc_hsize (ov_data.dims (), ALLOC_HSIZE_DEFAULT, true);
+      dspace_id = H5Screate_simple (ov_data.dims ().length (), dims, NULL);
+      free (dims);
+    }
+
+  // An existing dataset is written to if it has the same extent and the
+  // same kind of strings (of the same length if fixed), and replaced
+  // otherwise, as H5S_ALL would not fit it.
+  bool create = true;
+  if (H5Lexists (file, dsetname, H5P_DEFAULT) > 0)
+    {
+      dset_id = H5Dopen (file, dsetname, H5P_DEFAULT);
+      if (dset_id < 0)
+        {
+          error ("Could not open existing dataset in order to write to");
+          return -1;
+        }
+      hid_t old_type = H5Dget_type (dset_id);
+      hid_t old_space = H5Dget_space (dset_id);
+      bool fits = (H5Tget_class (old_type) == H5T_STRING
+                   && H5Sextent_equal (old_space, dspace_id) > 0
+                   && H5Tis_variable_str (old_type) == H5Tis_variable_str (type_id)
+                   && (H5Tis_variable_str (type_id) > 0
+                       || H5Tget_size (old_type) == H5Tget_size (type_id)));
+      H5Sclose (old_space);
+      H5Tclose (old_type);
+      create = ! fits;
+      if (! fits)
+        {
+          H5Dclose (dset_id);
+          dset_id = -1;
+          if (H5Ldelete (file, dsetname, H5P_DEFAULT) < 0)
+            {
+              error ("Could not replace the dataset %s", dsetname);
+              return -1;
+            }
+        }
+    }
+  if (create)
+    dset_id = H5Dcreate (file, dsetname, type_id, dspace_id,
+                         H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  if (dset_id < 0)
+    return -1;
+
+  return dset_write (type_id, H5S_ALL, H5S_ALL, buf);
 }
 
-octave_value
-H5File::read_dset_hyperslab (const char *dsetname,
-                             const Matrix& start, const Matrix& count,
-                             const Matrix& stride, const Matrix& block,
-                             int nargin)
+// A sparse matrix is stored as a group in the compressed sparse column
+// layout of scipy and anndata: the datasets "data" with the nonzero
+// values in column major order, "indices" with their zero based row
+// indices and "indptr" with the offset of each column in both (and the
+// number of values at the end), which are exactly Octave's data, ridx
+// and cidx. The attributes "encoding-type" ("csc_matrix"),
+// "encoding-version" and "shape" (the number of rows and columns) of
+// the group identify it.
+
+// Write the string VALUE to the attribute NAME of the object OBJ.
+static herr_t
+write_string_att (hid_t obj, const char *name, const string& value)
 {
-  if (open_dset (dsetname) < 0)
-    return octave_value_list ();
-
-  if (rank == 0 && ! (start.is_empty () && count.is_empty ()
-                      && stride.is_empty () && block.is_empty ()))
+  hid_t str_type = H5Tcopy (H5T_C_S1);
+  H5Tset_size (str_type, value.length () + 1);
+  hid_t aspace = H5Screate (H5S_SCALAR);
+  hid_t attr = H5Acreate (obj, name, str_type, aspace,
+                          H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status = -1;
+  if (attr >= 0)
     {
-      error ("Cannot specify hyperslab for scalar datasets (rank 0)");
-      return octave_value_list ();
+      status = H5Awrite (attr, str_type, value.c_str ());
+      H5Aclose (attr);
     }
+  H5Sclose (aspace);
+  H5Tclose (str_type);
+  return status;
+}
 
-  if (start.nelem () != rank)
+// Read the fixed or variable length string attribute NAME of the object
+// OBJ into VALUE. Returns false if it has no such attribute.
+static bool
+read_string_att (hid_t obj, const char *name, string& value)
+{
+  if (H5Aexists (obj, name) <= 0)
+    return false;
+  hid_t attr = H5Aopen (obj, name, H5P_DEFAULT);
+  hid_t type = H5Aget_type (attr);
+  bool found = false;
+  if (H5Tget_class (type) == H5T_STRING && H5Tis_variable_str (type) > 0)
     {
-      error ("start must be a vector of length %d, the dataset rank", rank);
-      return octave_value_list ();
+      char *buf = NULL;
+      hid_t mem_type = H5Tcopy (H5T_C_S1);
+      H5Tset_size (mem_type, H5T_VARIABLE);
+      found = H5Aread (attr, mem_type, &buf) >= 0 && buf != NULL;
+      if (found)
+        value = buf;
+      H5free_memory (buf);
+      H5Tclose (mem_type);
     }
-  if (count.nelem () != rank)
+  else if (H5Tget_class (type) == H5T_STRING)
     {
-      error ("count must be a vector of length %d, the dataset rank", rank);
-      return octave_value_list ();
+      std::vector<char> buf (H5Tget_size (type) + 1, 0);
+      found = H5Aread (attr, type, &buf[0]) >= 0;
+      if (found)
+        value = &buf[0];
     }
-  
-  Matrix _stride = stride;
-  if (nargin < 3)
-    _stride = Matrix (dim_vector(1, rank), 1);
-  if (_stride.nelem () != rank)
+  H5Tclose (type);
+  H5Aclose (attr);
+  return found;
+}
+
+// Return true if LOCATION is a group holding a sparse matrix.
+bool
+H5File::is_sparse_group (const char *location)
+{
+  H5E_auto_t oef;
+  void *olderr;
+  H5Eget_auto (H5E_DEFAULT, &oef, &olderr);
+  H5Eset_auto (H5E_DEFAULT, 0, 0);
+  string encoding;
+  hid_t obj = H5Oopen (file, location, H5P_DEFAULT);
+  bool retval = (obj >= 0 && H5Iget_type (obj) == H5I_GROUP
+                 && read_string_att (obj, "encoding-type", encoding)
+                 && encoding == "csc_matrix");
+  if (obj >= 0)
+    H5Oclose (obj);
+  H5Eset_auto (H5E_DEFAULT, oef, olderr);
+  return retval;
+}
+
+// Write the N elements of BUF, of the type MEM_TYPE, to the new dataset
+// NAME in GROUP of the type FILE_TYPE, one of the parts of a sparse
+// matrix. It is chunked, and compressed if deflate is available.
+herr_t
+H5File::write_sparse_part (hid_t group, const char *name, hid_t file_type,
+                           hid_t mem_type, hsize_t n, const void *buf)
+{
+  hsize_t maxdim = H5S_UNLIMITED;
+  hsize_t chunk = max (min (n, SPARSE_CHUNK), (hsize_t)1);
+  hid_t space = H5Screate_simple (1, &n, &maxdim);
+  hid_t dcpl = H5Pcreate (H5P_DATASET_CREATE);
+  H5Pset_chunk (dcpl, 1, &chunk);
+  if (H5Zfilter_avail (H5Z_FILTER_DEFLATE) > 0)
     {
-      error ("stride must be a vector of length %d, the dataset rank", rank);
-      return octave_value_list ();
+      H5Pset_shuffle (dcpl);
+      H5Pset_deflate (dcpl, 4);
     }
-  Matrix _block = block;
-  if (nargin < 4)
-    _block = Matrix (dim_vector(1, rank), 1);
-  if (_block.nelem () != rank)
+  dset_id = H5Dcreate (group, name, file_type, space,
+                       H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  H5Pclose (dcpl);
+  H5Sclose (space);
+  if (dset_id < 0)
+    return -1;
+  herr_t status = 0;
+  if (n > 0)
+    status = dset_write (mem_type, H5S_ALL, H5S_ALL, buf);
+  H5Dclose (dset_id);
+  dset_id = -1;
+  return status;
+}
+
+// Read the dataset NAME in GROUP, one of the parts of a sparse matrix,
+// which must have N elements, into BUF as MEM_TYPE.
+herr_t
+H5File::read_sparse_part (hid_t group, const char *name, hid_t mem_type,
+                          hsize_t n, void *buf)
+{
+  dset_id = H5Dopen (group, name, H5P_DEFAULT);
+  if (dset_id < 0)
+    return -1;
+  hid_t space = H5Dget_space (dset_id);
+  herr_t status = -1;
+  if (H5Sget_simple_extent_npoints (space) == (hssize_t)n)
+    status = n > 0 ? dset_read (mem_type, H5S_ALL, H5S_ALL, buf) : 0;
+  H5Sclose (space);
+  H5Dclose (dset_id);
+  dset_id = -1;
+  return status;
+}
+
+// Write the sparse matrix M as the group LOCATION, whose nonzero values
+// are stored as DATA_TYPE. The parts are written straight from the
+// storage of M.
+template <typename T>
+herr_t
+H5File::write_sparse (const char *location, const Sparse<T>& m,
+                      hid_t data_type)
+{
+  // any object at LOCATION is replaced, as a dataset would be
+  if (H5Lexists (file, location, H5P_DEFAULT) > 0
+      && H5Ldelete (file, location, H5P_DEFAULT) < 0)
+    return -1;
+
+  hid_t gcpl = H5Pcreate (H5P_GROUP_CREATE);
+  set_attr_storage (gcpl);
+  hid_t group = H5Gcreate (file, location, H5P_DEFAULT, gcpl, H5P_DEFAULT);
+  H5Pclose (gcpl);
+  if (group < 0)
+    return -1;
+
+  herr_t status = write_string_att (group, "encoding-type", "csc_matrix");
+  if (status >= 0)
+    status = write_string_att (group, "encoding-version", "0.1.0");
+  if (status >= 0)
     {
-      error ("block must be a vector of length %d, the dataset rank", rank);
-      return octave_value_list ();
+      hsize_t two = 2;
+      long long shape[2] = { m.rows (), m.cols () };
+      hid_t aspace = H5Screate_simple (1, &two, NULL);
+      hid_t attr = H5Acreate (group, "shape", H5T_STD_I64LE, aspace,
+                              H5P_DEFAULT, H5P_DEFAULT);
+      status = attr < 0 ? -1 : H5Awrite (attr, H5T_NATIVE_LLONG, shape);
+      if (attr >= 0)
+        H5Aclose (attr);
+      H5Sclose (aspace);
     }
-  
-  // .resize(1) still leaves mat_dims with a length of 2 for some reason, so
-  // we need at least 2 filled
-  mat_dims.resize (max (rank, 2));
-  mat_dims(0) = mat_dims(1) = 1;
 
-  Matrix _count = count;
-  for (int i = 0; i < rank; i++)
+  hid_t idx_type = (sizeof (octave_idx_type) == 8
+                    ? H5T_NATIVE_INT64 : H5T_NATIVE_INT32);
+  octave_idx_type nnz = m.nnz ();
+  if (status >= 0)
+    status = write_sparse_part (group, "data", data_type, data_type,
+                                nnz, m.data ());
+  if (status >= 0)
+    status = write_sparse_part (group, "indices", H5T_STD_I64LE, idx_type,
+                                nnz, m.ridx ());
+  if (status >= 0)
+    status = write_sparse_part (group, "indptr", H5T_STD_I64LE, idx_type,
+                                m.cols () + 1, m.cidx ());
+  H5Gclose (group);
+  return status;
+}
+
+// Order the values of a column of a sparse matrix by their rows.
+template <typename T>
+static bool
+row_less (const std::pair<octave_idx_type, T>& a,
+          const std::pair<octave_idx_type, T>& b)
+{
+  return a.first < b.first;
+}
+
+// Read the parts of the sparse matrix in GROUP, of NR rows and NC
+// columns, straight into the storage of a new sparse matrix M, reading
+// the nonzero values as DATA_TYPE. Their indices are checked, and
+// sorted within the columns if they are not yet.
+template <typename T>
+bool
+H5File::read_sparse (hid_t group, octave_idx_type nr, octave_idx_type nc,
+                     hid_t data_type, Sparse<T>& m)
+{
+  hid_t idx_type = (sizeof (octave_idx_type) == 8
+                    ? H5T_NATIVE_INT64 : H5T_NATIVE_INT32);
+
+  // the number of values is the last element of indptr
+  std::vector<octave_idx_type> indptr (nc + 1);
+  if (read_sparse_part (group, "indptr", idx_type, nc + 1, &indptr[0]) < 0
+      || indptr[nc] < 0)
+    return false;
+
+  m = Sparse<T> (nr, nc, indptr[nc]);
+  std::copy (indptr.begin (), indptr.end (), m.xcidx ());
+  octave_idx_type nnz = indptr[nc];
+  if (read_sparse_part (group, "indices", idx_type, nnz, m.xridx ()) < 0
+      || read_sparse_part (group, "data", data_type, nnz, m.xdata ()) < 0)
+    return false;
+
+  const octave_idx_type *cidx = m.xcidx ();
+  octave_idx_type *ridx = m.xridx ();
+  T *data = m.xdata ();
+  if (cidx[0] != 0)
+    return false;
+  std::vector<std::pair<octave_idx_type, T> > column;
+  for (octave_idx_type j = 0; j < nc; j++)
     {
-      if (_stride(i) < _block(i))
-        {
-          error ("In dimension %d, requested stride %d smaller than block size %d",
-                 i+1, (int)_stride(i), (int)_block(i));
-          return octave_value_list ();
-        }
-      if (_count(i) == 0)
+      if (cidx[j+1] < cidx[j])
+        return false;
+      bool sorted = true;
+      for (octave_idx_type k = cidx[j]; k < cidx[j+1]; k++)
         {
-          // a value of 0 (or Inf) means that as many blocks as possible
-          // shall be read in this dimension
-          _count(i) = (h5_dims[rank-i-1] - start(i) - _block(i)) / _stride(i) + 1;
+          if (ridx[k] < 0 || ridx[k] >= nr)
+            return false;
+          sorted = sorted && (k == cidx[j] || ridx[k-1] < ridx[k]);
         }
-      mat_dims(i) = _count(i)*_block(i);
-      int end = start(i) + _stride(i)*(_count(i)-1) + _block(i); // exclusive
-      if (h5_dims[rank-i-1] < end)
+      if (sorted)
+        continue;
+      column.clear ();
+      for (octave_idx_type k = cidx[j]; k < cidx[j+1]; k++)
+        column.push_back (std::make_pair (ridx[k], data[k]));
+      std::sort (column.begin (), column.end (), row_less<T>);
+      for (octave_idx_type k = cidx[j]; k < cidx[j+1]; k++)
         {
-          error ("In dimension %d, dataset only has %d elements, but at least %d"
-                 " are required for requested hyperslab", i+1, (int)h5_dims[rank-i-1],
-                 end);
-          return octave_value_list ();
+          ridx[k] = column[k - cidx[j]].first;
+          data[k] = column[k - cidx[j]].second;
+          // a row may hold only one value
+          if (k > cidx[j] && ridx[k-1] == ridx[k])
+            return false;
         }
     }
+  return true;
+}
 
-  hsize_t *hstart = alloc_hsize (start, ALLOC_HSIZE_DEFAULT, true);
-  hsize_t *hstride = alloc_hsize (_stride, ALLOC_HSIZE_DEFAULT, true);
-  hsize_t *hcount = alloc_hsize (_count, ALLOC_HSIZE_DEFAULT, true);
-  hsize_t *hblock = alloc_hsize (_block, ALLOC_HSIZE_DEFAULT, true);
-  // TODO check these (and hmem) for NULLs
-
-  herr_t sel_result = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, hstart,
-                                           hstride, hcount, hblock);
+// Read the sparse matrix stored as the group LOCATION, as a
+// SparseMatrix, or a SparseComplexMatrix if its values are complex.
+octave_value
+H5File::read_sparse_group (const char *location)
+{
+  H5PhaseTimer timer (H5_PHASE_OPEN);
+  hid_t group = H5Gopen (file, location, H5P_DEFAULT);
+  if (group < 0)
+    {
+      error ("Error opening the sparse matrix %s", location);
+      return octave_value ();
+    }
 
-  free (hstart);
-  free (hstride);
-  free (hcount);
-  free (hblock);
+  long long shape[2] = { -1, -1 };
+  hid_t attr = H5Aopen (group, "shape", H5P_DEFAULT);
+  hid_t aspace = attr < 0 ? -1 : H5Aget_space (attr);
+  if (aspace < 0 || H5Sget_simple_extent_npoints (aspace) != 2
+      || H5Aread (attr, H5T_NATIVE_LLONG, shape) < 0
+      || shape[0] < 0 || shape[1] < 0)
+    error ("the sparse matrix %s has no valid shape", location);
+  if (aspace >= 0)
+    H5Sclose (aspace);
+  if (attr >= 0)
+    H5Aclose (attr);
+  if (error_state)
+    {
+      H5Gclose (group);
+      return octave_value ();
+    }
 
-  if (sel_result < 0)
-    return octave_value_list ();
+  // the values are complex if they have the type Octave writes for
+  // complex values, and read as double otherwise
+  hid_t complex_type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
+  hid_t data = H5Dopen (group, "data", H5P_DEFAULT);
+  hid_t data_type = data < 0 ? -1 : H5Dget_type (data);
+  bool is_cmplx = (data_type >= 0 && H5Tget_class (data_type) == H5T_COMPOUND
+                   && hdf5_types_compatible (data_type, complex_type_id) > 0);
+  if (data_type >= 0)
+    H5Tclose (data_type);
+  if (data >= 0)
+    H5Dclose (data);
 
-  octave_value retval = read_dset ();
+  octave_value retval;
+  bool ok;
+  if (is_cmplx)
+    {
+      SparseComplexMatrix m;
+      ok = read_sparse (group, shape[0], shape[1], complex_type_id, m);
+      if (ok)
+        retval = octave_value (m);
+    }
+  else
+    {
+      SparseMatrix m;
+      ok = read_sparse (group, shape[0], shape[1], H5T_NATIVE_DOUBLE, m);
+      if (ok)
+        retval = octave_value (m);
+    }
+  H5Tclose (complex_type_id);
+  H5Gclose (group);
+  if (! ok)
+    error ("error when reading the sparse matrix %s", location);
   return retval;
 }
 
-octave_value
-H5File::read_dset ()
+void
+H5File::write_dset_hyperslab (const char *dsetname,
+                              const octave_value ov_data,
+                              const Matrix& start, const Matrix& count,
+                              const Matrix& stride, const Matrix& block,
+                              int nargin)
 {
-  bool is_cmplx = false;
-  type_id = H5Dget_type (dset_id);
-  hid_t complex_type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
-
-  // hsize_t *hmem = alloc_hsize (mat_dims, ALLOC_HSIZE_DEFAULT, false);
-  // hid_t memspace_id = H5Screate_simple (rank, hmem, hmem);
-  // free (hmem);
+  if (open_dset (dsetname) < 0)
+    return;
 
-  octave_value retval;
-  if (H5Tget_class (type_id) == H5T_COMPOUND &&
-      H5Tget_class (complex_type_id) == H5T_COMPOUND &&
-      hdf5_types_compatible (type_id, complex_type_id) > 0)
+  // the zone map could not be updated afterwards, see update_zonemap,
+  // so nothing is written. All processes see the same attributes.
+  if (is_mpio && H5Aexists (dset_id, "zonemap") > 0)
     {
-      ComplexNDArray ret (mat_dims);
-      // macro begin
-#define HDF5_READ_DATA(type)                                            \
-      if (H5Sselect_valid (dspace_id) <= 0)                             \
-        {                                                               \
-          error ("selected dataspace is not valid");                    \
-          return octave_value_list ();                                  \
-        }                                                               \
-                                                                        \
-      int mdc_nelem = -1;                                               \
-      size_t rdcc_nelem = -1;                                           \
-      size_t rdcc_nbytes = -1;                                          \
-      double rdcc_w0 = -1;                                              \
-      if (H5Pget_cache (H5Fget_access_plist (file), &mdc_nelem,         \
-                        &rdcc_nelem, &rdcc_nbytes, &rdcc_w0 ) < 0)      \
-        {                                                               \
-          error ("could not determine raw data chunk cache parameters."); \
-          return octave_value_list ();                                  \
-        }                                                               \
-      /*cout << "cache params:" << rdcc_nelem << "," << rdcc_nbytes << endl;*/ \
-      herr_t read_result = H5Dread (dset_id,                            \
-                                    type,                               \
-                                    H5S_ALL, dspace_id,                 \
-                                    H5P_DEFAULT, ret.fortran_vec ());   \
-      if (read_result < 0)                                              \
-        {                                                               \
-          error ("error when reading dataset");                         \
-          return octave_value_list ();                                  \
-        }                                                               \
-      retval = octave_value (ret)
-      // macro end
-      
-      HDF5_READ_DATA (type_id);
+      error ("the zone map of a dataset cannot be updated by several MPI processes");
+      return;
     }
-  else if (H5Tget_class (type_id) == H5T_INTEGER)
+
+  // check if the given hyperslab settings are reasonable. On failure,
+  // the checks stop with INVALID set rather than returning, so that
+  // all processes agree on giving up under MPI.
+  bool invalid = true;
+  bool reverse = ! write_opts.c_order;
+  Matrix _stride = stride;
+  Matrix _block = block;
+  do
     {
-      switch (H5Tget_size (type_id)*8)
+      if (rank == 0 && ! (start.is_empty () && count.is_empty ()
+                          && stride.is_empty () && block.is_empty ()))
         {
-        case 64:
-          if (H5Tget_sign (type_id) == H5T_SGN_NONE)
-            {
-              uint64NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
-              break;
-            }
-          else
-            {
-              int64NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
-              break;
-            }
+          error ("Cannot specify hyperslab for scalar datasets (rank 0)");
           break;
-        case 32:
-          if (H5Tget_sign (type_id) == H5T_SGN_NONE)
-            {
-              uint32NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
-              break;
-            }
-          else
-            {
-              int32NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
-              break;
-            }
+        }
+
+      if (start.nelem () != rank)
+        {
+          error ("start must be a vector of length %d, the dataset rank", rank);
           break;
-        case 16:
-          if (H5Tget_sign (type_id) == H5T_SGN_NONE)
-            {
-              uint16NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
-              break;
-            }
-          else
-            {
-              int16NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
-              break;
-            }
+        }
+      if (count.nelem () != rank)
+        {
+          error ("count must be a vector of length %d, the dataset rank", rank);
           break;
-        case 8:
-          if (H5Tget_sign (type_id) == H5T_SGN_NONE)
+        }
+      if (nargin < 3)
+        _stride = Matrix (dim_vector(1, rank), 1);
+      if (_stride.nelem () != rank)
+        {
+          error ("stride must be a vector of length %d, the dataset rank", rank);
+          break;
+        }
+      if (nargin < 4)
+        _block = Matrix (dim_vector(1, rank), 1);
+      if (_block.nelem () != rank)
+        {
+          error ("block must be a vector of length %d, the dataset rank", rank);
+          break;
+        }
+
+      // check further for every dimension if hyperslab settings make
+      // sense. The arguments are given in the order of the file for C
+      // order, reversed otherwise.
+      double numel = 1;
+      int i;
+      for (i = 0; i < rank; i++)
+        {
+          int hdim = reverse ? rank-i-1 : i;
+          numel *= count(i) * _block(i);
+          // the stride must be at least the block size
+          if (_stride(i) < _block(i))
             {
-              uint8NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
+              error ("In dimension %d, requested stride %d smaller than block size %d",
+                     i+1, (int)_stride(i), (int)_block(i));
               break;
             }
-          else
+
+          // A count value 0 is not allowed when writing data.
+
+          int end = start(i) + _stride(i)*(count(i)-1) + _block(i); // exclusive
+          if (h5_maxdims[hdim] < end)
             {
-              int8NDArray ret (mat_dims);
-              HDF5_READ_DATA (type_id);
+              error ("In dimension %d, the dataset %s may have at max. only %d elements,"
+                     " but at least %d are required for requested hyperslab.",
+                     i+1, dsetname, (int)h5_maxdims[hdim], end);
               break;
             }
+
+          // now, the array holding the current dimension of the dataset
+          // is changed (if its necessary), so that the new extent can be
+          // set later.
+          if (h5_dims[hdim] < end)
+            h5_dims[hdim] = end;
+        }
+      if (i < rank)
+        break;
+      if (write_opts.c_order && numel != ov_data.numel ())
+        {
+          error ("the hyperslab of %s has %g elements, but the data has %d",
+                 dsetname, numel, (int)ov_data.numel ());
           break;
-        default:
-          {
-            error ("unknown integer size %d", H5Tget_size (type_id));
-            NDArray ret (mat_dims);
-            HDF5_READ_DATA (type_id);
-          }
         }
+      invalid = false;
     }
-  else
+  while (false);
+
+#ifdef H5_HAVE_PARALLEL
+  // the extent is set collectively below, so no process may go on if
+  // the hyperslab of another one is invalid
+  if (is_mpio)
     {
-      NDArray ret (mat_dims);
-      HDF5_READ_DATA (H5T_NATIVE_DOUBLE);
+      int any_invalid = invalid;
+      MPI_Allreduce (MPI_IN_PLACE, &any_invalid, 1, MPI_INT, MPI_MAX,
+                     MPI_COMM_WORLD);
+      if (any_invalid && ! invalid)
+        error ("the hyperslab of %s is invalid in another process", dsetname);
+      invalid = any_invalid;
     }
-  H5Tclose (complex_type_id);
+#endif
+  if (invalid)
+    return;
+
+  hsize_t *hstart = alloc_hsize (start, ALLOC_HSIZE_DEFAULT, reverse);
+  hsize_t *hstride = alloc_hsize (_stride, ALLOC_HSIZE_DEFAULT, reverse);
+  hsize_t *hcount = alloc_hsize (count, ALLOC_HSIZE_DEFAULT, reverse);
+  hsize_t *hblock = alloc_hsize (_block, ALLOC_HSIZE_DEFAULT, reverse);
+  // TODO check these (and hmem) for NULLs
   
-  return retval;
-}
+  // make the current size of the dataset bigger
+#ifdef H5_HAVE_PARALLEL
+  // setting the extent is collective, so with MPI-IO all processes
+  // set the largest one that any of them needs
+  if (is_mpio)
+    MPI_Allreduce (MPI_IN_PLACE, h5_dims, rank, MPI_UNSIGNED_LONG_LONG,
+                   MPI_MAX, MPI_COMM_WORLD);
+#endif
+  // only a chunked dataset can change its extent, so the extent is left
+  // alone if it does not grow
+  std::vector<hsize_t> old_dims (rank);
+  H5Sget_simple_extent_dims (dspace_id, &old_dims[0], NULL);
+  H5Sclose (dspace_id);
+  if (! std::equal (old_dims.begin (), old_dims.end (), h5_dims)
+      && H5Dset_extent (dset_id, h5_dims) < 0)
+    {
+      error ("error when setting new extent of the dataset %s", dsetname);
+      return;
+    }
+  dspace_id = H5Dget_space (dset_id);
+  if (dspace_id < 0)
+    {
+      error ("error could not get dataspace after setting new extent of %s", dsetname);
+      return;
+    }
+  herr_t sel_result;
+  {
+    H5PhaseTimer timer (H5_PHASE_SELECT);
+    sel_result = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, hstart,
+                                      hstride, hcount, hblock);
+  }
+  sel_start.assign (hstart, hstart + rank);
+  sel_stride.assign (hstride, hstride + rank);
+  sel_count.assign (hcount, hcount + rank);
+  sel_block.assign (hblock, hblock + rank);
 
-void
-H5File::write_dset (const char *dsetname,
-                    const octave_value ov_data)
-{
-  int rank = ov_data.dims ().length ();
+  free (hstart);
+  free (hstride);
+  free (hcount);
+  free (hblock);
 
-  hsize_t *dims = alloc_hsize (ov_data.dims(), ALLOC_HSIZE_DEFAULT, true);
-  dspace_id = H5Screate_simple (rank, dims, NULL);
-  free (dims);
+  if (sel_result < 0)
+    {
+      error ("error when selecting the hyperslab of dataset %s to write to", dsetname);
+      return;
+    }
 
-  // determine the endianness of this system
-  H5T_order_t o = H5Tget_order (H5T_NATIVE_INT);
-  if (o == H5T_ORDER_ERROR)
+  // A range is expanded piece by piece if the hyperslab is a line, in
+  // which the order of its elements is the same for C and F order.
+  if (ov_data.is_range () && line_dim () >= 0)
     {
-      error ("HDF5 lib could not determine endianness of current system");
+      if (write_range (ov_data.range_value (), line_dim ()) < 0)
+        error ("error when writing the dataset %s", dsetname);
+      else
+        update_zonemap (ov_data, write_opts.c_order);
       return;
     }
 
-  //check if all groups in the path dsetname exist. if not, create them
-  string path (dsetname);
-  for (int i=1; i < path.length (); i++)
+  // The data is written from the storage of the value if its elements
+  // have a native type, which the library converts to the type of the
+  // dataset. Logical values are written from their storage as well into
+  // a dataset of the enum written for them (see make_bool_type), which
+  // the library cannot convert from double. Other values (such as
+  // logical ones for other datasets, diagonal or sparse ones) are
+  // converted to double first.
+  octave_value data = ov_data;
+  hid_t mem_type = -1;
+  void *buf = NULL;
+  hid_t file_type = H5Dget_type (dset_id);
+  if (ov_data.is_bool_type () && ! ov_data.is_sparse_type ()
+      && is_bool_type (file_type))
     {
-      if (path[i] == '/')
-        {
-          if (! H5Lexists (file, path.substr(0,i).c_str (), H5P_DEFAULT))
-            {
-              hid_t group_id = H5Gcreate (file, path.substr(0,i).c_str (), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-              H5Gclose (group_id);
-            }
-        }
+      data = ov_data.bool_array_value ();
+      mem_type = mem_type_id = make_bool_type ();
+    }
+  else if (ov_data.is_real_type () && ! ov_data.is_range ()
+           && ! ov_data.is_sparse_type ())
+    mem_type = native_type_by_name (ov_data.class_name ());
+  H5Tclose (file_type);
+  if (mem_type >= 0)
+    buf = data.mex_get_data ();
+  if (buf == NULL)
+    {
+      data = ov_data.array_value ();
+      mem_type = H5T_NATIVE_DOUBLE;
+      buf = data.mex_get_data ();
     }
 
-  herr_t status;
-  // find the right type
-  if (ov_data.is_complex_type ())
+  if (write_opts.c_order && rank > 1)
     {
-      //check if the data set already exists. if it does, open it,
-      //otherwise, create it.  Furthermore check if the datatype is
-      //compliant with given octave data.
+      if (dset_io_c_order (mem_type, buf, true, false) < 0)
+        error ("error when writing the dataset %s", dsetname);
+      else
+        update_zonemap (data, true);
+      return;
+    }
   
-#define OPEN_AND_WRITE if (H5Lexists (file,dsetname,H5P_DEFAULT))       \
-        {                                                               \
-          if (open_dset (dsetname) < 0)                                 \
-            {                                                           \
-              error ("Could not open existing dataset in order to write to"); \
-              return;                                                   \
-            }                                                           \
-        }                                                               \
-      else                                                              \
-        dset_id = H5Dcreate (file, dsetname, type_id, dspace_id,        \
-                             H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);    \
-                                                                        \
-      status = H5Dwrite (dset_id, type_id,                              \
-                         H5S_ALL, H5S_ALL, H5P_DEFAULT,                 \
-                         data.fortran_vec ())
+  hsize_t *hmem = alloc_hsize (data.dims (), ALLOC_HSIZE_DEFAULT, false);
+  hid_t memspace_id = H5Screate_simple (rank, hmem, hmem);
+  if (memspace_id < 0)
+    {
+      error ("error when creating dataspace for data in memory");
+      return;
+    }
+  free (hmem);
   
-      type_id = hdf5_make_complex_type (H5T_NATIVE_DOUBLE);
-      ComplexNDArray data = ov_data.complex_array_value ();
-      OPEN_AND_WRITE;
+  herr_t status = dset_write (mem_type, memspace_id, dspace_id, buf);
+  if (status < 0)
+    {
+      error ("error when writing the dataset %s", dsetname);
+      return;
     }
-  else if (ov_data.is_integer_type ())
+
+  update_zonemap (data, false);
+}
+
+
+octave_value
+H5File::read_att (const char *objname, const char *attname)
+{
+  octave_value retval;
+  obj_id = H5Oopen (file, objname, H5P_DEFAULT);
+
+  if (obj_id < 0)
     {
-      if (ov_data.is_uint64_type ())
-        {
-          uint64NDArray data = ov_data.uint64_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U64LE : H5T_STD_U64BE);
-          OPEN_AND_WRITE;
-        }
-      else if (ov_data.is_uint32_type ())
+      error ("h5readatt: opening the given object failed");
+      return retval;
+    }
+
+  if ( !hdf5_check_attr(obj_id, attname))
+    {
+      error ("h5readatt: the object %s does not have an attribute %s", objname, attname);
+      return retval;
+    }
+
+  att_id = H5Aopen_name (obj_id, attname);
+  if (att_id < 0)
+    {
+      error ("h5readatt: opening the given attribute failed");
+      return retval;
+    }
+
+  type_id = H5Aget_type (att_id);
+  if (type_id < 0)
+    {
+      error ("h5readatt: dataset type error");
+      return retval;
+    }
+
+  if (H5Tget_class (type_id)==H5T_STRING)
+    {
+      // Size of each string:
+      size_t size = H5Tget_size (type_id);
+      // to read an array of strings (for future work): 
+      //totsize = size*sdim[0]*sdim[1];
+      // to read a single string (plus a terminating null in case the
+      // string was written with H5T_STR_NULLPAD):
+      size_t totsize = size + 1;
+      // Set up read buffer for attribute
+      char* buf = (char*)calloc (totsize, sizeof (char));
+      if (H5Aread (att_id, type_id, buf)<0)
         {
-          uint32NDArray data = ov_data.uint32_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U32LE : H5T_STD_U32BE);
-          OPEN_AND_WRITE;
+          free (buf);
+          error ("h5readatt: reading the given string Attribute failed");
+          return retval;
         }
-      else if (ov_data.is_uint16_type ())
+      retval = octave_value (buf);
+      free (buf);
+    }
+  else if (H5Tget_class (type_id)==H5T_INTEGER
+           || H5Tget_class (type_id) == H5T_FLOAT)
+    {
+      // Numeric attributes may be scalars or arrays of any rank. They
+      // are read into an Octave array of the matching type.
+      dspace_id = H5Aget_space (att_id);
+      int att_rank = H5Sget_simple_extent_ndims (dspace_id);
+      if (att_rank < 0)
         {
-          uint16NDArray data = ov_data.uint16_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U16LE : H5T_STD_U16BE);
-          OPEN_AND_WRITE;
+          error ("h5readatt: reading the extent of the given attribute failed");
+          return retval;
         }
-      else if (ov_data.is_uint8_type ())
+      hsize_t *att_dims = (hsize_t*)malloc (max (att_rank, 1) * sizeof (hsize_t));
+      if (H5Sget_simple_extent_dims (dspace_id, att_dims, NULL) < 0)
         {
-          uint8NDArray data = ov_data.uint8_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_U8LE : H5T_STD_U8BE);
-          OPEN_AND_WRITE;
+          free (att_dims);
+          error ("h5readatt: reading the extent of the given attribute failed");
+          return retval;
         }
-      else if (ov_data.is_int64_type ())
+
+      // .resize(1) still leaves mat_dims with a length of 2 for some reason, so
+      // we need at least 2 filled
+      mat_dims.resize (max (att_rank, 2));
+      mat_dims(0) = mat_dims(1) = 1;
+      for (int i = 0; i < att_rank; i++)
+        //note that this is reversing the order
+        mat_dims(i) = att_dims[att_rank-i-1];
+      free (att_dims);
+
+      void *buf;
+      retval = alloc_numeric_array (type_id, mat_dims, &buf, &mem_type_id);
+      if (retval.is_undefined ())
         {
-          int64NDArray data = ov_data.int64_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I64LE : H5T_STD_I64BE);
-          OPEN_AND_WRITE;
+          error ("h5readatt: reading the given numeric Attribute failed: \
+cannot handle size of type");
+          return retval;
         }
-      else if (ov_data.is_int32_type ())
+      herr_t read_result;
+      {
+        H5PhaseTimer timer (H5_PHASE_IO);
+        read_result = H5Aread (att_id, mem_type_id, buf);
+      }
+      h5stats_transfer (mem_type_id, type_id, mat_dims.numel (), false);
+      if (read_result < 0)
         {
-          int32NDArray data = ov_data.int32_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I32LE : H5T_STD_I32BE);
-          OPEN_AND_WRITE;
+          error ("h5readatt: reading the given numeric Attribute failed");
+          return octave_value ();
         }
-      else if (ov_data.is_int16_type ())
+      retval.maybe_mutate ();
+    }
+  else //none of the supported data types
+    {
+      error ("h5readatt: attribute type not supported");
+      return retval;
+    }
+  
+  return retval;
+}
+
+void
+H5File::write_att (const char *location, const char *attname,
+                   const octave_value& attvalue)
+{
+  if (attvalue.is_string ())
+    {
+      if (attvalue.rows () > 1)
         {
-          int16NDArray data = ov_data.int16_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I16LE : H5T_STD_I16BE);
-          OPEN_AND_WRITE;
+          error ("only single line string attributes are supported.");
+          return;
         }
-      else if (ov_data.is_int8_type ())
+      dspace_id = H5Screate (H5S_SCALAR);
+    }
+  else if (attvalue.is_scalar_type ())
+    dspace_id = H5Screate (H5S_SCALAR);
+  else if (attvalue.is_matrix_type () || attvalue.is_range ())
+    {
+      hsize_t *dims = alloc_hsize (attvalue.dims (), ALLOC_HSIZE_DEFAULT, true);
+      dspace_id = H5Screate_simple (attvalue.dims ().length (), dims, NULL);
+      free (dims);
+    }
+  else
+    {
+      error ("Only scalar, matrix and string attributes are supported at the moment.");
+      return;
+    }
+
+  //H5Lexists returns false for the root group '/'
+  if (strcmp (location,"/")!=0 && ! H5Lexists (file, location, H5P_DEFAULT))
+    {
+      error ("the specified HDF5 object %s does not exist", location);
+      return;
+    }
+  obj_id = H5Oopen (file, location, H5P_DEFAULT);
+  if (obj_id < 0)
+    {
+      error ("the specified HDF5 object %s could not be opened", location);
+      return;
+    }
+  
+  //Check if an attribute with the given name exists already at that
+  //object and if yes delete it.
+  htri_t exists = H5Aexists (obj_id, attname);
+  if (exists > 0)
+    {
+      if (H5Adelete (obj_id, attname) < 0)
         {
-          int8NDArray data = ov_data.int8_array_value ();
-          type_id = H5Tcopy (o == H5T_ORDER_LE ? H5T_STD_I8LE : H5T_STD_I8BE);
-          OPEN_AND_WRITE;
+          error ("could not delete existing attribute %s at %s", attname, location);
+          return;
         }
+    }
+  else if (exists < 0)
+    {
+      error ("could not check if attribute %s exists at %s", attname, location);
+      return;
+    }
+
+  herr_t status;
+
+  // create the attribute with the HDF5 type matching the Octave type
+  // and write the data straight from the array holding it.
+#define CREATE_AND_WRITE_ATT(arraytype, valuefcn, native)               \
+  {                                                                     \
+    arraytype data = attvalue.valuefcn ();                              \
+    type_id = H5Tcopy (native);                                         \
+    mem_type_id = H5Tcopy (native);                                     \
+    att_id = H5Acreate (obj_id, attname, type_id,                       \
+                        dspace_id, H5P_DEFAULT, H5P_DEFAULT);           \
+    H5PhaseTimer timer (H5_PHASE_IO);                                   \
+    status = H5Awrite (att_id, mem_type_id, data.data ());              \
+    h5stats_transfer (mem_type_id, type_id, data.numel (), true);       \
+  }
+
+  if (attvalue.is_string ())
+    {
+      string str = attvalue.string_value ();
+      type_id = H5Tcopy (H5T_C_S1);
+      H5Tset_size (type_id, max (str.length (), (size_t)1));
+      H5Tset_strpad (type_id,H5T_STR_NULLTERM);
+      mem_type_id = H5Tcopy (type_id);
+
+      att_id = H5Acreate (obj_id, attname, type_id,
+                          dspace_id, H5P_DEFAULT, H5P_DEFAULT);
+      status = H5Awrite (att_id, mem_type_id, str.c_str ());
+    }
+  else if (attvalue.is_integer_type ())
+    {
+      if (attvalue.is_uint64_type ())
+        CREATE_AND_WRITE_ATT (uint64NDArray, uint64_array_value, H5T_NATIVE_UINT64)
+      else if (attvalue.is_uint32_type ())
+        CREATE_AND_WRITE_ATT (uint32NDArray, uint32_array_value, H5T_NATIVE_UINT32)
+      else if (attvalue.is_uint16_type ())
+        CREATE_AND_WRITE_ATT (uint16NDArray, uint16_array_value, H5T_NATIVE_UINT16)
+      else if (attvalue.is_uint8_type ())
+        CREATE_AND_WRITE_ATT (uint8NDArray, uint8_array_value, H5T_NATIVE_UINT8)
+      else if (attvalue.is_int64_type ())
+        CREATE_AND_WRITE_ATT (int64NDArray, int64_array_value, H5T_NATIVE_INT64)
+      else if (attvalue.is_int32_type ())
+        CREATE_AND_WRITE_ATT (int32NDArray, int32_array_value, H5T_NATIVE_INT32)
+      else if (attvalue.is_int16_type ())
+        CREATE_AND_WRITE_ATT (int16NDArray, int16_array_value, H5T_NATIVE_INT16)
       else
-        {
-          uint64NDArray data = ov_data.uint64_array_value ();
-          type_id = H5Tcopy (H5T_NATIVE_INT);
-          OPEN_AND_WRITE;
-        }
-      
+        CREATE_AND_WRITE_ATT (int8NDArray, int8_array_value, H5T_NATIVE_INT8)
     }
-  else if (ov_data.is_single_type ())
+  else if (attvalue.is_single_type () && attvalue.is_real_type ())
+    CREATE_AND_WRITE_ATT (FloatNDArray, float_array_value, H5T_NATIVE_FLOAT)
+  else if (attvalue.is_real_type ())
+    CREATE_AND_WRITE_ATT (NDArray, array_value, H5T_NATIVE_DOUBLE)
+  else if (attvalue.is_complex_type ())
     {
-      FloatNDArray data = ov_data.float_array_value ();
-      type_id = H5Tcopy (H5T_NATIVE_FLOAT);
-      OPEN_AND_WRITE;
+      error ("complex values are not supported by the HDF5 format. \
+You have to save real and imag part separately.");
+      return;
     }
   else
     {
-      NDArray data = ov_data.array_value ();
-      type_id = H5Tcopy (H5T_NATIVE_DOUBLE);
-      OPEN_AND_WRITE;
+      error ("this variable type is not supported");
+      return;
     }
 
   if (status < 0)
     {
-      error ("error when writing the dataset %s", dsetname);
+      error ("error when writing the attribute %s at %s", attname, location);
       return;
     }
-
 }
 
+
 void
-H5File::write_dset_hyperslab (const char *dsetname,
-                              const octave_value ov_data,
-                              const Matrix& start, const Matrix& count,
-                              const Matrix& stride, const Matrix& block,
-                              int nargin)
+H5File::append_table (const char *location, const octave_scalar_map& columns,
+                      hsize_t chunkrows)
 {
-  NDArray data = ov_data.array_value ();
-
-  if (open_dset (dsetname) < 0)
-    return;
-
-  // check if the given hyperslab settings are reasonable
-  if (rank == 0 && ! (start.is_empty () && count.is_empty ()
-                      && stride.is_empty () && block.is_empty ()))
+  string_vector names = columns.fieldnames ();
+  int ncols = names.numel ();
+  if (ncols == 0)
     {
-      error ("Cannot specify hyperslab for scalar datasets (rank 0)");
+      error ("the table has no columns");
       return;
     }
 
-  if (start.nelem () != rank)
-    {
-      error ("start must be a vector of length %d, the dataset rank", rank);
-      return;
-    }
-  if (count.nelem () != rank)
+  // collect the columns and lay them out in a packed record
+  std::vector<octave_value> hold (ncols);
+  std::vector<const void*> data (ncols);
+  std::vector<hid_t> types (ncols);
+  std::vector<size_t> offset (ncols);
+  std::vector<size_t> size (ncols);
+  size_t recsize = 0;
+  hsize_t nrows = columns.contents (names[0]).numel ();
+  for (int k = 0; k < ncols; k++)
     {
-      error ("count must be a vector of length %d, the dataset rank", rank);
-      return;
+      octave_value column = columns.contents (names[k]);
+      if (column.numel () != nrows)
+        {
+          error ("column %s has %d elements, but column %s has %d",
+                 names[k].c_str (), (int)column.numel (),
+                 names[0].c_str (), (int)nrows);
+          return;
+        }
+      data[k] = numeric_array_data (column, hold[k], &types[k]);
+      if (data[k] == NULL)
+        {
+          for (int j = 0; j < k; j++)
+            H5Tclose (types[j]);
+          error ("column %s must be a real numeric or logical array",
+                 names[k].c_str ());
+          return;
+        }
+      offset[k] = recsize;
+      size[k] = H5Tget_size (types[k]);
+      recsize += size[k];
     }
-  Matrix _stride = stride;
-  if (nargin < 3)
-    _stride = Matrix (dim_vector(1, rank), 1);
-  if (_stride.nelem () != rank)
+
+  mem_type_id = H5Tcreate (H5T_COMPOUND, recsize);
+  for (int k = 0; k < ncols; k++)
     {
-      error ("stride must be a vector of length %d, the dataset rank", rank);
-      return;
+      H5Tinsert (mem_type_id, names[k].c_str (), offset[k], types[k]);
+      H5Tclose (types[k]);
     }
-  Matrix _block = block;
-  if (nargin < 4)
-    _block = Matrix (dim_vector(1, rank), 1);
-  if (_block.nelem () != rank)
+
+  // Fill the records block by block, so that each block stays in the
+  // cache while all of its columns are copied into it.
+  const hsize_t PACK_BLOCK = 4096;
+  std::vector<char> buf (max (nrows * recsize, (hsize_t)1));
+  for (hsize_t begin = 0; begin < nrows; begin += PACK_BLOCK)
     {
-      error ("block must be a vector of length %d, the dataset rank", rank);
-      return;
+      hsize_t end = min (begin + PACK_BLOCK, nrows);
+      char *block = &buf[begin * recsize];
+      for (int k = 0; k < ncols; k++)
+        {
+          switch (size[k])
+            {
+            case 8:
+              pack_member<uint64_t> (block, recsize, offset[k], data[k], begin, end);
+              break;
+            case 4:
+              pack_member<uint32_t> (block, recsize, offset[k], data[k], begin, end);
+              break;
+            case 2:
+              pack_member<uint16_t> (block, recsize, offset[k], data[k], begin, end);
+              break;
+            default:
+              pack_member<uint8_t> (block, recsize, offset[k], data[k], begin, end);
+            }
+        }
     }
 
-  // check further for every dimension if hyperslab settings make sense.
-  for (int i = 0; i < rank; i++)
+  if (! H5Lexists (file, location, H5P_DEFAULT))
     {
-      // the stride must be at least the block size
-      if (_stride(i) < _block(i))
+      // an empty table with unlimited extent, made of the given columns
+      hsize_t dims = 0;
+      hsize_t maxdims = H5S_UNLIMITED;
+      dspace_id = H5Screate_simple (1, &dims, &maxdims);
+
+      if (chunkrows == 0)
+        chunkrows = get_auto_chunksize (Matrix (1, 1, octave_Inf), recsize)(0);
+
+      hid_t lcpl = H5Pcreate (H5P_LINK_CREATE);
+      H5Pset_create_intermediate_group (lcpl, 1);
+      hid_t crp_list = H5Pcreate (H5P_DATASET_CREATE);
+      set_attr_storage (crp_list);
+      H5Pset_chunk (crp_list, 1, &chunkrows);
+      hid_t table_id = H5Dcreate (file, location, mem_type_id, dspace_id,
+                                  lcpl, crp_list, H5P_DEFAULT);
+      H5Pclose (crp_list);
+      H5Pclose (lcpl);
+      H5Sclose (dspace_id);
+      if (table_id < 0)
         {
-          error ("In dimension %d, requested stride %d smaller than block size %d",
-                 i+1, (int)_stride(i), (int)_block(i));
+          error ("Could not create dataset %s", location);
           return;
         }
+      H5Dclose (table_id);
+    }
 
-      // A count value 0 is not allowed when writing data.
+  if (open_dset (location) < 0)
+    return;
 
-      int end = start(i) + _stride(i)*(count(i)-1) + _block(i); // exclusive
-      if (h5_maxdims[rank-i-1] < end)
+  type_id = H5Dget_type (dset_id);
+  if (rank != 1 || H5Tget_class (type_id) != H5T_COMPOUND)
+    {
+      error ("%s is not a one dimensional compound dataset", location);
+      return;
+    }
+  for (int k = 0; k < ncols; k++)
+    {
+      if (H5Tget_member_index (type_id, names[k].c_str ()) < 0)
         {
-          error ("In dimension %d, the dataset %s may have at max. only %d elements,"
-                 " but at least %d are required for requested hyperslab.",
-                 i+1, dsetname, (int)h5_maxdims[rank-i-1], end);
+          error ("the dataset %s has no member %s", location, names[k].c_str ());
           return;
         }
-
-      // now, the array holding the current dimension of the dataset
-      // is changed (if its necessary), so that the new extent can be
-      // set later.
-      if (h5_dims[rank-i-1] < end)
-        h5_dims[rank-i-1] = end;
     }
-  hsize_t *hstart = alloc_hsize (start, ALLOC_HSIZE_DEFAULT, true);
-  hsize_t *hstride = alloc_hsize (_stride, ALLOC_HSIZE_DEFAULT, true);
-  hsize_t *hcount = alloc_hsize (count, ALLOC_HSIZE_DEFAULT, true);
-  hsize_t *hblock = alloc_hsize (_block, ALLOC_HSIZE_DEFAULT, true);
-  // TODO check these (and hmem) for NULLs
-  
-  // make the current size of the dataset bigger
+
+  if (nrows == 0)
+    return;
+
+  // make room for the new rows and write all of them at once
+  hsize_t start = h5_dims[0];
+  hsize_t newsize = start + nrows;
   H5Sclose (dspace_id);
-  if (H5Dset_extent (dset_id, h5_dims) < 0)
+  if (H5Dset_extent (dset_id, &newsize) < 0)
     {
-      error ("error when setting new extent of the dataset %s", dsetname);
+      error ("error when setting new extent of the dataset %s", location);
       return;
     }
   dspace_id = H5Dget_space (dset_id);
-  if (dspace_id < 0)
+  herr_t sel_result;
+  {
+    H5PhaseTimer timer (H5_PHASE_SELECT);
+    sel_result = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, &start, NULL,
+                                      &nrows, NULL);
+  }
+  if (sel_result < 0)
     {
-      error ("error could not get dataspace after setting new extent of %s", dsetname);
+      error ("error when selecting the rows of dataset %s to write to", location);
       return;
     }
-  herr_t sel_result = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, hstart,
-                                           hstride, hcount, hblock);
-
-  free (hstart);
-  free (hstride);
-  free (hcount);
-  free (hblock);
+  memspace_id = H5Screate_simple (1, &nrows, NULL);
 
-  if (sel_result < 0)
+  herr_t status = dset_write (mem_type_id, memspace_id, dspace_id, &buf[0]);
+  if (status < 0)
     {
-      error ("error when selecting the hyperslab of dataset %s to write to", dsetname);
+      error ("error when writing the dataset %s", location);
       return;
     }
-  
-  hsize_t *hmem = alloc_hsize (data.dims (), ALLOC_HSIZE_DEFAULT, false);
-  hid_t memspace_id = H5Screate_simple (rank, hmem, hmem);
-  if (memspace_id < 0)
+}
+
+octave_value
+H5File::reduce_dset (const char *dsetname, const Matrix& blockshape,
+                     const string& op)
+{
+  if (open_dset (dsetname) < 0)
+    return octave_value ();
+
+  type_id = H5Dget_type (dset_id);
+  if (H5Tget_class (type_id) != H5T_INTEGER
+      && H5Tget_class (type_id) != H5T_FLOAT)
     {
-      error ("error when creating dataspace for data in memory");
-      return;
+      error ("only integer and floating point datasets can be reduced");
+      return octave_value ();
     }
-  free (hmem);
-  
-  herr_t status = H5Dwrite (dset_id, H5T_NATIVE_DOUBLE,
-                            memspace_id, dspace_id, H5P_DEFAULT,
-                            data.fortran_vec ());
-  if (status < 0)
+
+  // A scalar dataset is its own reduction.
+  if (rank == 0)
     {
-      error ("error when writing the dataset %s", dsetname);
-      return;
+      double val;
+      if (dset_read (H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, &val) < 0)
+        {
+          error ("error when reading dataset");
+          return octave_value ();
+        }
+      return octave_value (val);
+    }
+
+  if (blockshape.nelem () != rank && blockshape.nelem () != 1)
+    {
+      error ("blockshape must be a scalar or a vector of length %d, the dataset rank",
+             rank);
+      return octave_value ();
+    }
+
+  // block sizes and number of blocks in the order of the file, and
+  // the (row major) strides of the reduced array
+  std::vector<hsize_t> block (rank), nblocks (rank), ostride (rank);
+  for (int i = 0; i < rank; i++)
+    block[i] = blockshape (blockshape.nelem () == 1 ? 0 : rank-i-1);
+  hsize_t nout = 1;
+  for (int i = rank-1; i >= 0; i--)
+    {
+      nblocks[i] = (h5_dims[i] + block[i] - 1) / block[i];
+      ostride[i] = nout;
+      nout *= nblocks[i];
+    }
+
+  // The dataset is read in slabs of whole block rows.
+  hsize_t rowsize = 1;
+  for (int i = 1; i < rank; i++)
+    rowsize *= h5_dims[i];
+  hsize_t slabrows = stream_slab_rows (block[0], sizeof (double));
+
+  bool is_sum = (op == "sum" || op == "mean");
+  bool is_min = (op == "min");
+  std::vector<double> acc (nout, is_sum ? 0 : octave_NaN);
+  std::vector<double> buf (max (slabrows * rowsize, (hsize_t)1));
+  std::vector<hsize_t> start (rank, 0), count (h5_dims, h5_dims + rank);
+  std::vector<hsize_t> idx (rank, 0);
+
+  for (hsize_t r0 = 0; r0 < h5_dims[0]; r0 += slabrows)
+    {
+      start[0] = r0;
+      count[0] = min (slabrows, h5_dims[0] - r0);
+      herr_t status;
+      {
+        H5PhaseTimer timer (H5_PHASE_SELECT);
+        status = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, &start[0],
+                                      NULL, &count[0], NULL);
+      }
+      hsize_t npoints = count[0] * rowsize;
+      hid_t mem_space = H5Screate_simple (1, &npoints, NULL);
+      if (status >= 0)
+        status = dset_read (H5T_NATIVE_DOUBLE, mem_space, dspace_id, &buf[0]);
+      H5Sclose (mem_space);
+      if (status < 0)
+        {
+          error ("error when reading dataset %s", dsetname);
+          return octave_value ();
+        }
+
+      // Walk through the slab one row along the last dimension at a
+      // time; IDX holds the other indices, relative to the slab.
+      int last = rank-1;
+      hsize_t nlast = (rank == 1 ? count[0] : h5_dims[last]);
+      hsize_t first_last = (rank == 1 ? r0 : 0);
+      hsize_t nrows = npoints / max (nlast, (hsize_t)1);
+      std::fill (idx.begin (), idx.end (), 0);
+      for (hsize_t row = 0; row < nrows; row++)
+        {
+          hsize_t base = 0;
+          for (int k = 0; k < last; k++)
+            base += (idx[k] + (k == 0 ? r0 : 0)) / block[k] * ostride[k];
+          double *out = &acc[base];
+          const double *p = &buf[row * nlast];
+          if (is_sum)
+            for (hsize_t j = 0; j < nlast; j++)
+              out[(first_last + j) / block[last]] += p[j];
+          else if (is_min)
+            for (hsize_t j = 0; j < nlast; j++)
+              {
+                double& a = out[(first_last + j) / block[last]];
+                if (p[j] < a || xisnan (a))
+                  a = p[j];
+              }
+          else
+            for (hsize_t j = 0; j < nlast; j++)
+              {
+                double& a = out[(first_last + j) / block[last]];
+                if (p[j] > a || xisnan (a))
+                  a = p[j];
+              }
+
+          for (int k = last-1; k >= 0; k--)
+            {
+              if (++idx[k] < (k == 0 ? count[0] : h5_dims[k]))
+                break;
+              idx[k] = 0;
+            }
+        }
+    }
+
+  if (op == "mean")
+    {
+      // the number of elements of each block, smaller at the upper ends
+      std::fill (idx.begin (), idx.end (), 0);
+      for (hsize_t i = 0; i < nout; i++)
+        {
+          double n = 1;
+          for (int k = 0; k < rank; k++)
+            n *= min (block[k], h5_dims[k] - idx[k]*block[k]);
+          acc[i] /= n;
+          for (int k = rank-1; k >= 0; k--)
+            {
+              if (++idx[k] < nblocks[k])
+                break;
+              idx[k] = 0;
+            }
+        }
     }
-  
-}
 
+  // The reduced array in row major order with the dimensions of the
+  // file is Octave's column major array with reversed dimensions.
+  dim_vector dv;
+  dv.resize (max (rank, 2));
+  dv(0) = dv(1) = 1;
+  for (int i = 0; i < rank; i++)
+    dv(i) = nblocks[rank-i-1];
+  NDArray ret (dv);
+  std::copy (acc.begin (), acc.end (), ret.fortran_vec ());
+  return octave_value (ret);
+}
 
 octave_value
-H5File::read_att (const char *objname, const char *attname)
+H5File::stat_dset (const char *dsetname, const Matrix& dims,
+                   const Matrix& edges)
 {
-  octave_value retval;
-  obj_id = H5Oopen (file, objname, H5P_DEFAULT);
+  if (open_dset (dsetname) < 0)
+    return octave_value ();
 
-  if (obj_id < 0)
+  type_id = H5Dget_type (dset_id);
+  bool is_unsigned = (H5Tget_sign (type_id) == H5T_SGN_NONE);
+  size_t size = H5Tget_size (type_id);
+  std::vector<double> e (edges.data (), edges.data () + edges.numel ());
+
+  // the reduced dimensions, in the order of the file
+  std::vector<bool> reduced (max (rank, 1), dims.is_empty ());
+  for (octave_idx_type i = 0; i < dims.numel (); i++)
     {
-      error ("h5readatt: opening the given object failed");
-      return retval;
+      if (dims(i) > rank)
+        {
+          error ("DIMS can only contain dimensions up to %d, the dataset rank",
+                 rank);
+          return octave_value ();
+        }
+      reduced[rank - (int)dims(i)] = true;
     }
 
-  if ( !hdf5_check_attr(obj_id, attname))
+  if (H5Tget_class (type_id) == H5T_FLOAT)
     {
-      error ("h5readatt: the object %s does not have an attribute %s", objname, attname);
-      return retval;
+      if (size == sizeof (float))
+        return stat_dset_typed<float> (H5T_NATIVE_FLOAT, reduced, e);
+      else if (size == sizeof (double))
+        return stat_dset_typed<double> (H5T_NATIVE_DOUBLE, reduced, e);
+    }
+  else if (H5Tget_class (type_id) == H5T_INTEGER)
+    {
+      switch (size*8)
+        {
+        case 64:
+          if (is_unsigned)
+            return stat_dset_typed<uint64_t> (H5T_NATIVE_UINT64, reduced, e);
+          return stat_dset_typed<int64_t> (H5T_NATIVE_INT64, reduced, e);
+        case 32:
+          if (is_unsigned)
+            return stat_dset_typed<uint32_t> (H5T_NATIVE_UINT32, reduced, e);
+          return stat_dset_typed<int32_t> (H5T_NATIVE_INT32, reduced, e);
+        case 16:
+          if (is_unsigned)
+            return stat_dset_typed<uint16_t> (H5T_NATIVE_UINT16, reduced, e);
+          return stat_dset_typed<int16_t> (H5T_NATIVE_INT16, reduced, e);
+        case 8:
+          if (is_unsigned)
+            return stat_dset_typed<uint8_t> (H5T_NATIVE_UINT8, reduced, e);
+          return stat_dset_typed<int8_t> (H5T_NATIVE_INT8, reduced, e);
+        }
     }
 
-  att_id = H5Aopen_name (obj_id, attname);
-  if (att_id < 0)
+  error ("only integer and floating point datasets are supported");
+  return octave_value ();
+}
+
+template <typename T>
+octave_value
+H5File::stat_dset_typed (hid_t native, const std::vector<bool>& reduced,
+                         const std::vector<double>& edges)
+{
+  // A scalar dataset is treated like a vector of one element.
+  bool is_scalar = (rank == 0);
+  hsize_t scalar_dims = 1;
+  int r = max (rank, 1);
+  const hsize_t *fdims = is_scalar ? &scalar_dims : h5_dims;
+
+  // (row major) strides of the accumulators, 0 along reduced dimensions
+  std::vector<hsize_t> ostride (r);
+  hsize_t nout = 1;
+  for (int i = r-1; i >= 0; i--)
     {
-      error ("h5readatt: opening the given attribute failed");
-      return retval;
+      ostride[i] = reduced[i] ? 0 : nout;
+      nout *= reduced[i] ? 1 : fdims[i];
     }
 
-  hid_t type = H5Aget_type (att_id);
-  if (type < 0)
+  hsize_t rowsize = 1;
+  for (int i = 1; i < r; i++)
+    rowsize *= fdims[i];
+  // an empty dataset (e.g. an extendible one not written yet) still
+  // has one set of empty accumulators
+  hsize_t slabrows = is_scalar ? 1 : stream_slab_rows (1, sizeof (T));
+  slabrows = max (slabrows, (hsize_t)1);
+  std::vector<T> buf (max (slabrows * rowsize, (hsize_t)1));
+  std::vector<hsize_t> start (r, 0), count (fdims, fdims + r);
+
+  // each thread has its own accumulators, merged at the end
+  hsize_t maxthreads = max (worker_count (slabrows * rowsize, slabrows),
+                            (hsize_t)1);
+  std::vector<std::vector<H5StatAccum<T> > > acc
+    (maxthreads, std::vector<H5StatAccum<T> > (nout));
+
+  for (hsize_t r0 = 0; r0 < fdims[0]; r0 += slabrows)
     {
-      error ("h5readatt: dataset type error");
-      return retval;
+      start[0] = r0;
+      count[0] = min (slabrows, fdims[0] - r0);
+      hsize_t npoints = count[0] * rowsize;
+      herr_t status;
+      if (is_scalar)
+        status = dset_read (native, H5S_ALL, H5S_ALL, &buf[0]);
+      else
+        {
+          {
+            H5PhaseTimer timer (H5_PHASE_SELECT);
+            status = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET,
+                                          &start[0], NULL, &count[0], NULL);
+          }
+          hid_t mem_space = H5Screate_simple (1, &npoints, NULL);
+          if (status >= 0)
+            status = dset_read (native, mem_space, dspace_id, &buf[0]);
+          H5Sclose (mem_space);
+        }
+      if (status < 0)
+        {
+          error ("error when reading dataset");
+          return octave_value ();
+        }
+
+      hsize_t nlast = (r == 1 ? count[0] : fdims[r-1]);
+      hsize_t nrows = npoints / max (nlast, (hsize_t)1);
+      hsize_t nthreads = min (worker_count (npoints, maxthreads), nrows);
+      hsize_t per_thread = (nrows + nthreads - 1) / max (nthreads, (hsize_t)1);
+      std::vector<std::thread> workers;
+      for (hsize_t t = 1; t < nthreads; t++)
+        {
+          hsize_t first = t * per_thread;
+          if (first < nrows)
+            workers.push_back (std::thread (stat_rows<T>, &buf[0], first,
+                                            min (per_thread, nrows - first),
+                                            nlast, r0, std::cref (count),
+                                            std::cref (ostride),
+                                            std::cref (edges), &acc[t]));
+        }
+      stat_rows<T> (&buf[0], 0, min (per_thread, nrows), nlast, r0, count,
+                    ostride, edges, &acc[0]);
+      for (size_t t = 0; t < workers.size (); t++)
+        workers[t].join ();
     }
 
-  size_t numVal = H5Aget_storage_size (att_id)/H5Tget_size (type);
-  if (H5Tget_class (type)==H5T_STRING)
+  for (hsize_t t = 1; t < maxthreads; t++)
+    for (hsize_t i = 0; i < nout; i++)
+      acc[0][i].merge (acc[t][i]);
+
+  // The accumulators are in row major order with the dimensions of the
+  // file, i.e. in Octave's order with reversed dimensions.
+  dim_vector dv;
+  dv.resize (max (r, 2));
+  dv(0) = dv(1) = 1;
+  for (int i = 0; i < r; i++)
+    dv(i) = reduced[r-i-1] ? 1 : fdims[r-i-1];
+
+  NDArray n (dv), nan (dv), mean (dv), sd (dv);
+  void *min_data, *max_data;
+  hid_t min_type, max_type;
+  octave_value min_val = alloc_numeric_array (native, dv, &min_data, &min_type);
+  octave_value max_val = alloc_numeric_array (native, dv, &max_data, &max_type);
+  H5Tclose (min_type);
+  H5Tclose (max_type);
+  T empty = std::numeric_limits<T>::has_quiet_NaN
+            ? std::numeric_limits<T>::quiet_NaN () : T ();
+  for (hsize_t i = 0; i < nout; i++)
     {
-      // Size of each string:
-      size_t size = H5Tget_size (type);
-      // to read an array of strings (for future work): 
-      //totsize = size*sdim[0]*sdim[1];
-      // to read a single string:
-      size_t totsize = size;
-      // Set up read buffer for attribute
-      char* buf = (char*)calloc (totsize, sizeof (char));
-      if (H5Aread (att_id, type, buf)<0)
+      const H5StatAccum<T>& a = acc[0][i];
+      n(i) = a.n;
+      nan(i) = a.nan;
+      mean(i) = a.n > 0 ? a.mean : octave_NaN;
+      sd(i) = a.n > 1 ? sqrt (a.m2 / (a.n - 1)) : (a.n == 1 ? 0 : octave_NaN);
+      ((T*)min_data)[i] = a.n > 0 ? a.min : empty;
+      ((T*)max_data)[i] = a.n > 0 ? a.max : empty;
+    }
+  min_val.maybe_mutate ();
+  max_val.maybe_mutate ();
+
+  octave_scalar_map retval;
+  retval.assign ("count", n);
+  retval.assign ("nan_count", nan);
+  retval.assign ("min", min_val);
+  retval.assign ("max", max_val);
+  retval.assign ("mean", mean);
+  retval.assign ("std", sd);
+  if (! edges.empty ())
+    {
+      // one more trailing dimension for the bins; a row vector for the
+      // statistics of the whole dataset
+      hsize_t nbins = edges.size ();
+      dim_vector hv = dv;
+      if (nout == 1)
+        hv = dim_vector (1, nbins);
+      else
         {
-          error ("h5readatt: reading the given string Attribute failed");
-          return retval;
+          hv.resize (dv.length () + 1);
+          hv(dv.length ()) = nbins;
         }
-      retval = octave_value (buf);
+      NDArray hist (hv, 0);
+      for (hsize_t k = 0; k < nbins; k++)
+        for (hsize_t i = 0; i < nout; i++)
+          if (k < acc[0][i].hist.size ())
+            hist(k*nout + i) = acc[0][i].hist[k];
+      retval.assign ("histogram", hist);
     }
-  else if (H5Tget_class (type)==H5T_INTEGER)
+  return octave_value (retval);
+}
+
+// Return the number of rows along the first dimension of the open
+// dataset which are read at a time when streaming it with elements of
+// ELSIZE bytes: a multiple of MULTIPLE, covering at least one row of
+// chunks if the dataset is chunked, and limited to about
+// STREAM_SLAB_BYTES.
+hsize_t
+H5File::stream_slab_rows (hsize_t multiple, size_t elsize)
+{
+  hsize_t rowsize = 1;
+  for (int i = 1; i < rank; i++)
+    rowsize *= h5_dims[i];
+  hsize_t rows = multiple;
+  hid_t dcpl = H5Dget_create_plist (dset_id);
+  if (H5Pget_layout (dcpl) == H5D_CHUNKED)
     {
-      // Integer attributes are casted to floating point octave values
-    
-      double value[numVal];
-      if (H5Tget_size (type)==sizeof (int))
+      std::vector<hsize_t> chunk (rank);
+      H5Pget_chunk (dcpl, rank, &chunk[0]);
+      rows = (chunk[0] + multiple - 1) / multiple * multiple;
+    }
+  H5Pclose (dcpl);
+  hsize_t maxrows = STREAM_SLAB_BYTES / (max (rowsize, (hsize_t)1) * elsize);
+  if (rows > maxrows)
+    rows = max (maxrows / multiple, (hsize_t)1) * multiple;
+  return min (rows, h5_dims[0]);
+}
+
+void
+H5File::copy_object (const char *srcpath, H5File& dst, const char *dstpath,
+                     const Matrix& start, const Matrix& count)
+{
+  hid_t lcpl = H5Pcreate (H5P_LINK_CREATE);
+  H5Pset_create_intermediate_group (lcpl, 1);
+  if (H5Lexists (dst.file, dstpath, H5P_DEFAULT) > 0)
+    {
+      H5Pclose (lcpl);
+      error ("the destination %s exists already", dstpath);
+      return;
+    }
+
+  if (start.is_empty ())
+    {
+      // whole objects, with their attributes and everything below them,
+      // and the zone maps of datasets
+      herr_t status;
+      {
+        H5PhaseTimer timer (H5_PHASE_IO);
+        status = H5Ocopy (file, srcpath, dst.file, dstpath, H5P_DEFAULT, lcpl);
+      }
+      // Each copied dataset with a zone map, the object itself or one
+      // in a copied group, gets a zone map next to it. The zone maps of
+      // datasets in a group are usually copied with it already.
+      std::vector<string> zoned;
+      if (status >= 0)
+        {
+          hid_t out = H5Oopen (dst.file, dstpath, H5P_DEFAULT);
+          status = (out < 0 ? -1
+                    : H5Ovisit (out, H5_INDEX_NAME, H5_ITER_INC,
+                                collect_zonemapped, &zoned));
+          if (out >= 0)
+            H5Oclose (out);
+        }
+      for (size_t i = 0; i < zoned.size () && status >= 0; i++)
         {
-          int f_value[numVal];
-          if (H5Aread (att_id, H5T_NATIVE_INT, f_value)<0)
+          string rel = (zoned[i] == "." ? "" : "/" + zoned[i]);
+          string src = srcpath + rel;
+          string copy = dstpath + rel;
+          string zname = copy + "_zonemap";
+          dset_id = H5Dopen (file, src.c_str (), H5P_DEFAULT);
+          hid_t zm = 0;
+          if (dset_id >= 0)
             {
-              error ("h5readatt: reading the given integer Attribute failed");
-              return retval;
+              zm = open_zonemap ();
+              H5Dclose (dset_id);
+              dset_id = -1;
             }
-          for (size_t n=0;n<numVal;++n)
-            value[n] = f_value[n]*1.0;
+          if (zm <= 0)
+            continue;
+          if (H5Lexists (dst.file, zname.c_str (), H5P_DEFAULT) <= 0)
+            {
+              char name[1024];
+              H5Iget_name (zm, name, sizeof (name));
+              status = H5Ocopy (file, name, dst.file, zname.c_str (),
+                                H5P_DEFAULT, lcpl);
+            }
+          H5Dclose (zm);
+          hid_t out = H5Dopen (dst.file, copy.c_str (), H5P_DEFAULT);
+          if (status >= 0)
+            status = set_zonemap_name (out, zname);
+          H5Dclose (out);
         }
-      else
+      H5Pclose (lcpl);
+      if (status < 0)
+        error ("could not copy %s to %s", srcpath, dstpath);
+      return;
+    }
+
+  // a hyperslab of a dataset, in a new dataset with the same type,
+  // layout and filters
+  if (open_dset (srcpath) < 0)
+    {
+      H5Pclose (lcpl);
+      return;
+    }
+  if (start.nelem () != rank || count.nelem () != rank || rank == 0)
+    {
+      H5Pclose (lcpl);
+      error ("start and count must be vectors of length %d, the dataset rank",
+             rank);
+      return;
+    }
+  std::vector<hsize_t> hstart (rank), hcount (rank), maxdims (rank);
+  for (int i = 0; i < rank; i++)
+    {
+      int k = rank-i-1;
+      hstart[k] = start(i);
+      hcount[k] = (count(i) == 0 ? h5_dims[k] - min (hstart[k], h5_dims[k])
+                   : (hsize_t)count(i));
+      if (hstart[k] + hcount[k] > h5_dims[k])
         {
-          error ("h5readatt: reading the given integer Attribute failed: cannot handle size of type");
-          return retval;
+          H5Pclose (lcpl);
+          error ("In dimension %d, dataset only has %d elements, but at least %d"
+                 " are required for requested hyperslab", i+1,
+                 (int)h5_dims[k], (int)(hstart[k] + hcount[k]));
+          return;
         }
+      maxdims[k] = (h5_maxdims[k] == H5S_UNLIMITED ? H5S_UNLIMITED
+                    : hcount[k]);
+    }
 
-      Matrix mat (numVal,1);
-      for (size_t n=0;n<numVal;++n)
-        mat(n)=value[n];
-      retval = octave_value (mat);
-    
+  type_id = H5Dget_type (dset_id);
+  hid_t src_dcpl = H5Dget_create_plist (dset_id);
+  hid_t dcpl = H5Pcopy (src_dcpl);
+  H5Pclose (src_dcpl);
+
+  // A chunk may not be larger than a fixed dimension, so the chunks of
+  // a hyperslab smaller than one are cut down to it. Only chunks of the
+  // same dimensions can be copied as they are stored.
+  std::vector<hsize_t> chunk (rank, 0);
+  bool same_chunks = (H5Pget_layout (dcpl) == H5D_CHUNKED
+                      && H5Pget_chunk (dcpl, rank, &chunk[0]) == rank);
+  if (same_chunks)
+    {
+      std::vector<hsize_t> new_chunk (chunk);
+      for (int k = 0; k < rank; k++)
+        if (maxdims[k] != H5S_UNLIMITED)
+          new_chunk[k] = max (min (chunk[k], hcount[k]), (hsize_t)1);
+      same_chunks = (new_chunk == chunk);
+      if (! same_chunks)
+        H5Pset_chunk (dcpl, rank, &new_chunk[0]);
     }
-  else if (H5Tget_class (type) == H5T_FLOAT)
+
+  hid_t space = H5Screate_simple (rank, &hcount[0], &maxdims[0]);
+  hid_t out = H5Dcreate (dst.file, dstpath, type_id, space, lcpl, dcpl,
+                         H5P_DEFAULT);
+  H5Sclose (space);
+  H5Pclose (lcpl);
+  if (out < 0)
+    {
+      H5Pclose (dcpl);
+      error ("could not create the dataset %s", dstpath);
+      return;
+    }
+
+  // Chunks which lie entirely in the hyperslab (or are cut off by the
+  // end of the dataset in both) are copied as they are stored, still
+  // compressed.
+  bool aligned = same_chunks;
+  for (int k = 0; k < rank && aligned; k++)
+    aligned = (hstart[k] % chunk[k] == 0
+               && (hcount[k] % chunk[k] == 0
+                   || hstart[k] + hcount[k] == h5_dims[k]));
+  H5Pclose (dcpl);
+
+  herr_t status = 0;
+#if H5_VERSION_GE (1, 10, 3)
+  if (aligned)
     {
-      double value[numVal];
-      if (H5Tget_size (type) == sizeof (float))
+      H5PhaseTimer timer (H5_PHASE_IO);
+      std::vector<hsize_t> grid (rank, 0), ngrid (rank);
+      std::vector<hsize_t> src_offset (rank), dst_offset (rank);
+      hsize_t nchunks = 1;
+      for (int k = 0; k < rank; k++)
+        {
+          ngrid[k] = (hcount[k] + chunk[k] - 1) / chunk[k];
+          nchunks *= ngrid[k];
+        }
+      std::vector<char> buf;
+      // the size of chunks which are not allocated is an error
+      H5E_auto_t oef;
+      void *olderr;
+      H5Eget_auto (H5E_DEFAULT, &oef, &olderr);
+      H5Eset_auto (H5E_DEFAULT, 0, 0);
+      for (hsize_t c = 0; c < nchunks && status >= 0; c++)
         {
-          float f_value[numVal];
-          if (H5Aread (att_id, H5T_NATIVE_FLOAT, f_value)<0)
+          for (int k = 0; k < rank; k++)
             {
-              error ("h5readatt: reading the given float Attribute failed");
-              return retval;
+              dst_offset[k] = grid[k] * chunk[k];
+              src_offset[k] = hstart[k] + dst_offset[k];
             }
-          for (size_t n = 0; n < numVal; ++n)
-            value[n] = f_value[n];
-        }
-      else if (H5Tget_size (type) == sizeof (double))
-        {
-          if (H5Aread (att_id, H5T_NATIVE_DOUBLE, value)<0)
+          for (int k = rank-1; k >= 0 && ++grid[k] == ngrid[k]; k--)
+            grid[k] = 0;
+
+          // skip the chunks which were never written
+          hsize_t size = 0;
+          if (H5Dget_chunk_storage_size (dset_id, &src_offset[0], &size) < 0
+              || size == 0)
+            continue;
+          buf.resize (size);
+          uint32_t filter_mask = 0;
+          status = H5Dread_chunk (dset_id, H5P_DEFAULT, &src_offset[0],
+                                  &filter_mask, &buf[0]);
+          if (status >= 0)
+            status = H5Dwrite_chunk (out, H5P_DEFAULT, filter_mask,
+                                     &dst_offset[0], size, &buf[0]);
+          if (h5stats_current != NULL)
             {
-              error ("h5readatt: reading the given double Attribute failed");
-              return retval;
+              h5stats_current->bytes_read += size;
+              h5stats_current->bytes_written += size;
             }
         }
-      else
-        {
-          error ("h5readatt: reading the given float Attribute failed: \
-cannot handle size of type");
-          return retval;
-        }
+      H5Eset_auto (H5E_DEFAULT, oef, olderr);
+    }
+  else
+#endif
+    {
+      // Anything else is read and written a slab at a time in the type
+      // of the file, i.e. without conversion, and compressed again.
+      status = copy_slabs (out, hstart, hcount);
+    }
 
-      Matrix mat (numVal,1);
-      for (size_t n=0;n<numVal;++n)
-        mat(n)=value[n];
-      retval = octave_value (mat);
+  H5Dclose (out);
+  if (status < 0)
+    error ("could not copy %s to %s", srcpath, dstpath);
+}
 
-    }
-  else //none of the supported data types
+// Copy the hyperslab HSTART, HCOUNT of the dataset open as dset_id,
+// whose type is open as type_id, to the start of the dataset OUT. It is
+// read and written a slab at a time in the type of the file, i.e.
+// without conversion, and compressed with the filters of OUT.
+herr_t
+H5File::copy_slabs (hid_t out, const std::vector<hsize_t>& hstart,
+                    const std::vector<hsize_t>& hcount)
+{
+  int rank = hstart.size ();
+  size_t typesize = H5Tget_size (type_id);
+  hsize_t rowsize = 1;
+  for (int k = 1; k < rank; k++)
+    rowsize *= hcount[k];
+  hsize_t slabrows = min (stream_slab_rows (1, typesize), hcount[0]);
+  std::vector<char> buf (max (slabrows * rowsize * typesize, (hsize_t)1));
+  std::vector<hsize_t> src_start (hstart), dst_start (rank, 0);
+  std::vector<hsize_t> slab (hcount);
+  hid_t out_space = H5Dget_space (out);
+  bool is_vlen = (H5Tdetect_class (type_id, H5T_VLEN) > 0
+                  || H5Tis_variable_str (type_id) > 0);
+  herr_t status = 0;
+  for (hsize_t r0 = 0; r0 < hcount[0] && status >= 0; r0 += slabrows)
     {
-      error ("h5readatt: attribute type not supported");
-      return retval;
+      slab[0] = min (slabrows, hcount[0] - r0);
+      src_start[0] = hstart[0] + r0;
+      dst_start[0] = r0;
+      hsize_t npoints = slab[0] * rowsize;
+      hid_t mem_space = H5Screate_simple (1, &npoints, NULL);
+      {
+        H5PhaseTimer timer (H5_PHASE_SELECT);
+        status = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET,
+                                      &src_start[0], NULL, &slab[0], NULL);
+        if (status >= 0)
+          status = H5Sselect_hyperslab (out_space, H5S_SELECT_SET,
+                                        &dst_start[0], NULL, &slab[0],
+                                        NULL);
+      }
+      if (status >= 0)
+        status = dset_read (type_id, mem_space, dspace_id, &buf[0]);
+      if (status >= 0)
+        {
+          H5PhaseTimer timer (H5_PHASE_IO);
+          status = H5Dwrite (out, type_id, mem_space, out_space,
+                             xfer_plist, &buf[0]);
+          if (is_vlen)
+            H5Dvlen_reclaim (type_id, mem_space, H5P_DEFAULT, &buf[0]);
+          if (h5stats_current != NULL)
+            h5stats_current->bytes_written += npoints * typesize;
+        }
+      H5Sclose (mem_space);
     }
-  
-  return retval;
+  H5Sclose (out_space);
+  return status;
 }
 
-void
-H5File::write_att (const char *location, const char *attname,
-                   const octave_value& attvalue)
+// The state of h5repack: the path in the new file of each object
+// copied so far, by its address in the source file, and the attributes
+// holding references (the path of their object and their name), which
+// are written by repack_ref_attributes once everything is copied.
+struct H5RepackState
 {
-  hsize_t *dims;
-  if (attvalue.is_scalar_type () || attvalue.is_string ())
-    dspace_id = H5Screate (H5S_SCALAR);
-  else if (attvalue.is_matrix_type ())
+  std::map<haddr_t, std::string> copied;
+  std::vector<std::pair<std::string, std::string> > ref_attrs;
+};
+
+// Note the attributes of the object SRC at PATH which hold references
+// in STATE, for repack_ref_attributes.
+static void
+note_ref_attributes (hid_t src, const string& path, H5RepackState& state)
+{
+  std::vector<string> names;
+  if (H5Aiterate2 (src, H5_INDEX_NAME, H5_ITER_INC, NULL, collect_attr_name,
+                   &names) < 0)
+    return;
+  for (size_t i = 0; i < names.size (); i++)
     {
-      error ("matrix type attributes are not yet supported.");
-      return;
-      // dims = alloc_hsize (attvalue.dims (), ALLOC_HSIZE_DEFAULT, true);
-      // dspace_id = H5Screate_simple (attvalue.dims ().length (), dims, NULL);
-      // free (dims);
+      hid_t attr = H5Aopen (src, names[i].c_str (), H5P_DEFAULT);
+      hid_t type = H5Aget_type (attr);
+      if (H5Tdetect_class (type, H5T_REFERENCE) > 0)
+        state.ref_attrs.push_back (std::make_pair (path, names[i]));
+      H5Tclose (type);
+      H5Aclose (attr);
     }
-  else
+}
+
+// Copy all attributes of the object SRC at PATH to the object DST,
+// which may be in another file. Attributes holding references, which
+// are addresses in the file, are left to repack_ref_attributes (see
+// H5RepackState).
+herr_t
+H5File::copy_attributes (hid_t src, hid_t dst, const string& path,
+                         H5RepackState& state)
+{
+  std::vector<string> names;
+  if (H5Aiterate2 (src, H5_INDEX_NAME, H5_ITER_INC, NULL, collect_attr_name,
+                   &names) < 0)
+    return -1;
+
+  herr_t status = 0;
+  for (size_t i = 0; i < names.size () && status >= 0; i++)
     {
-      error ("Only scalar attributes are supported at the moment.");
-      return;
+      hid_t attr = H5Aopen (src, names[i].c_str (), H5P_DEFAULT);
+      hid_t ftype = H5Aget_type (attr);
+      if (H5Tdetect_class (ftype, H5T_REFERENCE) > 0)
+        {
+          state.ref_attrs.push_back (std::make_pair (path, names[i]));
+          H5Tclose (ftype);
+          H5Aclose (attr);
+          continue;
+        }
+      // a committed datatype cannot be used in another file
+      hid_t type = H5Tcopy (ftype);
+      hid_t space = H5Aget_space (attr);
+      hssize_t npoints = H5Sget_simple_extent_npoints (space);
+      std::vector<char> buf (max ((size_t)npoints * H5Tget_size (type),
+                                  (size_t)1));
+      status = H5Aread (attr, type, &buf[0]);
+      if (status >= 0)
+        {
+          hid_t out = H5Acreate (dst, names[i].c_str (), type, space,
+                                 H5P_DEFAULT, H5P_DEFAULT);
+          status = (out < 0 ? -1 : H5Awrite (out, type, &buf[0]));
+          if (out >= 0)
+            H5Aclose (out);
+          if (H5Tdetect_class (type, H5T_VLEN) > 0
+              || H5Tis_variable_str (type) > 0)
+            H5Dvlen_reclaim (type, space, H5P_DEFAULT, &buf[0]);
+        }
+      H5Sclose (space);
+      H5Tclose (type);
+      H5Tclose (ftype);
+      H5Aclose (attr);
     }
+  return status;
+}
 
-  //H5Lexists returns false for the root group '/'
-  if (strcmp (location,"/")!=0 && ! H5Lexists (file, location, H5P_DEFAULT))
+// Return whether free space in the file is tracked across closing and
+// reopening it.
+bool
+H5File::persists_free_space ()
+{
+  hbool_t persist = 0;
+#if H5_VERSION_GE (1, 10, 1)
+  hid_t fcpl = H5Fget_create_plist (file);
+  H5F_fspace_strategy_t strategy;
+  hsize_t threshold;
+  H5Pget_file_space_strategy (fcpl, &strategy, &persist, &threshold);
+  H5Pclose (fcpl);
+#endif
+  return persist;
+}
+
+// Rewrite everything in the file to the new file DST. As nothing is
+// copied that is no longer linked, DST has no dead space. Datasets are
+// copied as they are stored, unless OPTS changes their chunk size or
+// compression.
+void
+H5File::repack (H5File& dst, const H5RepackOptions& opts)
+{
+  H5RepackState state;
+  hid_t src_root = H5Gopen (file, "/", H5P_DEFAULT);
+  hid_t dst_root = H5Gopen (dst.file, "/", H5P_DEFAULT);
+  H5O_info_t info;
+  if (H5Oget_info (src_root, &info) >= 0)
+    state.copied[info.addr] = "/";
+  herr_t status = copy_attributes (src_root, dst_root, "/", state);
+  H5Gclose (dst_root);
+  H5Gclose (src_root);
+  if (status < 0)
     {
-      error ("the specified HDF5 object %s does not exist", location);
+      error ("could not copy the attributes of /");
       return;
     }
-  obj_id = H5Oopen (file, location, H5P_DEFAULT);
-  if (obj_id < 0)
+
+  repack_group ("/", dst, opts, state);
+  if (! error_state && repack_ref_attributes (dst, state) < 0)
+    error ("could not copy the attributes holding references");
+  if (! error_state && H5Fflush (dst.file, H5F_SCOPE_LOCAL) < 0)
+    error ("could not flush the file");
+}
+
+// Copy the members of the group PATH, which exists in both files, to
+// DST: subgroups with their attributes (recursively), datasets by
+// repack_dset, named datatypes, and soft and external links. An object
+// with several hard links is copied once, at the first of them, and
+// linked to from the others (see H5RepackState), which also stops at
+// groups linked into their own subtree.
+void
+H5File::repack_group (const string& path, H5File& dst,
+                      const H5RepackOptions& opts, H5RepackState& state)
+{
+  std::vector<string> links;
+  hid_t group_id = H5Gopen (file, path.c_str (), H5P_DEFAULT);
+  herr_t status = H5Literate (group_id, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                              collect_link_name, &links);
+  H5Gclose (group_id);
+  if (status < 0)
     {
-      error ("the specified HDF5 object %s could not be opened", location);
+      error ("could not list the members of the group %s", path.c_str ());
       return;
     }
-  
-  //Check if an attribute with the given name exists already at that
-  //object and if yes delete it.
-  htri_t exists = H5Aexists (obj_id, attname);
-  if (exists > 0)
+
+  for (size_t i = 0; i < links.size () && ! error_state; i++)
     {
-      if (H5Adelete (obj_id, attname) < 0)
+      string child = (path == "/" ? "/" : path + "/") + links[i];
+      H5L_info_t info;
+      if (H5Lget_info (file, child.c_str (), &info, H5P_DEFAULT) < 0)
         {
-          error ("could not delete existing attribute %s at %s", attname, location);
+          error ("could not get the link %s", child.c_str ());
           return;
         }
-    }
-  else if (exists < 0)
-    {
-      error ("could not check if attribute %s exists at %s", attname, location);
-      return;
-    }
 
-  void* buf;
-  double attval_double;
-  int attval_int;
+      if (info.type == H5L_TYPE_SOFT || info.type == H5L_TYPE_EXTERNAL)
+        {
+          std::vector<char> val (info.u.val_size + 1, 0);
+          status = H5Lget_val (file, child.c_str (), &val[0], val.size (),
+                               H5P_DEFAULT);
+          if (status >= 0 && info.type == H5L_TYPE_SOFT)
+            status = H5Lcreate_soft (&val[0], dst.file, child.c_str (),
+                                     H5P_DEFAULT, H5P_DEFAULT);
+          else if (status >= 0)
+            {
+              unsigned flags;
+              const char *filename, *objname;
+              status = H5Lunpack_elink_val (&val[0], info.u.val_size, &flags,
+                                            &filename, &objname);
+              if (status >= 0)
+                status = H5Lcreate_external (filename, objname, dst.file,
+                                             child.c_str (), H5P_DEFAULT,
+                                             H5P_DEFAULT);
+            }
+        }
+      else if (info.type == H5L_TYPE_HARD
+               && state.copied.count (info.u.address) > 0)
+        status = H5Lcreate_hard (dst.file,
+                                 state.copied[info.u.address].c_str (),
+                                 dst.file, child.c_str (), H5P_DEFAULT,
+                                 H5P_DEFAULT);
+      else if (info.type == H5L_TYPE_HARD)
+        {
+          state.copied[info.u.address] = child;
+          hid_t obj = H5Oopen (file, child.c_str (), H5P_DEFAULT);
+          H5I_type_t type = H5Iget_type (obj);
+          if (type == H5I_GROUP)
+            {
+              hid_t gcpl = H5Gget_create_plist (obj);
+              hid_t out = H5Gcreate (dst.file, child.c_str (), H5P_DEFAULT,
+                                     gcpl, H5P_DEFAULT);
+              H5Pclose (gcpl);
+              status = (out < 0 ? -1 : copy_attributes (obj, out, child,
+                                                        state));
+              if (out >= 0)
+                H5Gclose (out);
+              H5Oclose (obj);
+              if (status >= 0)
+                repack_group (child, dst, opts, state);
+            }
+          else if (type == H5I_DATASET)
+            {
+              H5Oclose (obj);
+              status = repack_dset (child, dst, opts, state);
+              close_handles ();
+            }
+          else
+            {
+              note_ref_attributes (obj, child, state);
+              H5Oclose (obj);
+              H5PhaseTimer timer (H5_PHASE_IO);
+              status = H5Ocopy (file, child.c_str (), dst.file, child.c_str (),
+                                H5P_DEFAULT, H5P_DEFAULT);
+            }
+        }
 
-  if (attvalue.is_string ())
-    {
-      type_id = H5Tcopy (H5T_C_S1);
-      H5Tset_size (type_id, attvalue.string_value ().length ());
-      H5Tset_strpad (type_id,H5T_STR_NULLTERM);
-      mem_type_id = H5Tcopy (type_id);
-      
-      buf = (void *) attvalue.string_value ().c_str ();
+      if (status < 0 && ! error_state)
+        error ("could not copy %s", child.c_str ());
     }
-  else if (attvalue.is_integer_type ())
+}
+
+// Copy the dataset PATH to DST. Without a new chunk size or deflate
+// level in OPTS, it is copied with H5Ocopy, i.e. its chunks are copied
+// as they are stored. Otherwise it is created with the new layout and
+// filters and its data is copied by copy_slabs. Datasets with a zone
+// map keep their chunk size, which the zone map depends on.
+herr_t
+H5File::repack_dset (const string& path, H5File& dst,
+                     const H5RepackOptions& opts, H5RepackState& state)
+{
+  // H5Ocopy copies references into another file as null references
+  if (opts.chunksize.is_empty () && opts.deflate < 0)
     {
-      //type_id = H5Tcopy (H5T_STD_I64LE); //cannot read this back in then, don't know why
-      type_id = H5Tcopy (H5T_NATIVE_INT);
-      mem_type_id = H5Tcopy (H5T_NATIVE_INT);
-      attval_int = attvalue.int_value ();
-      buf = (void *) &attval_int;
+      hid_t obj = H5Oopen (file, path.c_str (), H5P_DEFAULT);
+      if (obj >= 0)
+        {
+          note_ref_attributes (obj, path, state);
+          H5Oclose (obj);
+        }
+      H5PhaseTimer timer (H5_PHASE_IO);
+      return H5Ocopy (file, path.c_str (), dst.file, path.c_str (),
+                      H5P_DEFAULT, H5P_DEFAULT);
     }
-  else if (attvalue.is_real_type ())
+
+  if (open_dset (path.c_str ()) < 0)
+    return -1;
+  if (rank == 0)
     {
-      type_id = H5Tcopy (H5T_NATIVE_DOUBLE);
-      mem_type_id = H5Tcopy (H5T_NATIVE_DOUBLE);
-      attval_double = attvalue.double_value ();
-      buf = (void *) &attval_double;
+      note_ref_attributes (dset_id, path, state);
+      return H5Ocopy (file, path.c_str (), dst.file, path.c_str (),
+                      H5P_DEFAULT, H5P_DEFAULT);
     }
-  else if (attvalue.is_complex_type ())
+
+  hid_t ftype = H5Dget_type (dset_id);
+  type_id = H5Tcopy (ftype);
+  H5Tclose (ftype);
+  hid_t dcpl = H5Dget_create_plist (dset_id);
+
+  // the new chunk size, limited by the maximum dimensions
+  bool rechunk = (! opts.chunksize.is_empty ()
+                  && H5Aexists (dset_id, "zonemap") <= 0
+                  && (opts.chunksize(0) == 0
+                      || opts.chunksize.nelem () == rank));
+  bool chunked = (H5Pget_layout (dcpl) == H5D_CHUNKED);
+  if (! chunked && opts.deflate > 0)
+    rechunk = (H5Aexists (dset_id, "zonemap") <= 0);
+  if (rechunk)
     {
-      error ("complex values are not supported by the HDF5 format. \
-You have to save real and imag part separately.");
-      return;
+      Matrix chunksize = opts.chunksize;
+      if (chunksize.is_empty () || chunksize(0) == 0)
+        {
+          Matrix size (1, rank);
+          for (int i = 0; i < rank; i++)
+            size(i) = h5_dims[rank-i-1];
+          chunksize = get_auto_chunksize (size, H5Tget_size (type_id));
+        }
+      std::vector<hsize_t> chunk (rank);
+      for (int k = 0; k < rank; k++)
+        {
+          chunk[k] = max ((hsize_t)chunksize(rank-k-1), (hsize_t)1);
+          if (h5_maxdims[k] != H5S_UNLIMITED)
+            chunk[k] = min (chunk[k], h5_maxdims[k]);
+          rechunk = rechunk && chunk[k] > 0;
+        }
+      if (rechunk && H5Pset_chunk (dcpl, rank, &chunk[0]) >= 0)
+        chunked = true;
     }
-  else
+  if (opts.deflate >= 0 && chunked)
     {
-      error ("this variable type is not supported");
-      return;
+      H5E_auto_t oef;
+      void *olderr;
+      H5Eget_auto (H5E_DEFAULT, &oef, &olderr);
+      H5Eset_auto (H5E_DEFAULT, 0, 0);
+      H5Premove_filter (dcpl, H5Z_FILTER_DEFLATE);
+      H5Eset_auto (H5E_DEFAULT, oef, olderr);
+      if (opts.deflate > 0)
+        H5Pset_deflate (dcpl, opts.deflate);
     }
 
-  if (H5Aexists (obj_id,attname))
-    att_id = H5Aopen (obj_id, attname, H5P_DEFAULT);
-  else
+  hid_t out = H5Dcreate (dst.file, path.c_str (), type_id, dspace_id,
+                         H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  H5Pclose (dcpl);
+  if (out < 0)
+    return -1;
+  std::vector<hsize_t> hstart (rank, 0), hcount (h5_dims, h5_dims + rank);
+  herr_t status = copy_slabs (out, hstart, hcount);
+  if (status >= 0)
+    status = copy_attributes (dset_id, out, path, state);
+  H5Dclose (out);
+  return status;
+}
+
+// Rewrite the references in the element of TYPE at P, which point into
+// the file SRC, to the copies in the file DST of the objects they point
+// to (see H5RepackState), looking into compound, array and variable
+// length types. References to objects which were not copied become
+// null references.
+static herr_t
+repack_refs (hid_t type, char *p, hid_t src, hid_t dst,
+             const H5RepackState& state)
+{
+  herr_t status = 0;
+  switch (H5Tget_class (type))
     {
-      att_id = H5Acreate (obj_id, attname, type_id,
-                          dspace_id, H5P_DEFAULT, H5P_DEFAULT);
+    case H5T_REFERENCE:
+      {
+        bool region = (H5Tequal (type, H5T_STD_REF_DSETREG) > 0);
+        H5R_type_t rtype = region ? H5R_DATASET_REGION : H5R_OBJECT;
+        size_t size = H5Tget_size (type);
+        std::vector<char> null (size, 0);
+        if (memcmp (p, &null[0], size) == 0)
+          break;
+        hid_t obj = H5Rdereference2 (src, H5P_DEFAULT, rtype, p);
+        H5O_info_t info;
+        std::map<haddr_t, std::string>::const_iterator it
+          = state.copied.end ();
+        if (obj >= 0 && H5Oget_info (obj, &info) >= 0)
+          it = state.copied.find (info.addr);
+        if (obj >= 0)
+          H5Oclose (obj);
+        hid_t space = -1;
+        if (region && it != state.copied.end ())
+          space = H5Rget_region (src, H5R_DATASET_REGION, p);
+        memset (p, 0, size);
+        if (it != state.copied.end () && (! region || space >= 0))
+          status = H5Rcreate (p, dst, it->second.c_str (), rtype, space);
+        if (space >= 0)
+          H5Sclose (space);
+      }
+      break;
+    case H5T_COMPOUND:
+      for (int m = 0; m < H5Tget_nmembers (type) && status >= 0; m++)
+        {
+          hid_t mtype = H5Tget_member_type (type, m);
+          if (H5Tdetect_class (mtype, H5T_REFERENCE) > 0)
+            status = repack_refs (mtype, p + H5Tget_member_offset (type, m),
+                                  src, dst, state);
+          H5Tclose (mtype);
+        }
+      break;
+    case H5T_ARRAY:
+      {
+        hid_t base = H5Tget_super (type);
+        size_t size = H5Tget_size (base);
+        size_t n = H5Tget_size (type) / max (size, (size_t)1);
+        for (size_t i = 0; i < n && status >= 0; i++)
+          status = repack_refs (base, p + i * size, src, dst, state);
+        H5Tclose (base);
+      }
+      break;
+    case H5T_VLEN:
+      {
+        hid_t base = H5Tget_super (type);
+        size_t size = H5Tget_size (base);
+        hvl_t *v = (hvl_t*)p;
+        for (size_t i = 0; i < v->len && status >= 0; i++)
+          status = repack_refs (base, (char*)v->p + i * size, src, dst,
+                                state);
+        H5Tclose (base);
+      }
+      break;
+    default:
+      break;
     }
-  herr_t status = H5Awrite (att_id, mem_type_id, buf);
-  if (status < 0)
+  return status;
+}
+
+// Write the attributes noted in STATE to the copies of their objects in
+// DST, with the references they hold rewritten by repack_refs, once all
+// objects they may refer to have been copied.
+herr_t
+H5File::repack_ref_attributes (H5File& dst, const H5RepackState& state)
+{
+  herr_t status = 0;
+  for (size_t i = 0; i < state.ref_attrs.size () && status >= 0; i++)
     {
-      error ("error when writing the attribute %s at %s", attname, location);
-      return;
+      const char *path = state.ref_attrs[i].first.c_str ();
+      const char *name = state.ref_attrs[i].second.c_str ();
+      hid_t attr = H5Aopen_by_name (file, path, name, H5P_DEFAULT,
+                                    H5P_DEFAULT);
+      if (attr < 0)
+        return -1;
+      // a committed datatype cannot be used in another file
+      hid_t ftype = H5Aget_type (attr);
+      hid_t out_type = H5Tcopy (ftype);
+      hid_t type = H5Tget_native_type (ftype, H5T_DIR_DEFAULT);
+      hid_t space = H5Aget_space (attr);
+      hssize_t npoints = H5Sget_simple_extent_npoints (space);
+      size_t size = H5Tget_size (type);
+      std::vector<char> buf (max ((size_t)npoints * size, (size_t)1));
+      status = H5Aread (attr, type, &buf[0]);
+      for (hssize_t k = 0; k < npoints && status >= 0; k++)
+        status = repack_refs (type, &buf[k * size], file, dst.file, state);
+      if (status >= 0)
+        {
+          // H5Ocopy may have copied it with null references
+          if (H5Aexists_by_name (dst.file, path, name, H5P_DEFAULT) > 0)
+            H5Adelete_by_name (dst.file, path, name, H5P_DEFAULT);
+          hid_t out = H5Acreate_by_name (dst.file, path, name, out_type,
+                                         space, H5P_DEFAULT, H5P_DEFAULT,
+                                         H5P_DEFAULT);
+          status = (out < 0 ? -1 : H5Awrite (out, type, &buf[0]));
+          if (out >= 0)
+            H5Aclose (out);
+        }
+      if (H5Tdetect_class (type, H5T_VLEN) > 0)
+        H5Dvlen_reclaim (type, space, H5P_DEFAULT, &buf[0]);
+      H5Sclose (space);
+      H5Tclose (type);
+      H5Tclose (out_type);
+      H5Tclose (ftype);
+      H5Aclose (attr);
     }
+  return status;
 }
 
-
 void
 H5File::create_dset (const char *location, const Matrix& size,
-                     const char *datatype, Matrix& chunksize)
+                     const char *datatype, Matrix& chunksize,
+                     const H5CreateOptions& opts)
 {
   int typesize;
   if (strcmp (datatype,"double") == 0)
@@ -1534,8 +7666,24 @@ H5File::create_dset (const char *location, const Matrix& size,
       error ("If the size argument contains an Inf or zero element, then ChunkSize must be specified.");
       return;
     }
+  if (opts.zonemap && chunksize.is_empty ())
+    {
+      error ("A dataset with a ZoneMap must be chunked, specify ChunkSize.");
+      return;
+    }
+  bool filtered = opts.shuffle || opts.deflate > 0 || ! opts.filters.empty ();
+  if (filtered && chunksize.is_empty ())
+    {
+      error ("Filters can only be applied to chunked datasets, specify ChunkSize.");
+      return;
+    }
   // get a dataset creation property list
   hid_t crp_list = H5Pcreate (H5P_DATASET_CREATE);
+  if (set_attr_storage (crp_list) < 0)
+    {
+      error ("Could not set attribute storage of %s", location);
+      return;
+    }
   if (! chunksize.is_empty ())
     {
       // a dataset with an unlimited dimension must be chunked.
@@ -1555,6 +7703,35 @@ H5File::create_dset (const char *location, const Matrix& size,
         }
       free (dims_chunk);
     }
+
+  if (opts.shuffle && H5Pset_shuffle (crp_list) < 0)
+    {
+      error ("Could not set the shuffle filter of %s", location);
+      return;
+    }
+  if (opts.deflate > 0 && H5Pset_deflate (crp_list, opts.deflate) < 0)
+    {
+      error ("Could not set the deflate filter of %s", location);
+      return;
+    }
+  for (size_t i = 0; i < opts.filters.size (); i++)
+    {
+      // a filter which is not built into the library is loaded as a
+      // plugin from the directories in HDF5_PLUGIN_PATH
+      const H5Filter& f = opts.filters[i];
+      if (H5Zfilter_avail (f.id) <= 0)
+        {
+          error ("The filter %d is not available, HDF5_PLUGIN_PATH must name"
+                 " the directory of its plugin", (int)f.id);
+          return;
+        }
+      if (H5Pset_filter (crp_list, f.id, H5Z_FLAG_MANDATORY, f.params.size (),
+                         f.params.empty () ? NULL : &f.params[0]) < 0)
+        {
+          error ("Could not set the filter %d of %s", (int)f.id, location);
+          return;
+        }
+    }
   
   dset_id = H5Dcreate (file, location, type_id, dspace_id,
                        H5P_DEFAULT, crp_list, H5P_DEFAULT);
@@ -1565,11 +7742,469 @@ H5File::create_dset (const char *location, const Matrix& size,
     }
   H5Pclose (crp_list);
 
+  if (opts.zonemap && create_zonemap (location) < 0)
+    error ("Could not create the zone map of %s", location);
+}
+
+// Create the zone map of the chunked dataset LOCATION, which is open as
+// dset_id: a double dataset with one row of (minimum, maximum) per
+// chunk, i.e. with the dimensions of the chunk grid and a last
+// dimension of 2. It is filled with NaN, which stands for unknown
+// bounds, and its name is kept in the attribute "zonemap" of the
+// dataset.
+herr_t
+H5File::create_zonemap (const char *location)
+{
+  hid_t space = H5Dget_space (dset_id);
+  int r = H5Sget_simple_extent_ndims (space);
+  std::vector<hsize_t> dims (r + 1), maxdims (r + 1), chunk (r + 1);
+  H5Sget_simple_extent_dims (space, &dims[0], &maxdims[0]);
+  H5Sclose (space);
+  hid_t dcpl = H5Dget_create_plist (dset_id);
+  H5Pget_chunk (dcpl, r, &chunk[0]);
+  H5Pclose (dcpl);
+
+  std::vector<hsize_t> zdims (r + 1), zmaxdims (r + 1), zchunk (r + 1);
+  for (int i = 0; i < r; i++)
+    {
+      zdims[i] = (dims[i] + chunk[i] - 1) / chunk[i];
+      if (maxdims[i] == H5S_UNLIMITED)
+        {
+          zmaxdims[i] = H5S_UNLIMITED;
+          zchunk[i] = ZONEMAP_CHUNK;
+        }
+      else
+        {
+          zmaxdims[i] = (maxdims[i] + chunk[i] - 1) / chunk[i];
+          zchunk[i] = max (min (zmaxdims[i], ZONEMAP_CHUNK), (hsize_t)1);
+        }
+    }
+  zdims[r] = zmaxdims[r] = zchunk[r] = 2;
+
+  string name = string (location) + "_zonemap";
+  double nan = octave_NaN;
+  hid_t zspace = H5Screate_simple (r + 1, &zdims[0], &zmaxdims[0]);
+  hid_t zdcpl = H5Pcreate (H5P_DATASET_CREATE);
+  H5Pset_chunk (zdcpl, r + 1, &zchunk[0]);
+  H5Pset_fill_value (zdcpl, H5T_NATIVE_DOUBLE, &nan);
+  hid_t zm = H5Dcreate (file, name.c_str (), H5T_NATIVE_DOUBLE, zspace,
+                        H5P_DEFAULT, zdcpl, H5P_DEFAULT);
+  H5Pclose (zdcpl);
+  H5Sclose (zspace);
+  if (zm < 0)
+    return -1;
+  H5Dclose (zm);
+
+  return set_zonemap_name (dset_id, name);
+}
+
+// Record NAME as the zone map of the dataset DSET, in its attribute
+// "zonemap".
+herr_t
+H5File::set_zonemap_name (hid_t dset, const string& name)
+{
+  if (H5Aexists (dset, "zonemap") > 0)
+    H5Adelete (dset, "zonemap");
+  hid_t str_type = H5Tcopy (H5T_C_S1);
+  H5Tset_size (str_type, name.length () + 1);
+  hid_t aspace = H5Screate (H5S_SCALAR);
+  hid_t attr = H5Acreate (dset, "zonemap", str_type, aspace,
+                          H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status = -1;
+  if (attr >= 0)
+    {
+      status = H5Awrite (attr, str_type, name.c_str ());
+      H5Aclose (attr);
+    }
+  H5Sclose (aspace);
+  H5Tclose (str_type);
+  return status;
+}
+
+// Open the zone map of the dataset open as dset_id. Returns 0 if it has
+// none.
+hid_t
+H5File::open_zonemap ()
+{
+  if (H5Aexists (dset_id, "zonemap") <= 0)
+    return 0;
+  hid_t attr = H5Aopen (dset_id, "zonemap", H5P_DEFAULT);
+  hid_t str_type = H5Aget_type (attr);
+  std::vector<char> name (H5Tget_size (str_type) + 1, 0);
+  H5Aread (attr, str_type, &name[0]);
+  H5Tclose (str_type);
+  H5Aclose (attr);
+  return H5Dopen (file, &name[0], H5P_DEFAULT);
+}
+
+// The bounds and the number of the values written to each chunk of a
+// box of chunks, for update_zonemap. GRID holds the chunk of each index
+// of the hyperslab along each dimension, ZSTART the first chunk of the
+// box and BSTRIDE its strides. The values are added in the order of the
+// hyperslab, column major if COLUMN_MAJOR.
+class H5ZoneBox
+{
+ public:
+  H5ZoneBox (const std::vector<std::vector<hsize_t> >& grid,
+             const std::vector<hsize_t>& zstart,
+             const std::vector<hsize_t>& bstride, bool column_major,
+             std::vector<double>& bmin, std::vector<double>& bmax,
+             std::vector<hsize_t>& nwritten)
+    : grid (grid), zstart (zstart), bstride (bstride),
+      column_major (column_major), bmin (bmin), bmax (bmax),
+      nwritten (nwritten), idx (grid.size (), 0)
+  { }
+
+  template <typename T>
+  void add (const T *p, octave_idx_type n)
+  {
+    for (octave_idx_type l = 0; l < n; l++)
+      add_value (p[l]);
+  }
+
+  // the elements of a range are computed one by one
+  void add (const Range& range, octave_idx_type n)
+  {
+    for (octave_idx_type l = 0; l < n; l++)
+      add_value (range.elem (l));
+  }
+
+ private:
+  void add_value (double v)
+  {
+    int r = grid.size ();
+    hsize_t b = 0;
+    for (int k = 0; k < r; k++)
+      b += (grid[k][idx[k]] - zstart[k]) * bstride[k];
+    nwritten[b]++;
+    if (v < bmin[b])
+      bmin[b] = v;
+    if (v > bmax[b])
+      bmax[b] = v;
+    if (column_major)
+      for (int k = 0; k < r && ++idx[k] == grid[k].size (); k++)
+        idx[k] = 0;
+    else
+      for (int k = r-1; k >= 0 && ++idx[k] == grid[k].size (); k--)
+        idx[k] = 0;
+  }
+
+  const std::vector<std::vector<hsize_t> >& grid;
+  const std::vector<hsize_t>& zstart;
+  const std::vector<hsize_t>& bstride;
+  bool column_major;
+  std::vector<double>& bmin;
+  std::vector<double>& bmax;
+  std::vector<hsize_t>& nwritten;
+  std::vector<hsize_t> idx;
+};
+
+// Update the zone map of the dataset open as dset_id, if it has one,
+// after DATA has been written to the hyperslab sel_start, sel_stride,
+// sel_count, sel_block. DATA holds the hyperslab in row major order with
+// the dimensions of the file, or in column major order if COLUMN_MAJOR.
+// The bounds of a chunk written as a whole are replaced; those of a
+// chunk written in part are widened (with the fill value, if they were
+// unknown), so they may be wider than the values it holds, but never
+// narrower.
+void
+H5File::update_zonemap (const octave_value& ov_data, bool column_major)
+{
+  hid_t zm = open_zonemap ();
+  if (zm == 0)
+    return;
+  if (zm < 0)
+    {
+      error ("could not open the zone map of the dataset");
+      return;
+    }
+  if (is_mpio)
+    {
+      // the processes would grow and update it in different ways
+      H5Dclose (zm);
+      error ("the zone map of a dataset cannot be updated by several MPI processes");
+      return;
+    }
+
+  int r = sel_start.size ();
+  hid_t space = H5Dget_space (dset_id);
+  std::vector<hsize_t> dims (r), maxdims (r), chunk (r);
+  H5Sget_simple_extent_dims (space, &dims[0], &maxdims[0]);
+  H5Sclose (space);
+  hid_t dcpl = H5Dget_create_plist (dset_id);
+  H5Pget_chunk (dcpl, r, &chunk[0]);
+  double fill = 0;
+  H5D_fill_value_t fill_status;
+  if (H5Pfill_value_defined (dcpl, &fill_status) >= 0
+      && fill_status != H5D_FILL_VALUE_UNDEFINED)
+    H5Pget_fill_value (dcpl, H5T_NATIVE_DOUBLE, &fill);
+  H5Pclose (dcpl);
+
+  // the chunk (along each dimension) of each index of the hyperslab,
+  // and the box of chunks touched by it
+  std::vector<std::vector<hsize_t> > grid (r);
+  std::vector<hsize_t> zstart (r + 1, 0), zcount (r + 1, 2), bstride (r);
+  hsize_t nbox = 1;
+  for (int k = r-1; k >= 0; k--)
+    {
+      hsize_t n = sel_count[k] * sel_block[k];
+      grid[k].resize (n);
+      for (hsize_t i = 0; i < n; i++)
+        grid[k][i] = (sel_start[k] + i / sel_block[k] * sel_stride[k]
+                      + i % sel_block[k]) / chunk[k];
+      zstart[k] = n > 0 ? grid[k][0] : 0;
+      zcount[k] = n > 0 ? grid[k][n-1] - zstart[k] + 1 : 0;
+      bstride[k] = nbox;
+      nbox *= zcount[k];
+    }
+  if (nbox == 0)
+    {
+      H5Dclose (zm);
+      return;
+    }
+
+  // bounds and number of the written values in each chunk of the box,
+  // taken from the storage of the value if it has one of a native type,
+  // so that it is not converted to double as a whole
+  std::vector<double> bmin (nbox, octave_Inf), bmax (nbox, -octave_Inf);
+  std::vector<hsize_t> nwritten (nbox, 0);
+  H5ZoneBox box (grid, zstart, bstride, column_major, bmin, bmax, nwritten);
+  octave_idx_type n = ov_data.numel ();
+  const void *buf = NULL;
+  if (ov_data.is_real_type () && ! ov_data.is_sparse_type ()
+      && ! ov_data.is_range ())
+    buf = ov_data.mex_get_data ();
+  string cls = ov_data.class_name ();
+  if (ov_data.is_range ())
+    box.add (ov_data.range_value (), n);
+  else if (buf != NULL && cls == "double")
+    box.add ((const double*)buf, n);
+  else if (buf != NULL && cls == "single")
+    box.add ((const float*)buf, n);
+  else if (buf != NULL && cls == "logical")
+    box.add ((const bool*)buf, n);
+  else if (buf != NULL && cls == "int8")
+    box.add ((const int8_t*)buf, n);
+  else if (buf != NULL && cls == "uint8")
+    box.add ((const uint8_t*)buf, n);
+  else if (buf != NULL && cls == "int16")
+    box.add ((const int16_t*)buf, n);
+  else if (buf != NULL && cls == "uint16")
+    box.add ((const uint16_t*)buf, n);
+  else if (buf != NULL && cls == "int32")
+    box.add ((const int32_t*)buf, n);
+  else if (buf != NULL && cls == "uint32")
+    box.add ((const uint32_t*)buf, n);
+  else if (buf != NULL && cls == "int64")
+    box.add ((const int64_t*)buf, n);
+  else if (buf != NULL && cls == "uint64")
+    box.add ((const uint64_t*)buf, n);
+  else
+    {
+      const NDArray data = ov_data.array_value ();
+      box.add (data.data (), n);
+    }
+
+  // the zone map grows with the dataset
+  hid_t zspace = H5Dget_space (zm);
+  std::vector<hsize_t> zdims (r + 1);
+  H5Sget_simple_extent_dims (zspace, &zdims[0], NULL);
+  H5Sclose (zspace);
+  bool grow = false;
+  for (int k = 0; k < r; k++)
+    if (zdims[k] < zstart[k] + zcount[k])
+      {
+        zdims[k] = zstart[k] + zcount[k];
+        grow = true;
+      }
+  if (grow)
+    H5Dset_extent (zm, &zdims[0]);
+
+  std::vector<double> bounds (2 * nbox);
+  zspace = H5Dget_space (zm);
+  hsize_t nzm = 2 * nbox;
+  hid_t mem_space = H5Screate_simple (1, &nzm, NULL);
+  herr_t status = H5Sselect_hyperslab (zspace, H5S_SELECT_SET, &zstart[0],
+                                       NULL, &zcount[0], NULL);
+  if (status >= 0)
+    status = H5Dread (zm, H5T_NATIVE_DOUBLE, mem_space, zspace, xfer_plist,
+                      &bounds[0]);
+
+  std::vector<hsize_t> idx (r, 0);
+  for (hsize_t b = 0; b < nbox && status >= 0; b++)
+    {
+      // the number of elements of the chunk (smaller at the upper ends
+      // of fixed dimensions; where the dataset can grow, the rest of
+      // the chunk may come to hold the fill value)
+      double capacity = 1;
+      for (int k = 0; k < r; k++)
+        {
+          hsize_t first = (zstart[k] + idx[k]) * chunk[k];
+          capacity *= (maxdims[k] > dims[k] ? chunk[k]
+                       : min (chunk[k], dims[k] - first));
+        }
+      for (int k = r-1; k >= 0 && ++idx[k] == zcount[k]; k--)
+        idx[k] = 0;
+
+      if (nwritten[b] == 0)
+        continue;
+      double& lo = bounds[2*b];
+      double& hi = bounds[2*b+1];
+      if (nwritten[b] < capacity)
+        {
+          if (xisnan (lo) || xisnan (hi))
+            lo = hi = fill;
+          bmin[b] = min (bmin[b], lo);
+          bmax[b] = max (bmax[b], hi);
+        }
+      lo = bmin[b];
+      hi = bmax[b];
+    }
+
+  if (status >= 0)
+    status = H5Dwrite (zm, H5T_NATIVE_DOUBLE, mem_space, zspace, xfer_plist,
+                       &bounds[0]);
+  H5Sclose (mem_space);
+  H5Sclose (zspace);
+  H5Dclose (zm);
+  if (status < 0)
+    error ("could not update the zone map of the dataset");
+}
+
+octave_value_list
+H5File::query_dset (const char *dsetname, double lo, double hi)
+{
+  if (open_dset (dsetname) < 0)
+    return octave_value_list ();
+
+  hid_t zm = open_zonemap ();
+  if (zm <= 0)
+    {
+      error ("the dataset %s has no zone map, see h5create", dsetname);
+      return octave_value_list ();
+    }
+
+  hid_t dcpl = H5Dget_create_plist (dset_id);
+  std::vector<hsize_t> chunk (rank);
+  H5Pget_chunk (dcpl, rank, &chunk[0]);
+  H5Pclose (dcpl);
+
+  // read the bounds of all chunks of the current extent
+  std::vector<hsize_t> ngrid (rank + 1, 2), zstart (rank + 1, 0);
+  hsize_t nchunks = 1;
+  for (int k = 0; k < rank; k++)
+    {
+      ngrid[k] = (h5_dims[k] + chunk[k] - 1) / chunk[k];
+      nchunks *= ngrid[k];
+    }
+  std::vector<double> bounds (max (2 * nchunks, (hsize_t)1));
+  hid_t zspace = H5Dget_space (zm);
+  hsize_t nzm = 2 * nchunks;
+  hid_t mem_space = H5Screate_simple (1, &nzm, NULL);
+  herr_t status = H5Sselect_hyperslab (zspace, H5S_SELECT_SET, &zstart[0],
+                                       NULL, &ngrid[0], NULL);
+  if (nchunks > 0 && status >= 0)
+    status = H5Dread (zm, H5T_NATIVE_DOUBLE, mem_space, zspace, xfer_plist,
+                      &bounds[0]);
+  H5Sclose (mem_space);
+  H5Sclose (zspace);
+  H5Dclose (zm);
+  if (status < 0)
+    {
+      error ("could not read the zone map of %s", dsetname);
+      return octave_value_list ();
+    }
+
+  // read each chunk whose bounds overlap [LO, HI] or are unknown; the
+  // matches are collected with their (0-based) linear index, which is
+  // the row major index in the file
+  std::vector<std::pair<double, double> > matches;
+  std::vector<hsize_t> gidx (rank, 0), start (rank), count (rank);
+  std::vector<double> buf;
+  for (hsize_t c = 0; c < nchunks; c++)
+    {
+      double cmin = bounds[2*c];
+      double cmax = bounds[2*c+1];
+      bool candidate = xisnan (cmin) || xisnan (cmax)
+                       || (cmax >= lo && cmin <= hi);
+      hsize_t npoints = 1;
+      for (int k = 0; k < rank; k++)
+        {
+          start[k] = gidx[k] * chunk[k];
+          count[k] = min (chunk[k], h5_dims[k] - start[k]);
+          npoints *= count[k];
+        }
+      for (int k = rank-1; k >= 0 && ++gidx[k] == ngrid[k]; k--)
+        gidx[k] = 0;
+      if (! candidate)
+        continue;
+
+      buf.resize (npoints);
+      {
+        H5PhaseTimer timer (H5_PHASE_SELECT);
+        status = H5Sselect_hyperslab (dspace_id, H5S_SELECT_SET, &start[0],
+                                      NULL, &count[0], NULL);
+      }
+      hid_t chunk_space = H5Screate_simple (1, &npoints, NULL);
+      if (status >= 0)
+        status = dset_read (H5T_NATIVE_DOUBLE, chunk_space, dspace_id,
+                            &buf[0]);
+      H5Sclose (chunk_space);
+      if (status < 0)
+        {
+          error ("error when reading dataset %s", dsetname);
+          return octave_value_list ();
+        }
+
+      std::vector<hsize_t> idx (rank, 0);
+      for (hsize_t i = 0; i < npoints; i++)
+        {
+          if (buf[i] >= lo && buf[i] <= hi)
+            {
+              double linear = 0;
+              for (int k = 0; k < rank; k++)
+                linear = linear * h5_dims[k] + start[k] + idx[k];
+              matches.push_back (std::make_pair (linear, buf[i]));
+            }
+          for (int k = rank-1; k >= 0 && ++idx[k] == count[k]; k--)
+            idx[k] = 0;
+        }
+    }
+  std::sort (matches.begin (), matches.end ());
+
+  ColumnVector indices (matches.size ()), values (matches.size ());
+  for (size_t i = 0; i < matches.size (); i++)
+    {
+      indices(i) = matches[i].first + 1;
+      values(i) = matches[i].second;
+    }
+  octave_value_list retval;
+  retval(1) = values;
+  retval(0) = indices;
+  return retval;
 }
 
 void
 H5File::delete_link (const char *location)
 {
+  // the zone map of a dataset goes with it
+  if (H5Lexists (file, location, H5P_DEFAULT) > 0)
+    {
+      dset_id = H5Oopen (file, location, H5P_DEFAULT);
+      if (H5Iget_type (dset_id) == H5I_DATASET)
+        {
+          hid_t zm = open_zonemap ();
+          if (zm > 0)
+            {
+              string name = string (location) + "_zonemap";
+              H5Dclose (zm);
+              H5Ldelete (file, name.c_str (), H5P_DEFAULT);
+            }
+        }
+      if (dset_id >= 0)
+        H5Oclose (dset_id);
+    }
+
   herr_t status = H5Ldelete (file, location, H5P_DEFAULT);
   if (status < 0)
     {
@@ -1591,6 +8226,22 @@ H5File::delete_att (const char *location, const char *att_name)
 }
 
 
+// Let objects created with the creation property list OCPL switch to
+// dense attribute storage once they carry more than ATTR_MAX_COMPACT
+// attributes, so that attribute lookup stays fast on objects with
+// thousands of attributes. Dense storage requires version 2 object
+// headers, which the library writes only if the attribute creation
+// order is tracked.
+herr_t
+H5File::set_attr_storage (hid_t ocpl)
+{
+  if (H5Pset_attr_creation_order (ocpl, H5P_CRT_ORDER_TRACKED
+                                  | H5P_CRT_ORDER_INDEXED) < 0)
+    return -1;
+  return H5Pset_attr_phase_change (ocpl, ATTR_MAX_COMPACT, ATTR_MIN_DENSE);
+}
+
+
 Matrix
 H5File::get_auto_chunksize(const Matrix& dset_shape, int typesize)
 {
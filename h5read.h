@@ -33,24 +33,158 @@
 
 #if defined (HAVE_HDF5) && defined (HAVE_HDF5_18)
 #include <hdf5.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// phases of a call whose wall time is accounted by h5stats
+enum H5Phase
+{
+  H5_PHASE_OPEN,     // opening files and datasets
+  H5_PHASE_SELECT,   // building dataspace selections
+  H5_PHASE_IO,       // reading and writing data, including type conversion
+  H5_NUM_PHASES
+};
+
+// statistics of the calls of one function on one object, collected
+// while instrumentation is enabled with h5stats
+struct H5Stats
+{
+  double calls = 0;
+  double bytes_read = 0;
+  double bytes_written = 0;
+  double time_total = 0;
+  double time_phase[H5_NUM_PHASES] = {0};
+  // number of transfers whose memory type differs from the file type
+  double conversions = 0;
+  // sum of the metadata cache hit rates of the files, one per call
+  double mdc_hit_rate = 0;
+};
+
+// Accounts one call of the function FCN on the object NAME, from its
+// construction to its destruction, if instrumentation is enabled.
+class H5StatsScope
+{
+ public:
+  H5StatsScope (const char *fcn, const std::string& name);
+  ~H5StatsScope ();
+
+ private:
+  std::chrono::steady_clock::time_point start;
+};
+
+// Accounts the wall time from its construction to its destruction to
+// the phase PHASE of the current call, if instrumentation is enabled.
+class H5PhaseTimer
+{
+ public:
+  H5PhaseTimer (H5Phase phase);
+  ~H5PhaseTimer ();
+
+ private:
+  H5Phase phase;
+  std::chrono::steady_clock::time_point start;
+};
+
+// options of h5read, given as key/value pairs after the hyperslab
+struct H5ReadOptions
+{
+  // names of the members of a compound dataset to read (all if empty)
+  string_vector fields;
+  // class of the returned numeric array (default if empty)
+  std::string output_type;
+  // applied as value*scale_factor + add_offset while reading
+  bool scale = false;
+  double scale_factor = 1;
+  double add_offset = 0;
+  // return the dimensions in the order of the file instead of reversed
+  bool c_order = false;
+  // collective MPI-IO transfers (with parallel HDF5)
+  bool collective = false;
+  // read numeric data into an array kept from an earlier call
+  bool reuse_buffer = false;
+};
+
+// a filter of the pipeline of a new dataset, with its client data
+struct H5Filter
+{
+  H5Z_filter_t id;
+  std::vector<unsigned int> params;
+};
+
+// options of h5create, besides the datatype and the chunk size
+struct H5CreateOptions
+{
+  // keep the minimum and maximum of each chunk in a companion dataset
+  bool zonemap = false;
+  // filters applied to the chunks, in this order: shuffle, deflate with
+  // this level unless it is 0, and then the given filters
+  bool shuffle = false;
+  int deflate = 0;
+  std::vector<H5Filter> filters;
+};
+
+// options of a file which only take effect when it is created
+struct H5FileOptions
+{
+  // keep track of free space in the file across closing and reopening
+  // it, so that space freed by deleting or overwriting objects is reused
+  bool persist_free_space = false;
+};
+
+// options of h5repack
+struct H5RepackOptions
+{
+  // chunk size of the rewritten datasets of the same rank, in Octave's
+  // order: empty to keep the layout, or starting with 0 for automatic
+  Matrix chunksize;
+  // deflate level of the rewritten datasets, 0 for none, or -1 to keep
+  // their filters
+  int deflate = -1;
+};
+
+// options of h5write, given as key/value pairs after the hyperslab
+struct H5WriteOptions
+{
+  // take the dimensions in the order of the file instead of reversed
+  bool c_order = false;
+  // collective MPI-IO transfers (with parallel HDF5)
+  bool collective = false;
+};
+
+// used by h5readgroup, defined in h5read.cc
+struct H5GroupNode;
+struct H5GroupMember;
+struct H5ChunkedRead;
+struct H5RawChunk;
+// used by h5repack, defined in h5read.cc
+struct H5RepackState;
 
 class H5File
 {
   
  public:
   
-  H5File (const char *filename, const bool create_if_nonexisting);
+  H5File (const char *filename, const bool create_if_nonexisting,
+          const H5FileOptions& fopts = H5FileOptions ());
   
   ~H5File ();
+
+  void set_read_options (const H5ReadOptions& opts);
+  void set_write_options (const H5WriteOptions& opts);
   
   octave_value read_dset_complete (const char *dsetname);
   octave_value read_dset_hyperslab (const char *dsetname,
                                     const Matrix& start, const Matrix& count,
                                     const Matrix& stride, const Matrix& block,
                                     int nargin);
+  int open_dset_proxy (const char *dsetname, dim_vector& dims,
+                       std::string& cls);
+  octave_value read_dset_index (const octave_value_list& idx);
+  int proxy_dims (dim_vector& dims);
 
   void write_dset (const char *location,
-                   const octave_value ov_data);
+                   const octave_value ov_data, bool create_parents = true);
   void write_dset_hyperslab (const char *location,
                              const octave_value ov_data,
                              const Matrix& start, const Matrix& count,
@@ -59,8 +193,22 @@ class H5File
   octave_value read_att (const char *location, const char *attname);
   void write_att (const char *location, const char *attname,
                   const octave_value& attvalue);
+  void write_struct (const char *location, const octave_scalar_map& s);
+  octave_value read_group (const char *location, bool recursive);
+  void append_table (const char *location, const octave_scalar_map& columns,
+                     hsize_t chunkrows);
+  octave_value reduce_dset (const char *dsetname, const Matrix& blockshape,
+                            const std::string& op);
+  octave_value stat_dset (const char *dsetname, const Matrix& dims,
+                          const Matrix& edges);
   void create_dset (const char *location, const Matrix& size,
-                    const char *datatype, Matrix& chunksize);
+                    const char *datatype, Matrix& chunksize,
+                    const H5CreateOptions& opts);
+  octave_value_list query_dset (const char *dsetname, double lo, double hi);
+  void copy_object (const char *srcpath, H5File& dst, const char *dstpath,
+                    const Matrix& start, const Matrix& count);
+  void repack (H5File& dst, const H5RepackOptions& opts);
+  bool persists_free_space ();
   void delete_link (const char *location);
   void delete_att (const char *location, const char *att_name);
 
@@ -68,6 +216,23 @@ class H5File
   const static int ALLOC_HSIZE_INFZERO_TO_UNLIMITED = 1;
   const static int ALLOC_HSIZE_INF_TO_ZERO = 2;
   const static int ALLOC_HSIZE_DEFAULT = 3;
+
+  // number of attributes above which an object switches to dense
+  // attribute storage, and below which it switches back to compact
+  const static unsigned ATTR_MAX_COMPACT = 8;
+  const static unsigned ATTR_MIN_DENSE = 6;
+
+  // size of the buffer through which data is reordered for C order
+  const static hsize_t C_ORDER_SLAB_BYTES = 64 << 20;
+  // size of the buffer through which h5reduce and h5stat stream a
+  // dataset
+  const static hsize_t STREAM_SLAB_BYTES = 64 << 20;
+
+  // chunk size of the zone map along unlimited dimensions
+  const static hsize_t ZONEMAP_CHUNK = 64;
+
+  // chunk size of the parts of a sparse matrix, in elements
+  const static hsize_t SPARSE_CHUNK = 1 << 18;
   
   //rank of the hdf5 dataset
   int rank;
@@ -75,26 +240,151 @@ class H5File
   hsize_t *h5_dims = NULL;
   hsize_t *h5_maxdims = NULL;
 
-  hid_t file;
-  hid_t dset_id;
-  hid_t dspace_id;
-  hid_t memspace_id;
-  hid_t obj_id;
-  hid_t att_id;
-  hid_t type_id;
-  hid_t mem_type_id;
+  hid_t file = -1;
+  hid_t dset_id = -1;
+  hid_t dspace_id = -1;
+  hid_t memspace_id = -1;
+  hid_t obj_id = -1;
+  hid_t att_id = -1;
+  hid_t type_id = -1;
+  hid_t mem_type_id = -1;
+  // data transfer property list used for all reads and writes
+  hid_t xfer_plist = H5P_DEFAULT;
+  // whether the file is open with the MPI-IO driver by all processes
+  bool is_mpio = false;
 
   //dimensions of the returned octave matrix
   dim_vector mat_dims;
+
+  H5ReadOptions read_opts;
+  H5WriteOptions write_opts;
+
+  // the hyperslab selected in dspace_id, in the order of the file
+  std::vector<hsize_t> sel_start, sel_stride, sel_count, sel_block;
   
   int open_dset (const char *dsetname);
+  void close_handles ();
+  void create_parent_groups (const char *location);
+  void write_struct_group (const std::string& path, const octave_scalar_map& s,
+                           hid_t lcpl, hid_t gcpl);
+  void read_group_walk (const std::string& path, bool recursive,
+                        H5GroupNode& node, std::vector<octave_value>& values,
+                        std::vector<H5GroupMember>& members);
+  bool read_raw_chunks (const H5GroupMember& m,
+                        std::vector<H5ChunkedRead>& reads,
+                        std::vector<H5RawChunk>& chunks);
+  herr_t dset_read (hid_t mem_type, hid_t mem_space, hid_t file_space,
+                    void *buf);
+  herr_t dset_write (hid_t mem_type, hid_t mem_space, hid_t file_space,
+                     const void *buf);
+  herr_t dset_io_c_order (hid_t mem_type, void *data, bool is_write,
+                          bool swap);
+  int line_dim ();
+  herr_t write_range (const Range& r, int dim);
   octave_value read_dset ();
+  octave_value read_dset_numeric ();
+  octave_value read_dset_strings ();
+  octave_value read_dset_compound ();
+  bool is_sparse_group (const char *location);
+  herr_t write_sparse_part (hid_t group, const char *name, hid_t file_type,
+                            hid_t mem_type, hsize_t n, const void *buf);
+  herr_t read_sparse_part (hid_t group, const char *name, hid_t mem_type,
+                           hsize_t n, void *buf);
+  template <typename T> herr_t write_sparse (const char *location,
+                                             const Sparse<T>& m,
+                                             hid_t data_type);
+  template <typename T> bool read_sparse (hid_t group, octave_idx_type nr,
+                                          octave_idx_type nc, hid_t data_type,
+                                          Sparse<T>& m);
+  octave_value read_sparse_group (const char *location);
+  herr_t write_dset_strings (const char *dsetname, const octave_value& ov_data,
+                             hid_t dcpl);
   Matrix get_auto_chunksize (const Matrix& size, int typesize);
+  hsize_t stream_slab_rows (hsize_t multiple, size_t elsize);
+  herr_t create_zonemap (const char *location);
+  hid_t open_zonemap ();
+  herr_t set_zonemap_name (hid_t dset, const std::string& name);
+  void update_zonemap (const octave_value& ov_data, bool column_major);
+  template <typename T>
+  octave_value stat_dset_typed (hid_t native, const std::vector<bool>& reduced,
+                                const std::vector<double>& edges);
+  herr_t copy_slabs (hid_t out, const std::vector<hsize_t>& hstart,
+                     const std::vector<hsize_t>& hcount);
+  herr_t copy_attributes (hid_t src, hid_t dst, const std::string& path,
+                          H5RepackState& state);
+  void repack_group (const std::string& path, H5File& dst,
+                     const H5RepackOptions& opts, H5RepackState& state);
+  herr_t repack_dset (const std::string& path, H5File& dst,
+                      const H5RepackOptions& opts, H5RepackState& state);
+  herr_t repack_ref_attributes (H5File& dst, const H5RepackState& state);
+  herr_t set_collective (bool collective);
+  herr_t set_attr_storage (hid_t ocpl);
 
   template <typename T> hsize_t* alloc_hsize (const T& dim, const int mode, const bool reverse);
 
 };
 
+// The value returned by h5dataset: a dataset of a file which is kept
+// open, read only as far as it is indexed
+class octave_h5dataset : public octave_base_value
+{
+ public:
+
+  octave_h5dataset ()
+    : octave_base_value (), mat_dims (0, 0) { }
+
+  octave_h5dataset (const std::shared_ptr<H5File>& file,
+                    const std::string& filename, const std::string& dsetname,
+                    const dim_vector& dims, const std::string& cls)
+    : octave_base_value (), file (file), filename (filename),
+      dsetname (dsetname), mat_dims (dims), data_class (cls) { }
+
+  octave_base_value* clone () const { return new octave_h5dataset (*this); }
+  octave_base_value* empty_clone () const { return new octave_h5dataset (); }
+
+  dim_vector dims () const;
+
+  bool is_defined () const { return true; }
+  bool is_constant () const { return true; }
+
+  octave_value subsref (const std::string& type,
+                        const std::list<octave_value_list>& idx);
+  octave_value_list subsref (const std::string& type,
+                             const std::list<octave_value_list>& idx,
+                             int)
+  { return subsref (type, idx); }
+
+  NDArray array_value (bool = false) const;
+
+  void print (std::ostream& os, bool pr_as_read_syntax = false);
+  void print_raw (std::ostream& os, bool pr_as_read_syntax = false) const;
+  bool print_name_tag (std::ostream& os, const std::string& name) const;
+
+ private:
+  // shared by the copies of the value, closed with the last one
+  std::shared_ptr<H5File> file;
+  std::string filename;
+  std::string dsetname;
+  // the dimensions last seen; the dataset may be extended meanwhile
+  mutable dim_vector mat_dims;
+  std::string data_class;
+
+  // As DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA, but the class is that of
+  // the data, as for the array h5read returns.
+ public:
+  int type_id () const { return t_id; }
+  std::string type_name () const { return t_name; }
+  std::string class_name () const { return data_class; }
+  static int static_type_id () { return t_id; }
+  static std::string static_type_name () { return t_name; }
+  static std::string static_class_name () { return t_name; }
+  static void register_type ();
+
+ private:
+  static int t_id;
+  static const std::string t_name;
+};
+
 
 
 #endif
@@ -169,6 +169,95 @@ check_dset('/foo3_double', "matrix")
 matrix =reshape((1:s**4)*0.1, [s s s s]);
 check_dset('/foo4_double', "matrix")
 
+disp("Test h5read with OutputType and scaling...")
+packed = cast(reshape(1:12, [3 4]), 'int16');
+h5write("test.h5", "/packed_int16", packed);
+data = h5read("test.h5", "/packed_int16", "OutputType", "single");
+if (isa(data, "single") && isequal(data, single(packed)))
+  disp("ok")
+else
+  error("test failed")
+end
+data = h5read("test.h5", "/packed_int16", [1 2], [3 2], "OutputType", "double",
+              "ScaleFactor", 0.5, "AddOffset", -1);
+if (isa(data, "double") && max(abs(data(:) - (double(packed(:,2:3)(:))*0.5 - 1))) < 1e-12)
+  disp("ok")
+else
+  error("test failed")
+end
+data = h5read("test.h5", "/packed_int16", "ScaleFactor", 0.01);
+if (isa(data, "double") && max(abs(data(:) - double(packed(:))*0.01)) < 1e-12)
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5write and h5read in C order...")
+A = reshape(1:60, [3 4 5]);
+h5write("test.h5", "/corder", A, "Order", "C");
+data = h5read("test.h5", "/corder");
+if (isequal(data, permute(A, [3 2 1])))
+  disp("ok")
+else
+  error("test failed")
+end
+data = h5read("test.h5", "/corder", "Order", "C");
+if (isequal(data, A))
+  disp("ok")
+else
+  error("test failed")
+end
+data = h5read("test.h5", "/corder", [2 1 2], [2 2 2], [1 2 2], "Order", "C");
+if (isequal(data, A(2:3, [1 3], [2 4])))
+  disp("ok")
+else
+  error("test failed")
+end
+h5write("test.h5", "/corder", -A(1:2, :, 2:3), [1 1 2], [2 4 2], "Order", "C");
+data = h5read("test.h5", "/corder", "Order", "C");
+B = A;
+B(1:2, :, 2:3) = -A(1:2, :, 2:3);
+if (isequal(data, B))
+  disp("ok")
+else
+  error("test failed")
+end
+h5write("test.h5", "/corder_int16", int16(A), "Order", "C");
+data = h5read("test.h5", "/corder_int16", "Order", "C");
+if (isa(data, "int16") && isequal(data, int16(A)))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5read of big-endian data...")
+% bigendian.h5 holds an int32, a double and an int16 dataset stored
+% big-endian, which are swapped after reading
+i32 = h5read("bigendian.h5", "/int32");
+dbl = h5read("bigendian.h5", "/double");
+i16 = h5read("bigendian.h5", "/int16");
+if (isa(i32, "int32") && isequal(i32, reshape(int32(-17:17), [5 7]))
+    && isequal(dbl, reshape((1:60)/8 - 3, [6 10]))
+    && isa(i16, "int16") && isequal(i16, reshape(int16(-150:149) * 100, [3 100]))
+    && isequal(h5read("bigendian.h5", "/double", [2 3], [4 5]),
+               reshape((1:60)/8 - 3, [6 10])(2:5, 3:7))
+    && isequal(h5read("bigendian.h5", "/int32", "Order", "C"),
+               reshape(int32(-17:17), [5 7])'))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test the Collective option in a single process...")
+h5create("test.h5", "/collective", [4 6]);
+h5write("test.h5", "/collective", magic(4)(:, 1:3), [1 4], [4 3], "Collective", true);
+data = h5read("test.h5", "/collective", [1 4], [4 3], "Collective", true);
+if (isequal(data, magic(4)(:, 1:3)))
+  disp("ok")
+else
+  error("test failed")
+end
+
 disp("Test h5write and h5read to subgroups...")
 matrix = reshape(cast(1:s**2,'int32'), [s s]);
 check_dset('/foo/foo2_int', "matrix")
@@ -183,6 +272,460 @@ range = (1:s**3)*0.1;
 range = range + i*range*0.01;
 check_dset('/foo_complex_range', "range")
 
+disp("Test h5write and h5read for strings...")
+labels = ["alpha  "; "beta   "; "gamma  "; "delta 4"];
+h5write("test.h5", "/labels_fixed", labels);
+if (isequal(h5read("test.h5", "/labels_fixed"), labels))
+  disp("ok")
+else
+  error("test failed")
+end
+h5write("test.h5", "/label_scalar", "just one");
+if (strcmp(h5read("test.h5", "/label_scalar"), "just one"))
+  disp("ok")
+else
+  error("test failed")
+end
+labels = {"a", "bb", ""; "dddd", "eeeee", "f"};
+h5write("test.h5", "/labels_vlen", labels);
+if (isequal(h5read("test.h5", "/labels_vlen"), labels))
+  disp("ok")
+else
+  error("test failed")
+end
+if (isequal(h5read("test.h5", "/labels_vlen", [1 2], [2 2]), labels(:,2:3)))
+  disp("ok")
+else
+  error("test failed")
+end
+% rewriting replaces datasets of another shape or kind of string
+h5write("test.h5", "/labels_fixed", ["one"; "two"]);
+h5write("test.h5", "/labels_vlen", {"x"; "yy"});
+h5write("test.h5", "/label_scalar", {"now", "a"; "cell", "array"});
+h5write("test.h5", "/label_scalar", "and back");
+if (isequal(h5read("test.h5", "/labels_fixed"), ["one"; "two"])
+    && isequal(h5read("test.h5", "/labels_vlen"), {"x"; "yy"})
+    && strcmp(h5read("test.h5", "/label_scalar"), "and back"))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5append and h5read for compound datasets...")
+rows.time = (1:5)'*0.5;
+rows.channel = int32([3 1 4 1 5])';
+rows.amplitude = single([9 2 6 5 3])';
+rows.flag = uint8([1 0 1 0 1])';
+rows.valid = logical([1 1 0 1 0])';
+h5append("test.h5", "/events/table", rows);
+rows2.time = [3.5; 4];
+rows2.channel = int32([9; 2]);
+rows2.amplitude = single([6; 5]);
+rows2.flag = uint8([0; 0]);
+rows2.valid = [false; true];
+h5append("test.h5", "/events/table", rows2);
+table = h5read("test.h5", "/events/table");
+if (isequal(table.time, [rows.time; rows2.time])
+    && isequal(table.channel, [rows.channel; rows2.channel])
+    && isequal(table.amplitude, [rows.amplitude; rows2.amplitude])
+    && isequal(table.flag, [rows.flag; rows2.flag])
+    && isequal(table.valid, [rows.valid; rows2.valid])
+    && islogical(table.valid))
+  disp("ok")
+else
+  error("test failed")
+end
+table = h5read("test.h5", "/events/table", 3, 4, "Fields", {"channel", "time"});
+if (isequal(fieldnames(table), {"channel"; "time"})
+    && isequal(table.channel, int32([4; 1; 5; 9]))
+    && isequal(table.time, [1.5; 2; 2.5; 3.5]))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5read of two dimensional compound datasets...")
+% compound.h5 holds /records, 3x4 records of a big-endian double x, a
+% string name, a big-endian int16 n and a uint8 q
+x = reshape((1:12) * 0.25, [4 3]);
+n = reshape(int16((1:12) * -3), [4 3]);
+q = reshape(uint8(200:211), [4 3]);
+lastwarn("");
+rec = h5read("compound.h5", "/records");
+skipped = ! isempty(strfind(lastwarn(), "skipping member name"));
+sub = h5read("compound.h5", "/records", [2 1], [2 3], "Fields", {"q", "x"});
+if (skipped && isequal(fieldnames(rec), {"x"; "n"; "q"})
+    && isequal(rec.x, x) && isa(rec.n, "int16") && isequal(rec.n, n)
+    && isa(rec.q, "uint8") && isequal(rec.q, q)
+    && isequal(fieldnames(sub), {"q"; "x"})
+    && isequal(sub.q, q(2:3, :)) && isequal(sub.x, x(2:3, :))
+    && isequal(h5read("compound.h5", "/records", "Fields", "n"), struct("n", n)))
+  disp("ok")
+else
+  error("test failed")
+end
+failed = false;
+try
+  h5read("compound.h5", "/records", "Fields", {"x", "missing"});
+catch
+  failed = true;
+end
+if (failed)
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5reduce...")
+A = reshape(mod((0:62)*37, 101), [7 9]);
+h5write("test.h5", "/reduce", A);
+b = [3 4];
+for op = {"mean", "sum", "min", "max"}
+  expected = zeros(ceil(size(A) ./ b));
+  for i = 1:rows(expected)
+    for j = 1:columns(expected)
+      blk = A((i-1)*b(1)+1:min(i*b(1), end), (j-1)*b(2)+1:min(j*b(2), end));
+      expected(i,j) = feval(op{1}, blk(:));
+    end
+  end
+  data = h5reduce("test.h5", "/reduce", b, op{1});
+  if (max(abs(data(:) - expected(:))) < 1e-12)
+    disp("ok")
+  else
+    error("test failed")
+  end
+end
+
+disp("Test h5stat...")
+A = reshape(mod((0:59)*37, 101), [6 10]);
+A(3) = NaN;
+h5write("test.h5", "/stat", A);
+s = h5stat("test.h5", "/stat", "Edges", 0:25:100);
+v = A(! isnan(A));
+if (s.count == 59 && s.nan_count == 1 && s.min == min(v) && s.max == max(v)
+    && abs(s.mean - mean(v)) < 1e-12 && abs(s.std - std(v)) < 1e-12
+    && isequal(s.histogram, histc(v, 0:25:100)'))
+  disp("ok")
+else
+  error("test failed")
+end
+s = h5stat("test.h5", "/stat", 1);
+if (isequal(size(s.mean), [1 10]) && isequal(s.max, max(A, [], 1))
+    && max(abs(s.mean(2:end) - mean(A(:,2:end)))) < 1e-12)
+  disp("ok")
+else
+  error("test failed")
+end
+h5write("test.h5", "/stat_int16", int16(A(:,2:end)));
+s = h5stat("test.h5", "/stat_int16");
+if (isa(s.min, "int16") && s.min == min(A(:,2:end)(:)) && s.count == 54)
+  disp("ok")
+else
+  error("test failed")
+end
+h5create("test.h5", "/stat_empty", [Inf 3], "ChunkSize", [4 3]);
+h5create("test.h5", "/stat_empty2", [3 Inf], "ChunkSize", [3 4]);
+s = h5stat("test.h5", "/stat_empty");
+s2 = h5stat("test.h5", "/stat_empty2", 1);
+if (s.count == 0 && isnan(s.mean) && isnan(s.min)
+    && all(s2.count(:) == 0))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5query with a zone map...")
+h5create("test.h5", "/zoned", [Inf 8], "ChunkSize", [4 4], "ZoneMap", true);
+A = reshape(mod((0:95)*37, 101), [12 8]);
+for i = 1:3:12
+  h5write("test.h5", "/zoned", A(i:i+2,:), [i 1], [3 8]);
+end
+[idx, val] = h5query("test.h5", "/zoned", 40, 60);
+expected = find(A >= 40 & A <= 60);
+if (isequal(idx, expected) && isequal(val, A(expected)))
+  disp("ok")
+else
+  error("test failed")
+end
+h5delete("test.h5", "/zoned");
+h5create("test.h5", "/zoned", [Inf 8], "Datatype", "int16", "ChunkSize", [4 4],
+         "ZoneMap", true);
+for i = 1:3:12
+  h5write("test.h5", "/zoned", int16(A(i:i+2,:)) - 50, [i 1], [3 8]);
+end
+h5write("test.h5", "/zoned", 1:8, [13 1], [1 8]);
+[idx, val] = h5query("test.h5", "/zoned", -10, 5);
+B = [A - 50; 1:8];
+expected = find(B >= -10 & B <= 5);
+if (isequal(idx, expected) && isequal(double(val), B(expected)))
+  disp("ok")
+else
+  error("test failed")
+end
+h5delete("test.h5", "/zoned");
+% a row skipped in a growing dataset holds the fill value
+h5create("test.h5", "/zoned", [Inf 3], "ChunkSize", [4 3], "ZoneMap", true);
+h5write("test.h5", "/zoned", [1 2 3; 4 5 6], [1 1], [2 3]);
+h5write("test.h5", "/zoned", [7 8 9], [4 1], [1 3]);
+[idx, val] = h5query("test.h5", "/zoned", 0, 0);
+if (isequal(idx, [3; 7; 11]) && isequal(val, [0; 0; 0]))
+  disp("ok")
+else
+  error("test failed")
+end
+h5delete("test.h5", "/zoned");
+
+disp("Test h5copy...")
+A = reshape(1:120, [12 10]);
+h5create("test.h5", "/tocopy", [12 10], "ChunkSize", [4 5]);
+h5write("test.h5", "/tocopy", A, [1 1], [12 10]);
+h5copy("test.h5", "/tocopy", "test2.h5", "/copies/whole");
+h5copy("test.h5", "/tocopy", "test2.h5", "/copies/chunks", [5 6], [8 5]);
+h5copy("test.h5", "/tocopy", "test2.h5", "/copies/slab", [2 3], [5 4]);
+if (isequal(h5read("test2.h5", "/copies/whole"), A)
+    && isequal(h5read("test2.h5", "/copies/chunks"), A(5:12, 6:10))
+    && isequal(h5read("test2.h5", "/copies/slab"), A(2:6, 3:6)))
+  disp("ok")
+else
+  error("test failed")
+end
+% the zone maps of datasets in a copied group go with them
+h5writestruct("test.h5", "/zgrp", struct("tag", 1));
+h5create("test.h5", "/zgrp/d", [Inf 4], "ChunkSize", [4 4], "ZoneMap", true);
+Z = reshape(1:32, [8 4]);
+h5write("test.h5", "/zgrp/d", Z, [1 1], [8 4]);
+h5copy("test.h5", "/zgrp", "test.h5", "/zgrp_copy");
+h5copy("test.h5", "/zgrp", "test2.h5", "/copies/zgrp");
+h5write("test.h5", "/zgrp_copy/d", -Z(1:4, :), [1 1], [4 4]);
+h5write("test2.h5", "/copies/zgrp/d", -Z(5:8, :), [5 1], [4 4]);
+[idx, val] = h5query("test.h5", "/zgrp/d", 1, 10);
+[idx2, val2] = h5query("test.h5", "/zgrp_copy/d", -4, -1);
+[idx3, val3] = h5query("test2.h5", "/copies/zgrp/d", -30, -20);
+if (isequal(idx, find(Z <= 10)) && isequal(val, Z(Z <= 10))
+    && isequal(val2, [-1; -2; -3; -4])
+    && isequal(val3, -Z(Z >= 20 & Z <= 30 & mod(Z - 1, 8) >= 4)))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5repack...")
+h5create("test3.h5", "/big", [1000 100], "PersistFreeSpace", true);
+h5write("test3.h5", "/big", rand(1000, 100));
+h5write("test3.h5", "/kept", A);
+h5writeatt("test3.h5", "/", "note", "repacked");
+h5delete("test3.h5", "/big");
+before = stat("test3.h5").size;
+h5repack("test3.h5");
+h5repack("test3.h5", "test4.h5", "ChunkSize", [6 5], "Deflate", 4);
+if (stat("test3.h5").size < before / 2
+    && isequal(h5read("test3.h5", "/kept"), A)
+    && strcmp(h5readatt("test3.h5", "/", "note"), "repacked")
+    && isequal(h5read("test4.h5", "/kept"), A))
+  disp("ok")
+else
+  error("test failed")
+end
+% links.h5 has a 50x100 dataset /grp/data linked again as /alias, the
+% group /grp linked into itself as /grp/self, and netCDF-4 style
+% dimension scale references between /grp/data and /grp/x
+D = h5read("links.h5", "/grp/data");
+h5repack("links.h5", "test5.h5");
+h5repack("links.h5", "test6.h5", "Deflate", 4);
+if (isequal(h5read("test5.h5", "/alias"), D)
+    && isequal(h5read("test5.h5", "/grp/self/self/data"), D)
+    && isequal(h5read("test6.h5", "/alias"), D)
+    && isequal(h5read("test6.h5", "/grp/x"), (0:199)')
+    && stat("test5.h5").size < 1.5 * numel(D) * 8
+    && stat("test6.h5").size < 1.5 * numel(D) * 8)
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5read with ReuseBuffer...")
+h5write("test.h5", "/reuse", reshape(1:200, [10 20]));
+ok = true;
+for k = 1:4
+  x = h5read("test.h5", "/reuse", [1 k], [10 5], "ReuseBuffer", true);
+  ok = ok && isequal(x, reshape(1:200, [10 20])(:, k:k+4));
+  if (k == 2)
+    kept = x;
+  end
+end
+h5read("test.h5", "/reuse", "ReuseBuffer", false);
+if (ok && isequal(kept, reshape(1:200, [10 20])(:, 2:6)))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5readstack...")
+files = {"test.h5", "test2.h5", "test4.h5"};
+for i = 1:3
+  h5write(files{i}, "/stack", reshape((1:12) + 100*i, [3 4]));
+end
+data = h5readstack(files, "/stack");
+part = h5readstack(files, "/stack", [2 2], [2 3], "Workers", 2);
+serial = h5readstack(files, "/stack", "Workers", 1);
+if (isequal(size(data), [3 4 3]) && isequal(data(:, :, 2), reshape((1:12) + 200, [3 4]))
+    && isequal(part, data(2:3, 2:4, :)) && isequal(serial, data))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5dataset...")
+d = h5dataset("test.h5", "/reuse");
+full = reshape(1:200, [10 20]);
+if (isequal(size(d), [10 20]) && isequal(d(2:2:10, 3:5), full(2:2:10, 3:5))
+    && isequal(d(:, end), full(:, end)) && isequal(d([7 3], 1), full([7 3], 1))
+    && isequal(d(15), 15) && strcmp(class(d), "double"))
+  disp("ok")
+else
+  error("test failed")
+end
+clear d
+
+disp("Test h5dataset of an extended dataset...")
+h5create("test.h5", "/growing", [Inf 3], "ChunkSize", [4 3]);
+h5write("test.h5", "/growing", [1 2 3; 4 5 6], [1 1], [2 3]);
+d = h5dataset("test.h5", "/growing");
+h5write("test.h5", "/growing", [7 8 9], [3 1], [1 3]);
+if (isequal(size(d), [3 3]) && isequal(d(end, :), [7 8 9]))
+  disp("ok")
+else
+  error("test failed")
+end
+clear d
+
+disp("Test writing ranges and native types...")
+h5write("test.h5", "/range", 1:0.5:50);
+h5create("test.h5", "/slab", [4 30], "Datatype", "int32");
+h5write("test.h5", "/slab", 3:3:30, [2 11], [1 10]);
+h5write("test.h5", "/slab", int8([1 2; 3 4]), [3 1], [2 2]);
+slab = h5read("test.h5", "/slab");
+if (isequal(h5read("test.h5", "/range"), 1:0.5:50)
+    && isequal(slab(2, 11:20), int32(3:3:30)) && isequal(slab(3:4, 1:2), int32([1 2; 3 4])))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test writing logical and char arrays...")
+mask = rand(20, 30) > 0.5;
+chars = reshape("abcdefghijklmnopqrstuvwx", [2 3 4]);
+h5write("test.h5", "/mask", mask);
+h5write("test.h5", "/chars", chars);
+h5write("test.h5", "/mask", ! mask(1:2, :), [1 1], [2 30]);
+mask(1:2, :) = ! mask(1:2, :);
+if (isequal(h5read("test.h5", "/mask"), mask) && islogical(h5read("test.h5", "/mask"))
+    && isequal(h5read("test.h5", "/chars"), chars))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test writing sparse matrices...")
+S = sprand(200, 100, 0.05);
+Z = S + 1i * sprand(200, 100, 0.05);
+h5write("test.h5", "/sparse", S);
+h5write("test.h5", "/sparse_complex", Z);
+h5write("test.h5", "/sparse_empty", sparse(3, 4));
+R = h5read("test.h5", "/sparse");
+if (issparse(R) && isequal(R, S) && isequal(h5read("test.h5", "/sparse_complex"), Z)
+    && isequal(h5read("test.h5", "/sparse_empty"), sparse(3, 4))
+    && isequal(h5read("test.h5", "/sparse/indptr"), int64(full([0; cumsum(sum(S != 0, 1))'])))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5create with filters...")
+h5create("test.h5", "/filtered", [50 40], "ChunkSize", [10 10], "Shuffle", true,
+         "Filter", 1, "FilterParams", 6, "Filter", 3);
+h5write("test.h5", "/filtered", magic(50)(:, 1:40));
+if (isequal(h5read("test.h5", "/filtered"), magic(50)(:, 1:40)))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test sequential h5read with readahead...")
+h5write("test.h5", "/scan", reshape(1:600, [6 100]));
+ok = true;
+for k = 1:10:91
+  ok = ok && isequal(h5read("test.h5", "/scan", [1 k], [6 10]), reshape(1:600, [6 100])(:, k:k+9));
+end
+% a write between reads discards the hyperslab read ahead
+h5read("test.h5", "/scan", [1 1], [6 10]);
+h5read("test.h5", "/scan", [1 11], [6 10]);
+h5write("test.h5", "/scan", zeros(6, 10), [1 21], [6 10]);
+if (ok && isequal(h5read("test.h5", "/scan", [1 21], [6 10]), zeros(6, 10)))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5writestruct...")
+s = struct();
+s.values = magic(4);
+s.label = "run 1";
+s.count = int32(7);
+s.sub.x = (1:5)';
+s.sub.names = {"a", "bc"};
+h5writestruct("test.h5", "/results/run1", s);
+if (isequal(h5read("test.h5", "/results/run1/values"), magic(4))
+    && strcmp(h5readatt("test.h5", "/results/run1", "label"), "run 1")
+    && h5readatt("test.h5", "/results/run1", "count") == 7
+    && isequal(h5read("test.h5", "/results/run1/sub/x"), (1:5)')
+    && isequal(h5read("test.h5", "/results/run1/sub/names"), {"a", "bc"}))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5readgroup...")
+r = h5readgroup("test.h5", "/results/run1");
+rr = h5readgroup("test.h5", "/results/run1", "Recursive", true);
+if (isequal(r.values, magic(4)) && strcmp(r.label, "run 1")
+    && r.count == 7 && ! isfield(r, "sub")
+    && isequal(rr.sub.x, (1:5)') && isequal(rr.sub.names, {"a", "bc"}))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5writestruct and h5readgroup with sparse fields...")
+t = struct("S", sparse([1 3 4], [2 2 5], [0.5 -1 2], 4, 6));
+t.sub.Z = sparse([2 1], [1 2], [1i 3], 2, 2);
+h5writestruct("test.h5", "/sparse_struct", t);
+r = h5readgroup("test.h5", "/sparse_struct");
+rr = h5readgroup("test.h5", "/sparse_struct", "Recursive", true);
+if (issparse(r.S) && isequal(r.S, t.S) && ! isfield(r, "sub")
+    && isequal(rr.S, t.S) && issparse(rr.sub.Z) && isequal(rr.sub.Z, t.sub.Z))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5readgroup of compressed datasets...")
+h5writestruct("test.h5", "/packed", struct("tag", 1));
+h5create("test.h5", "/packed/a", [23 17], "ChunkSize", [5 4], "Shuffle", true,
+         "Deflate", 6);
+h5create("test.h5", "/packed/b", [9 31], "Datatype", "int16",
+         "ChunkSize", [4 8], "Shuffle", true, "Deflate", 1);
+h5write("test.h5", "/packed/a", rand(23, 17));
+h5write("test.h5", "/packed/b", int16(magic(31)(1:9, :)));
+p = h5readgroup("test.h5", "/packed");
+if (isequal(p.a, h5read("test.h5", "/packed/a"))
+    && isequal(p.b, h5read("test.h5", "/packed/b"))
+    && isequal(p.b, int16(magic(31)(1:9, :))) && isequal(size(p.a), [23 17]))
+  disp("ok")
+else
+  error("test failed")
+end
+
 disp("Test h5writeatt and h5readatt...")
 
 function check_att(location, att)
@@ -213,7 +756,16 @@ testatt_double_NA = NA;
 check_att("/","testatt_double_NA")
 
 testatt2_double = reshape(0.1:0.1:0.5, [5, 1]);
-%check_att("/","testatt2_double")
+check_att("/","testatt2_double")
+
+testatt3_single = single(reshape(1:24, [2 3 4])*0.5);
+check_att("/","testatt3_single")
+
+testatt2_uint16 = cast([1 2 3; 4 5 6], 'uint16');
+check_att("/","testatt2_uint16")
+
+testatt1_int64 = cast([-3 7 11], 'int64');
+check_att("/","testatt1_int64")
 
 testatt_int = cast(7,'int32')
 check_att("/","testatt_int")
@@ -227,6 +779,32 @@ check_att("/","testatt_string")
 testatt_string = 'buona sera!';
 check_att("/","testatt_string")
 
+disp("write many attributes to one object...")
+for k = 1:100
+  h5writeatt("test.h5", "/foo1_double", sprintf("att%03d", k), k*[1 2 3]);
+end
+if (all(h5readatt("test.h5", "/foo1_double", "att077") == 77*[1 2 3]))
+  disp("ok")
+else
+  error("test failed")
+end
+
+disp("Test h5stats...")
+h5stats("reset");
+h5stats("on");
+data = h5read("test.h5", "/foo3_double");
+h5read("test.h5", "/foo3_double", [1 1 1], [2 2 2]);
+h5stats("off");
+h5read("test.h5", "/foo3_double");
+stats = h5stats();
+if (numel(stats) == 1 && strcmp(stats.function, "h5read")
+    && stats.calls == 2 && stats.bytes_read == (numel(data) + 8)*8)
+  disp("ok")
+else
+  error("test failed")
+end
+h5stats("reset");
+
 disp("write to nonexisting file...")
 h5write("test2.h5","/foo/bar/test",reshape(1:27,[3 3 3]));
 